@@ -0,0 +1,295 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file bench.c
+ *      @brief Microbenchmarks of encoding, rendering and layout.
+ *      @detail Each benchmark is run at several batch sizes, timing whole batches and reporting
+ *              per barcode. Results are written to stdout as one JSON object per line:
+ *
+ *              <tt>{"name":"encode/digits","batch":16,"ops":...,"ns_per_op":...,"p50":...,
+ *              "p90":...,"p99":...,"bytes_per_op":...,"allocs_per_op":...}</tt>
+ *
+ *              where the percentiles are of the nanoseconds per barcode of each batch. Allocations
+ *              are counted by wrapping the allocator at link time (see the @c bench target of the
+ *              Makefile), so only allocations made by the library are included.
+ *
+ *              Usage: <tt>bench [-t milliseconds] [filter]</tt>, where @c -t sets the minimum time
+ *              spent on each benchmark and only benchmarks whose names contain @c filter are run.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*      @brief Number of distinct inputs of each kind, cycled through by every benchmark */
+#define BENCH_INPUTS 64
+#define BENCH_DEFAULT_MS 200
+#define BENCH_MAX_SAMPLES 100000
+/*      @brief Size of the buffer c128_ps() writes into, more than any one barcode needs */
+#define BENCH_PS_BUFSIZE 16384
+#define NS_PER_SEC 1000000000LL
+
+/**
+ *      @brief A benchmark, which runs an operation on @c batch barcodes from @c first.
+ */
+typedef struct Benchmark Benchmark;
+
+typedef void (*BenchFunc)(int first, int batch);
+
+struct Benchmark {
+    const char * name;
+    BenchFunc    run;
+};
+
+/**
+ *      @brief Allocations made since the counters were last reset.
+ */
+static size_t alloc_count;
+static size_t alloc_bytes;
+
+void * __real_malloc(size_t);
+void * __real_calloc(size_t, size_t);
+void * __real_realloc(void *, size_t);
+
+void * __wrap_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t num, size_t size) {
+    alloc_count++;
+    alloc_bytes += num * size;
+    return __real_calloc(num, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+static int batch_sizes[] = {1, 16, 256};
+
+/* Encoder inputs, with room for the null terminator snprintf() writes after the mixed ones */
+static uchar digits[BENCH_INPUTS][C128_MAX_DATA_LEN + 1];
+static uchar mixed[BENCH_INPUTS][C128_MAX_DATA_LEN + 1];
+static uchar control[BENCH_INPUTS][C128_MAX_DATA_LEN + 1];
+static int   digits_len[BENCH_INPUTS];
+static int   mixed_len[BENCH_INPUTS];
+static int   control_len[BENCH_INPUTS];
+
+/* Barcodes encoded from the mixed inputs, for the rendering benchmarks */
+static Code128 * codes[BENCH_INPUTS];
+
+/* Copies of the barcodes for layouts, which take a contiguous array */
+static Code128 ** layout_codes;
+
+static char ps_buf[BENCH_PS_BUFSIZE];
+
+/**
+ *      @brief Keeps results from being optimised away.
+ */
+static volatile size_t result;
+
+static void inputs_init(void) {
+    srand(128);
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        digits_len[i] = C128_MAX_DATA_LEN;
+        for (int j = 0; j < digits_len[i]; j++) {
+            digits[i][j] = '0' + rand() % 10;
+        }
+
+        mixed_len[i] = snprintf((char *) mixed[i],
+                                sizeof mixed[i],
+                                "SKU-%06d %c%c",
+                                rand() % 1000000,
+                                'A' + rand() % 26,
+                                'a' + rand() % 26);
+
+        control_len[i] = C128_MAX_DATA_LEN / 2;
+        for (int j = 0; j < control_len[i]; j++) {
+            control[i][j] = j % 2 ? 'A' + rand() % 26 : rand() % ASCII_NUM_CTRL;
+        }
+
+        c128_encode(mixed[i], mixed_len[i], &codes[i]);
+    }
+
+    int max_batch = batch_sizes[sizeof batch_sizes / sizeof *batch_sizes - 1];
+    layout_codes  = malloc(sizeof *layout_codes * max_batch);
+    for (int i = 0; i < max_batch; i++) {
+        layout_codes[i] = codes[i % BENCH_INPUTS];
+    }
+}
+
+static void inputs_free(void) {
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        free(codes[i]->data);
+        free(codes[i]);
+    }
+    free(layout_codes);
+}
+
+static void encode(uchar inputs[][C128_MAX_DATA_LEN + 1], int * lens, int first, int batch) {
+    for (int i = first; i < first + batch; i++) {
+        Code128 * code;
+        int       n = i % BENCH_INPUTS;
+        if (SUCCESS == c128_encode(inputs[n], lens[n], &code)) {
+            result += code->datalen;
+            free(code->data);
+            free(code);
+        }
+    }
+}
+
+static void bench_encode_digits(int first, int batch) {
+    encode(digits, digits_len, first, batch);
+}
+
+static void bench_encode_mixed(int first, int batch) {
+    encode(mixed, mixed_len, first, batch);
+}
+
+static void bench_encode_control(int first, int batch) {
+    encode(control, control_len, first, batch);
+}
+
+static void bench_strrepr(int first, int batch) {
+    for (int i = first; i < first + batch; i++) {
+        char * repr;
+        int    n = i % BENCH_INPUTS;
+        c128_strrepr(control[n], control_len[n], &repr);
+        result += repr[0];
+        free(repr);
+    }
+}
+
+static void bench_svg(int first, int batch) {
+    for (int i = first; i < first + batch; i++) {
+        char * svg;
+        c128_svg(codes[i % BENCH_INPUTS], &svg);
+        result += svg[0];
+        free(svg);
+    }
+}
+
+static void bench_ps(int first, int batch) {
+    for (int i = first; i < first + batch; i++) {
+        Cursor cursor;
+        cursor_init(&cursor, ps_buf, sizeof ps_buf);
+        c128_ps(codes[i % BENCH_INPUTS], &cursor, &PS_DEFAULT_PROPS);
+        result += cursor.pos;
+    }
+}
+
+static void bench_ps_layout(int first, int batch) {
+    (void) first;
+    char * ps;
+    Layout layout = {.rows = CEILDIV(batch, 2), .cols = 2};
+    c128_ps_layout(layout_codes, batch, &ps, &PS_DEFAULT_PROPS, &layout);
+    result += ps[0];
+    free(ps);
+}
+
+static const Benchmark benchmarks[] = {{"encode/digits", bench_encode_digits},
+                                       {"encode/mixed", bench_encode_mixed},
+                                       {"encode/control", bench_encode_control},
+                                       {"strrepr", bench_strrepr},
+                                       {"svg", bench_svg},
+                                       {"ps", bench_ps},
+                                       {"ps_layout", bench_ps_layout}};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static int compare_double(const void * a, const void * b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double * sorted, int count, int p) {
+    return sorted[(count - 1) * p / 100];
+}
+
+/**
+ *      @detail Batches are run until at least @c min_ns has passed, after a batch to warm up.
+ */
+static void run(const Benchmark * bench, int batch, long long min_ns, double * samples) {
+    bench->run(0, batch);
+
+    size_t    ops     = 0;
+    int       count   = 0;
+    long long elapsed = 0;
+    alloc_count       = 0;
+    alloc_bytes       = 0;
+    while (elapsed < min_ns && count < BENCH_MAX_SAMPLES) {
+        long long start = now_ns();
+        bench->run(ops, batch);
+        long long time = now_ns() - start;
+
+        samples[count++] = (double) time / batch;
+        elapsed += time;
+        ops += batch;
+    }
+    size_t allocs = alloc_count;
+    size_t bytes  = alloc_bytes;
+
+    qsort(samples, count, sizeof *samples, compare_double);
+    printf("{\"name\":\"%s\",\"batch\":%d,\"ops\":%zu,\"ns_per_op\":%.1f,\"p50\":%.1f,\"p90\":%.1f,"
+           "\"p99\":%.1f,\"bytes_per_op\":%.1f,\"allocs_per_op\":%.2f}\n",
+           bench->name,
+           batch,
+           ops,
+           (double) elapsed / ops,
+           percentile(samples, count, 50),
+           percentile(samples, count, 90),
+           percentile(samples, count, 99),
+           (double) bytes / ops,
+           (double) allocs / ops);
+    fflush(stdout);
+}
+
+int main(int argc, char ** argv) {
+    long long    min_ns = BENCH_DEFAULT_MS * (NS_PER_SEC / 1000);
+    const char * filter = "";
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-t") && i + 1 < argc) {
+            min_ns = atoll(argv[++i]) * (NS_PER_SEC / 1000);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    init_barcode();
+    inputs_init();
+
+    size_t   samples_size = sizeof(double) * BENCH_MAX_SAMPLES;
+    double * samples      = malloc(samples_size);
+    VERIFY_NULL(samples, samples_size);
+
+    for (size_t i = 0; i < sizeof benchmarks / sizeof *benchmarks; i++) {
+        if (!strstr(benchmarks[i].name, filter)) {
+            continue;
+        }
+        for (size_t j = 0; j < sizeof batch_sizes / sizeof *batch_sizes; j++) {
+            run(&benchmarks[i], batch_sizes[j], min_ns, samples);
+        }
+    }
+
+    free(samples);
+    inputs_free();
+    return 0;
+}
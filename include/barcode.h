@@ -10,7 +10,23 @@
  *      @author Elijah Schutz
  *      @date 22/3/18
  */
+#include "barcode/alloc.h"
+#include "barcode/cache.h"
+#include "barcode/compose.h"
+#include "barcode/context.h"
+#include "barcode/cursor.h"
+#include "barcode/deflate.h"
 #include "barcode/errors.h"
+#include "barcode/export.h"
 #include "barcode/graphic.h"
+#include "barcode/mapped.h"
+#include "barcode/parallel.h"
+#include "barcode/pipeline.h"
+#include "barcode/printer.h"
+#include "barcode/raster.h"
+#include "barcode/sheet.h"
+#include "barcode/sink.h"
+#include "barcode/stats.h"
+#include "barcode/stream.h"
 #include "barcode/symb.h"
 #include "barcode/util.h"
@@ -0,0 +1,160 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file alloc.h
+ *      @brief Declarations for replacing the allocator used by the library.
+ *      @detail Every allocation made by the library goes through barcode_malloc() and its
+ *              siblings, which call the allocator of the calling thread set by
+ *              barcode_use_allocator(), or else the global allocator set by
+ *              barcode_set_allocator(), or else the C library. Memory returned to the caller, such
+ *              as the barcodes of c128_encode() or the strings of c128_svg(), comes from the same
+ *              allocator, so should be released with barcode_free() or c128_free() when another
+ *              allocator is in use.
+ *
+ *              Functions that render on worker threads, such as c128_ps_paginate_mt(), give their
+ *              workers the allocator of the calling thread, which must then be safe to call from
+ *              several threads at once. The built-in arena and pool are not; give each thread its
+ *              own.
+ *
+ *              When an allocator runs out, the library exits through VERIFY_NULL as when the C
+ *              library does, so an arena or pool should be sized for the largest job it serves.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+/**
+ *      @brief Alignment of every allocation made by the built-in arena and pool, that of
+ *             @c max_align_t on the supported platforms
+ */
+#define ALLOC_ALIGN 16
+
+/**
+ *      @brief A source of memory for the library.
+ */
+typedef struct BarcodeAllocator Allocator;
+
+/**
+ *      @brief Memory usage of an allocator.
+ */
+typedef struct AllocatorStats AllocStats;
+
+/**
+ *      @brief An allocator handing out memory from a fixed buffer in order, freed all at once.
+ */
+typedef struct BumpArena Arena;
+
+/**
+ *      @brief An allocator handing out blocks of one size from a fixed buffer.
+ */
+typedef struct BlockPool Pool;
+
+/**
+ *      @detail Each function is given @c ctx as its first argument. @c alloc and @c resize return
+ *              NULL when the request can't be satisfied, as malloc() and realloc() do; @c resize
+ *              is given NULL to allocate and @c release may be given NULL.
+ */
+struct BarcodeAllocator {
+    void * (*alloc)(void *, size_t);          /**< Allocates uninitialised memory */
+    void * (*resize)(void *, void *, size_t); /**< Resizes an allocation, as realloc() */
+    void (*release)(void *, void *);          /**< Frees an allocation */
+    void * ctx;                               /**< The state of the allocator */
+};
+
+struct AllocatorStats {
+    size_t current; /**< Bytes in use, including the allocator's own overhead */
+    size_t peak;    /**< The highest @c current has been */
+    size_t count;   /**< Number of allocations and resizes made */
+};
+
+struct BumpArena {
+    Allocator  allocator; /**< The allocator to install, which allocates from this arena */
+    AllocStats stats;
+    char *     buf;  /**< The memory allocations are made from */
+    size_t     cap;  /**< Size of @c buf in bytes */
+    size_t     last; /**< Offset of the header of the most recent allocation */
+};
+
+struct BlockPool {
+    Allocator  allocator; /**< The allocator to install, which allocates from this pool */
+    AllocStats stats;
+    char *     buf;        /**< The memory blocks are made from */
+    size_t     block_size; /**< Size of each block, a multiple of ALLOC_ALIGN */
+    size_t     num_blocks; /**< Number of blocks in @c buf */
+    void *     free_list;  /**< The first free block, each of which points to the next */
+};
+
+/**
+ *      @brief Sets the allocator used by threads that have not set their own.
+ *      @detail Should be called before the library is used, as memory already allocated must be
+ *              freed by the allocator that allocated it.
+ *      @param allocator The allocator, which must outlive its use, or NULL for the C library
+ */
+void barcode_set_allocator(const Allocator *);
+
+/**
+ *      @brief Sets the allocator used by the calling thread, such as an arena for one job.
+ *      @param allocator The allocator, or NULL to use the global allocator
+ *      @return The allocator the thread was using, to be restored afterwards
+ */
+const Allocator * barcode_use_allocator(const Allocator *);
+
+/**
+ *      @brief The allocator used by the calling thread, or NULL for the C library.
+ */
+const Allocator * barcode_allocator(void);
+
+/**
+ *      @brief Allocates memory with the calling thread's allocator, as malloc()
+ */
+void * barcode_malloc(size_t);
+
+/**
+ *      @brief Allocates zeroed memory with the calling thread's allocator, as calloc()
+ */
+void * barcode_calloc(size_t, size_t);
+
+/**
+ *      @brief Resizes memory with the calling thread's allocator, as realloc()
+ */
+void * barcode_realloc(void *, size_t);
+
+/**
+ *      @brief Frees memory with the calling thread's allocator, as free()
+ */
+void barcode_free(void *);
+
+/**
+ *      @brief Initialises an arena allocating from a buffer.
+ *      @detail Freeing or resizing the most recent allocation gives its memory back; other memory
+ *              is only reclaimed by arena_reset().
+ *      @param arena The arena to initialise
+ *      @param buf The memory to allocate from, aligned to ALLOC_ALIGN, such as from malloc()
+ *      @param cap The size of @c buf in bytes
+ */
+void arena_init(Arena *, void *, size_t);
+
+/**
+ *      @brief Frees every allocation made from an arena at once, keeping its peak usage.
+ */
+void arena_reset(Arena *);
+
+/**
+ *      @brief Initialises a pool of equally sized blocks in a buffer.
+ *      @detail Requests larger than a block fail.
+ *      @param pool The pool to initialise
+ *      @param buf The memory to allocate from, aligned to ALLOC_ALIGN, such as from malloc()
+ *      @param cap The size of @c buf in bytes
+ *      @param block_size The size of each block, rounded up to a multiple of ALLOC_ALIGN
+ */
+void pool_init(Pool *, void *, size_t, size_t);
+
+#endif /* ALLOC_H */
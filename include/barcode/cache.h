@@ -0,0 +1,138 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file cache.h
+ *      @brief Declarations for caches of pre-rendered barcode symbols.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "cursor.h"
+#include "graphic.h"
+#include "symb.h"
+
+#include <stddef.h>
+
+/**
+ *      @defgroup CacheProperties Properties of render caches
+ */
+/*@{*/
+/*      @brief Number of distinct Code 128 symbols: the data symbols, three starts and the stop */
+#define C128_NUM_SYMBOLS  (C128_CODE_SIZE + 4)
+#define C128_START_SYMBOL C128_CODE_SIZE
+#define C128_STOP_SYMBOL  (C128_CODE_SIZE + 3)
+/*      @brief Marks a pattern that is not a Code 128 symbol in RenderCache::symbols */
+#define C128_NO_SYMBOL    0xFF
+/*      @brief Documents with at least this many barcodes build a cache while they are rendered */
+#define PS_CACHE_MIN_CODES 16
+#define SVG_RECT_PREFIX   "<rect x=\""
+#define SVG_BLACK_SUFFIX                                                                           \
+    "\" y=\"" XSTR(SVG_DEFAULT_Y) "\" width=\"" XSTR(SVG_RECT_WIDTH)                               \
+    "\" height=\"" XSTR(SVG_RECT_HEIGHT) "\" fill=\"black\"/>"
+/*@}*/
+
+/**
+ *      @brief Pre-rendered output of every Code 128 symbol for one set of PSProperties.
+ */
+typedef struct SymbolCache RenderCache;
+
+/**
+ *      @detail Every symbol always renders to the same PostScript, as PostScript bars are drawn
+ *              relative to the current position, so a cache holds the output of each symbol back to
+ *              back in one buffer and a barcode is rendered by copying its symbols' fragments in
+ *              turn. SVG rectangles carry absolute x-coordinates, so for SVG the cache instead
+ *              holds the module offsets of each symbol's black bars, and only the coordinate of
+ *              each rectangle is formatted.
+ */
+struct SymbolCache {
+    PSProperties props;                            /**< Properties fragments are rendered with */
+    uchar        symbols[C128_INVERSE_SIZE];       /**< Maps a 9-bit pattern to a symbol index */
+    char *       ps;                               /**< PostScript fragments, back to back */
+    size_t       ps_offsets[C128_NUM_SYMBOLS + 1]; /**< Start of each fragment in @c ps */
+    uchar        svg_bars[C128_NUM_SYMBOLS][C128_STOP_WIDTH]; /**< Black module offsets */
+    uchar        svg_num_bars[C128_NUM_SYMBOLS];              /**< Number of black modules */
+};
+
+/**
+ *      @brief Pre-renders every Code 128 symbol with the given properties.
+ *      @param cache The cache to initialise. Free it with c128_cache_free().
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @return SUCCESS
+ */
+int c128_cache_init(RenderCache *, const PSProperties *);
+
+/**
+ *      @brief Frees the memory held by a cache initialised by c128_cache_init().
+ *      @param cache The cache to free
+ */
+void c128_cache_free(RenderCache *);
+
+/**
+ *      @brief Looks up the symbol index of a pattern in a barcode.
+ *      @param cache The cache
+ *      @param code The barcode
+ *      @param i The index of the pattern in @c code
+ *      @return The symbol index, or C128_NO_SYMBOL if the pattern is not a Code 128 symbol
+ */
+int c128_cache_symbol(const RenderCache *, Code128 *, int);
+
+/**
+ *      @brief Generates a PostScript representation of a complete Code 128 barcode from a cache.
+ *             The output is identical to that of c128_ps() with the cache's properties.
+ *      @param code A pointer to a Code128 struct containing the barcode to be printed
+ *      @param dest The destination cursor
+ *      @param cache A cache initialised by c128_cache_init()
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ *      @see c128_ps
+ */
+int c128_ps_cached(Code128 *, Cursor *, const RenderCache *);
+
+/**
+ *      @brief Writes an SVG representation of a complete Code 128 barcode to a cursor using a
+ *             cache. The output is identical to that of c128_svg_write().
+ *      @param code A pointer to a Code128 struct containing the barcode to be used
+ *      @param dest The destination cursor
+ *      @param cache A cache initialised by c128_cache_init()
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ *      @see c128_svg_write
+ */
+int c128_svg_cached(Code128 *, Cursor *, const RenderCache *);
+
+/**
+ *      @brief Writes a single page of a paged PostScript document to a cursor using a cache.
+ *      @param codes A double pointer to the Code128 structs to be printed on this page
+ *      @param num_codes The number of barcodes on this page
+ *      @param page The ordinal of the page, starting from 1
+ *      @param dest The destination cursor
+ *      @param cache A cache initialised by c128_cache_init() with the document's properties
+ *      @param layout A pointer to a Layout struct
+ *      @return SUCCESS, ERR_BUFFER_SIZE or ERR_INVALID_LAYOUT
+ *      @see c128_ps_page
+ */
+int c128_ps_page_cached(Code128 **, int, int, Cursor *, const RenderCache *, Layout *);
+
+/**
+ *      @brief Writes the barcodes of a layout, to be preceded by c128_ps_header() and followed by
+ *             c128_ps_footer(). The three together are identical to the output of c128_ps_layout().
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @param cache A cache initialised by c128_cache_init() with @c props, or NULL
+ *      @return SUCCESS or ERR_INVALID_LAYOUT
+ *      @see c128_ps_layout
+ */
+int c128_ps_cells(Code128 **, int, Cursor *, const PSProperties *, Layout *, const RenderCache *);
+
+#endif /* CACHE_H */
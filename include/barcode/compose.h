@@ -0,0 +1,81 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file compose.h
+ *      @brief Declarations for compositing whole pages of barcodes into bitmaps on multiple
+ *             threads.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @see raster.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include "graphic.h"
+#include "raster.h"
+#include "symb.h"
+
+/**
+ *      @defgroup ComposeProperties Properties of composited pages
+ */
+/*@{*/
+/*      @brief Number of rows of pixels in a band, the unit of work of a thread */
+#define COMPOSE_BAND_ROWS 128
+/*      @brief Default number of bands that may be rendered ahead of the output, per thread */
+#define COMPOSE_WINDOW_PER_THREAD 2
+/*      @brief Size of a glyph of the built-in font, and of the cell it is drawn in */
+#define FONT_GLYPH_WIDTH 5
+#define FONT_GLYPH_HEIGHT 7
+#define FONT_ADVANCE 6
+/*      @brief Points per pixel of the built-in font at a scale of 1, giving a cap height of about
+ *             0.7 of the font size */
+#define FONT_POINTS_PER_PIXEL 10
+/*@}*/
+
+/**
+ *      @brief Image formats a page can be written in
+ */
+typedef enum RasterFormat RasterFormat;
+
+enum RasterFormat { RASTER_PBM = 0, RASTER_PNG, RASTER_ESCPOS };
+
+/**
+ *      @brief Writes a page of barcodes laid out as by c128_ps_layout(), with their text, to a sink
+ *             as a 1-bit image, rendering it on multiple threads
+ *      @detail The page is divided into bands of COMPOSE_BAND_ROWS rows, which a pool of worker
+ *              threads render concurrently and the calling thread writes out in order as each
+ *              becomes ready: as rows of a PBM, as one IDAT chunk per band of a PNG, or as one
+ *              ESC/POS @c GS v 0 image per band. At most
+ *              <tt>COMPOSE_WINDOW_PER_THREAD * threads</tt> bands are in memory at once, never the
+ *              whole page. Barcodes are placed as by c128_pdf() and their text is drawn in a
+ *              built-in 5x7 pixel font scaled to the font size.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param out The sink to write the image to
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @param dpi The resolution in dots per inch
+ *      @param format The image format
+ *      @param threads The number of worker threads
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_DATA_LENGTH, ERR_INVALID_LAYOUT when num_codes exceeds
+ *              <tt>layout->cols * layout->rows</tt>, or ERR_IO
+ *      @see c128_raster
+ */
+int c128_raster_layout(Code128 **,
+                       int,
+                       const Sink *,
+                       const PSProperties *,
+                       Layout *,
+                       int,
+                       RasterFormat,
+                       int);
+
+#endif /* COMPOSE_H */
@@ -0,0 +1,123 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file context.h
+ *      @brief Declarations for reusable contexts that encode and render without allocating.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "cache.h"
+#include "cursor.h"
+#include "graphic.h"
+#include "symb.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ *      @brief The buffers and settings of one thread encoding and rendering barcodes in turn.
+ */
+typedef struct BarcodeContext BarcodeCtx;
+
+/**
+ *      @brief Work done by a context since it was initialised.
+ */
+typedef struct BarcodeContextStats CtxStats;
+
+struct BarcodeContextStats {
+    size_t encodes; /**< Number of barcodes encoded */
+    size_t renders; /**< Number of documents rendered */
+    size_t bytes;   /**< Total length of the documents rendered */
+    size_t grows;   /**< Number of times the output buffer had to grow */
+    size_t errors;  /**< Number of calls that failed */
+};
+
+/**
+ *      @detail A context holds everything a call would otherwise allocate: a render cache for its
+ *              properties, the PostScript header formatted once, an output buffer that grows to
+ *              the largest document rendered and is then reused, and storage for the last barcode
+ *              encoded. Once the output buffer has grown, encoding and rendering allocate nothing.
+ *
+ *              A context is not safe to share between threads, but nothing in it is shared, so
+ *              each thread may use its own. init_barcode() must have been called first.
+ */
+struct BarcodeContext {
+    RenderCache cache;  /**< Symbol fragments, which also hold the properties of the context */
+    bool        cached; /**< Whether PostScript is rendered from @c cache, false for images */
+    Cursor      header; /**< The output of c128_ps_header() for the context's properties */
+    Cursor      out;    /**< Buffer documents are rendered into */
+    Code128     code;   /**< The barcode last encoded by barcode_ctx_encode() */
+    pattern     patterns[C128_MAX_PATTERN_SIZE]; /**< Storage for the patterns of @c code */
+    CtxStats    stats;
+};
+
+/**
+ *      @brief Initialises a context rendering with the given properties
+ *      @param ctx The context to initialise. Free it with barcode_ctx_free().
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @return SUCCESS
+ */
+int barcode_ctx_init(BarcodeCtx *, const PSProperties *);
+
+/**
+ *      @brief Frees the memory held by a context
+ *      @param ctx The context to free
+ */
+void barcode_ctx_free(BarcodeCtx *);
+
+/**
+ *      @brief Encodes data into the context's barcode, without allocating
+ *      @param ctx The context
+ *      @param data The data to be encoded
+ *      @param data_len The length of the data array
+ *      @param dest Set to the barcode, which belongs to the context and is valid until it next
+ *             encodes
+ *      @return As c128_encode()
+ *      @see c128_encode_into
+ */
+int barcode_ctx_encode(BarcodeCtx *, uchar *, int, Code128 **);
+
+/**
+ *      @brief Renders a barcode as SVG into the context's output buffer
+ *      @param ctx The context
+ *      @param code A pointer to a Code128 struct containing the barcode to be rendered
+ *      @param dest Set to the null-terminated document, which belongs to the context and is valid
+ *             until it next renders. The output is identical to that of c128_svg().
+ *      @param len Set to the length of the document, if not NULL
+ *      @return SUCCESS
+ */
+int barcode_ctx_svg(BarcodeCtx *, Code128 *, const char **, size_t *);
+
+/**
+ *      @brief Renders a barcode as a PostScript document of its own into the context's output
+ *             buffer, as c128_ps_header(), c128_ps() and c128_ps_footer() in turn
+ *      @return SUCCESS
+ *      @see barcode_ctx_svg
+ */
+int barcode_ctx_ps(BarcodeCtx *, Code128 *, const char **, size_t *);
+
+/**
+ *      @brief Renders barcodes laid out on a page into the context's output buffer
+ *      @detail The output is identical to that of c128_ps_layout().
+ *      @param ctx The context
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @param dest As for barcode_ctx_svg()
+ *      @param len As for barcode_ctx_svg()
+ *      @return SUCCESS or ERR_INVALID_LAYOUT
+ */
+int barcode_ctx_ps_layout(BarcodeCtx *, Code128 **, int, Layout *, const char **, size_t *);
+
+#endif /* CONTEXT_H */
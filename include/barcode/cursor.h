@@ -0,0 +1,175 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file cursor.h
+ *      @brief Declarations for output cursors, which append rendered output to a buffer.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include "util.h"
+
+#include <stddef.h>
+
+/**
+ *      @brief Size of the stack buffer used by cursor_printf() before falling back to the heap
+ */
+#define CURSOR_FMT_BUFSIZE 1024
+
+/**
+ *      @brief Size of the buffer used by the streaming renderers between the renderer and a sink
+ */
+#define CURSOR_SINK_BUFSIZE 4096
+
+/**
+ *      @brief A write position in an output buffer.
+ */
+typedef struct OutputCursor Cursor;
+
+/**
+ *      @brief Writes the whole of @c len bytes of output somewhere, returning SUCCESS or ERR_IO
+ */
+typedef int (*SinkWrite)(void *, const char *, size_t);
+
+/**
+ *      @brief A destination that output is streamed to through a cursor's buffer.
+ */
+typedef struct OutputSink Sink;
+
+/**
+ *      @detail Renderers append to a cursor instead of calling @c strncat on the whole document, so
+ *              each append costs only the length of what is appended. A cursor whose buffer is NULL
+ *              writes nothing and only counts bytes, which is how the exact size of a document is
+ *              measured before it is allocated. Likewise, a cursor keeps counting once its buffer
+ *              is full, so after an overflow @c pos is the size the output needed and the output
+ *              can be re-rendered after cursor_grow(). Cursors never write a null terminator; see
+ *              cursor_str().
+ *
+ *              A cursor with a sink (see cursor_init_sink()) instead treats its buffer as a staging
+ *              area: whenever it fills up, its contents are passed to the sink and the buffer is
+ *              reused, so output of any size is written in constant memory.
+ */
+struct OutputCursor {
+    char *       buf;     /**< Destination buffer, or NULL to only measure output */
+    size_t       pos;     /**< Number of bytes written so far */
+    size_t       cap;     /**< Capacity of @c buf in bytes */
+    const Sink * sink;    /**< Where full buffers are written, or NULL */
+    size_t       flushed; /**< Number of bytes passed to @c sink so far */
+    int          status;  /**< The first error returned by @c sink, after which nothing is sent */
+};
+
+struct OutputSink {
+    SinkWrite write; /**< Called with each full buffer */
+    void *    ctx;   /**< Passed to @c write */
+};
+
+/**
+ *      @brief Initialises a cursor at the start of a buffer.
+ *      @param cursor The cursor to initialise
+ *      @param buf The destination buffer, or NULL to measure output only
+ *      @param cap The capacity of @c buf
+ */
+void cursor_init(Cursor *, char *, size_t);
+
+/**
+ *      @brief Initialises a cursor that streams its output to a sink through a buffer.
+ *      @param cursor The cursor to initialise
+ *      @param buf The buffer output is staged in
+ *      @param cap The capacity of @c buf
+ *      @param sink The sink output is written to
+ */
+void cursor_init_sink(Cursor *, char *, size_t, const Sink *);
+
+/**
+ *      @brief Allocates exactly enough memory for @c size bytes of output and a null terminator and
+ *             initialises a cursor on it.
+ *      @param cursor The cursor to initialise
+ *      @param size The number of bytes that will be written, e.g. as measured by a NULL cursor
+ *      @return SUCCESS
+ */
+int cursor_alloc(Cursor *, size_t);
+
+/**
+ *      @brief Resizes the buffer of a heap-allocated cursor to hold at least @c size bytes of
+ *             output and a null terminator, and rewinds it to the start.
+ *      @param cursor The cursor, initialised by cursor_alloc() or with a NULL buffer
+ *      @param size The number of bytes that will be written
+ *      @return SUCCESS
+ */
+int cursor_grow(Cursor *, size_t);
+
+/**
+ *      @brief Returns true if more was written to the cursor than fits in its buffer.
+ */
+#define CURSOR_OVERFLOWED(cursor) (NULL == (cursor)->sink && (cursor)->pos > (cursor)->cap)
+
+/**
+ *      @brief Appends @c len bytes to the cursor.
+ *      @param cursor The destination cursor
+ *      @param data The bytes to append
+ *      @param len The number of bytes in @c data
+ *      @return SUCCESS or ERR_BUFFER_SIZE if the bytes do not fit, in which case nothing is written
+ *              but @c pos is still advanced. Cursors with a sink return ERR_IO once the sink fails.
+ */
+int cursor_write(Cursor *, const char *, size_t);
+
+/**
+ *      @brief Appends a string (excluding its null terminator) to the cursor.
+ *      @param cursor The destination cursor
+ *      @param str The string to append
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ *      @see cursor_write
+ */
+int cursor_puts(Cursor *, const char *);
+
+/**
+ *      @brief Appends formatted output to the cursor.
+ *      @param cursor The destination cursor
+ *      @param fmt A printf() format string
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ *      @see cursor_write
+ */
+int cursor_printf(Cursor *, const char *, ...);
+
+/**
+ *      @brief Appends an integer formatted by fmt_int() to the cursor.
+ *      @param cursor The destination cursor
+ *      @param value The integer to append
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ */
+int cursor_int(Cursor *, long long);
+
+/**
+ *      @brief Appends a micro-unit length formatted by fmt_micro() to the cursor.
+ *      @param cursor The destination cursor
+ *      @param value The length to append
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ */
+int cursor_micro(Cursor *, micro);
+
+/**
+ *      @brief Passes any output still in the buffer of a cursor with a sink to the sink.
+ *      @param cursor The cursor
+ *      @return SUCCESS or ERR_IO if the sink failed at any point
+ */
+int cursor_flush(Cursor *);
+
+/**
+ *      @brief Null-terminates the output of a cursor initialised by cursor_alloc().
+ *      @param cursor The cursor
+ *      @return The cursor's buffer, or NULL if the cursor has no buffer, has a sink or has
+ *              overflowed, as there is then no room for the terminator after its output
+ */
+char * cursor_str(Cursor *);
+
+#endif /* CURSOR_H */
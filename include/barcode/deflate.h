@@ -0,0 +1,139 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file deflate.h
+ *      @brief Declarations for the built-in DEFLATE compressor and its gzip and zlib sinks.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @see sink.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include "cursor.h"
+
+#include <stdint.h>
+
+/**
+ *      @defgroup DeflateProperties Properties of the DEFLATE compressor
+ */
+/*@{*/
+/*      @brief Size of the sliding window that matches are searched for in */
+#define DEFLATE_WSIZE 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+/*      @brief Input is compressed in blocks of at most this many bytes */
+#define DEFLATE_BLOCK_SIZE DEFLATE_WSIZE
+/*      @brief Fits a whole block in fixed Huffman codes, at worst 9 bits per byte */
+#define DEFLATE_OUT_BUFSIZE (DEFLATE_BLOCK_SIZE / 8 * 9 + 64)
+/*      @brief Stores blocks without looking for matches */
+#define DEFLATE_LEVEL_STORE 0
+#define DEFLATE_LEVEL_DEFAULT 4
+#define DEFLATE_LEVEL_MAX 9
+/*      @brief Number of hash chain entries searched for each match, per level */
+#define DEFLATE_CHAIN_PER_LEVEL 8
+/*@}*/
+
+/**
+ *      @brief The wrapping of a compressed stream: gzip (RFC 1952) or zlib (RFC 1950), as in PNG
+ */
+typedef enum DeflateFormat DeflateFormat;
+
+enum DeflateFormat { DEFLATE_GZIP = 0, DEFLATE_ZLIB };
+
+/**
+ *      @brief A gzip stream that compresses output on its way to another sink.
+ */
+typedef struct GzipStream GzipSink;
+
+/**
+ *      @detail Input is collected in the second half of @c window, with the previous block kept in
+ *              the first half as history for matches. Positions in @c head and @c prev are indices
+ *              into @c window, or -1, and are moved down along with the window when it slides.
+ *              Each block is encoded with the fixed Huffman codes of RFC 1951, as barcode documents
+ *              are made of so few distinct symbols that dynamic code tables rarely pay for
+ *              themselves, unless a stored block would be smaller.
+ */
+struct GzipStream {
+    const Sink *  out;       /**< The sink compressed output is written to */
+    DeflateFormat format;    /**< The header and trailer written around the compressed data */
+    int           max_chain; /**< Hash chain entries searched per match, or 0 to only store */
+    int           status;    /**< The first error returned by @c out */
+    uint32_t      crc;       /**< CRC-32 of the input so far, for DEFLATE_GZIP */
+    uint32_t      adler;     /**< Adler-32 of the input so far, for DEFLATE_ZLIB */
+    uint32_t      size;      /**< Length of the input so far, modulo 2^32 */
+    int           start;     /**< Start of the input in @c window not yet compressed */
+    int           end;       /**< End of the input in @c window */
+    uint64_t      bits;      /**< Bits not yet moved to @c outbuf, least significant first */
+    int           num_bits;  /**< Number of bits in @c bits */
+    int           out_len;   /**< Number of bytes in @c outbuf */
+    uint32_t      crc_table[256];
+    uint16_t      lit_codes[288]; /**< Bit-reversed fixed Huffman literal/length codes */
+    uint8_t       lit_lens[288];  /**< Lengths of @c lit_codes */
+    int32_t       head[DEFLATE_HASH_SIZE];
+    int32_t       prev[2 * DEFLATE_WSIZE];
+    uint8_t       window[2 * DEFLATE_WSIZE];
+    uint8_t       outbuf[DEFLATE_OUT_BUFSIZE];
+};
+
+/**
+ *      @brief Creates a sink that gzip-compresses everything written to it, e.g. to make @c .svgz
+ *             files from c128_svg_stream(), and writes the gzip header.
+ *      @param sink The sink to initialise
+ *      @param gz A double pointer to the stream, whose memory is allocated internally and freed by
+ *             sink_gzip_finish()
+ *      @param out The sink compressed output is written to
+ *      @param level DEFLATE_LEVEL_STORE to store the input uncompressed, or up to
+ *             DEFLATE_LEVEL_MAX to search for matches for longer
+ *      @return SUCCESS or ERR_IO
+ */
+int sink_gzip(Sink *, GzipSink **, const Sink *, int);
+
+/**
+ *      @brief Creates a sink that compresses everything written to it into a zlib stream, such as
+ *             the image data of a PNG, and writes the zlib header.
+ *      @param sink The sink to initialise
+ *      @param gz A double pointer to the stream, freed by sink_gzip_finish()
+ *      @param out The sink compressed output is written to
+ *      @param level DEFLATE_LEVEL_STORE to store the input uncompressed, or up to
+ *             DEFLATE_LEVEL_MAX to search for matches for longer
+ *      @return SUCCESS or ERR_IO
+ *      @see sink_gzip
+ */
+int sink_zlib(Sink *, GzipSink **, const Sink *, int);
+
+/**
+ *      @brief Compresses any remaining input, writes the final block and the gzip or zlib trailer,
+ *             and frees the stream.
+ *      @param gz The stream, which must not be used afterwards
+ *      @return SUCCESS or ERR_IO if the output sink failed at any point
+ */
+int sink_gzip_finish(GzipSink *);
+
+/**
+ *      @brief Fills a table for deflate_crc32().
+ *      @param table The table to fill
+ */
+void deflate_crc_table(uint32_t *);
+
+/**
+ *      @brief Continues a CRC-32 (as used by gzip and PNG) over more data.
+ *      @param table A table filled by deflate_crc_table()
+ *      @param crc The CRC-32 of the data so far, starting from 0
+ *      @param data The data
+ *      @param len The length of @c data
+ *      @return The CRC-32 of all of the data
+ */
+uint32_t deflate_crc32(const uint32_t *, uint32_t, const uint8_t *, size_t);
+
+#endif /* DEFLATE_H */
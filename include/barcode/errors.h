@@ -31,7 +31,10 @@
 #define ERR_ALREADY_INITIALISED 6
 #define ERR_NULL_PATTERN        7
 #define ERR_INVALID_LAYOUT      8
-#define BARCODE_MAX_ERR         ERR_INVALID_LAYOUT
+#define ERR_BUFFER_SIZE         9
+#define ERR_IO                  10
+#define ERR_UNSUPPORTED         11
+#define BARCODE_MAX_ERR         ERR_UNSUPPORTED
 /*@}*/
 
 // clang-format on
@@ -0,0 +1,85 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file export.h
+ *      @brief Declarations for exporting batches of barcodes to one file each.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "symb.h"
+
+#include <stdbool.h>
+
+/**
+ *      @defgroup ExportProperties Properties of bulk exports
+ */
+/*@{*/
+/*      @brief Number of files rendered and submitted to io_uring together */
+#define EXPORT_BATCH 64
+/*      @brief Maximum length of the path of an exported file, including the null terminator */
+#define EXPORT_PATH_MAX 4096
+/*      @brief Initial capacity of each pooled render buffer, grown as needed */
+#define EXPORT_BUFSIZE 8192
+/*@}*/
+
+/**
+ *      @brief Writes each barcode as an SVG to its own file, using io_uring where the kernel
+ *             supports it and a pool of threads otherwise.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be exported
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param path_fmt A printf() format string with a single @c %d conversion, which is given the
+ *             index of each barcode to make the path of its file, e.g. <tt>"out/%06d.svg"</tt>.
+ *             Any other format is rejected with ERR_ARGUMENT, see c128_export_path_valid().
+ *      @param threads The number of threads to use if io_uring is unavailable
+ *      @return SUCCESS, ERR_ARGUMENT or ERR_IO if any file could not be written
+ *      @see c128_svg_export_uring
+ *      @see c128_svg_export_threads
+ */
+int c128_svg_export(Code128 **, int, const char *, int);
+
+/**
+ *      @brief Checks that a path format has exactly one @c %d conversion, besides any @c %%, and so
+ *             is safe to pass the index of a barcode.
+ *      @param path_fmt The format to check
+ *      @return Whether the format is valid
+ */
+bool c128_export_path_valid(const char *);
+
+/**
+ *      @brief Writes each barcode as an SVG to its own file through io_uring.
+ *      @detail Barcodes are rendered in batches of EXPORT_BATCH into pooled buffers. The files of a
+ *              batch are opened with a single submission, then each file's write and close are
+ *              submitted together as a linked pair, so a batch costs two system calls rather than
+ *              three per file.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be exported
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param path_fmt A printf() format string for the path of each file, see c128_svg_export()
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_IO or ERR_UNSUPPORTED if io_uring or the operations used
+ *              are not supported, or the platform is not Linux, in which case no files have been
+ *              written
+ */
+int c128_svg_export_uring(Code128 **, int, const char *);
+
+/**
+ *      @brief Writes each barcode as an SVG to its own file, on a pool of threads using blocking
+ *             I/O.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be exported
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param path_fmt A printf() format string for the path of each file, see c128_svg_export()
+ *      @param threads The number of threads
+ *      @return SUCCESS, ERR_ARGUMENT or ERR_IO
+ */
+int c128_svg_export_threads(Code128 **, int, const char *, int);
+
+#endif /* EXPORT_H */
@@ -18,7 +18,9 @@
 #ifndef GRAPHIC_H
 #define GRAPHIC_H
 
+#include "cursor.h"
 #include "symb.h"
+#include "util.h"
 
 #include <string.h>
 
@@ -48,6 +50,10 @@
 
 #define SVG_RECT_BUFSIZE (55 + SVG_COLOUR_LEN)
 #define SVG_TEXT_BUFSIZE 146
+#define SVG_TEXT                                                                                   \
+    "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" font-family=\"Helvetica\" "                    \
+    "font-size=\"%d\" fill=\"black\">"
+#define SVG_TEXT_SUFFIX "</text>"
 
 /*      @brief y-coordinate of barcode rectangles */
 #define SVG_DEFAULT_Y 0
@@ -61,20 +67,20 @@
  *      @defgroup PSProperties Properties of PostScript barcode outputs
  */
 /*@{*/
-#define PS_HEADER                                                                                  \
-    "%%!PS\n"                                                                                      \
+/*      @brief Procedures and page properties shared by every PostScript document */
+#define PS_PROLOG                                                                                  \
     "/p {0 add} def\n"                                                                             \
     "/in {72 mul} def\n"                                                                           \
     "/mm {in 25.4 div} def\n"                                                                      \
     "/u {%s} def\n"                                                                                \
-    "/lmargin %0.9f u def\n"                                                                       \
-    "/rmargin %0.9f u def\n"                                                                       \
-    "/tmargin %0.9f u def\n"                                                                       \
-    "/bmargin %0.9f u def\n"                                                                       \
-    "/BAR_W %0.9f u def\n"                                                                         \
-    "/BAR_H %0.9f u def\n"                                                                         \
-    "/PAD %0.9f u def\n"                                                                           \
-    "/COL_W %0.9f u def\n"                                                                         \
+    "/lmargin %s u def\n"                                                                          \
+    "/rmargin %s u def\n"                                                                          \
+    "/tmargin %s u def\n"                                                                          \
+    "/bmargin %s u def\n"                                                                          \
+    "/BAR_W %s u def\n"                                                                            \
+    "/BAR_H %s u def\n"                                                                            \
+    "/PAD %s u def\n"                                                                              \
+    "/COL_W %s u def\n"                                                                            \
     "/neg {-1 mul} def\n"                                                                          \
     "/x //lmargin def\n"                                                                           \
     "/y //bmargin //PAD add def\n"                                                                 \
@@ -96,17 +102,48 @@
     "  0 setgray fill\n"                                                                           \
     "  /x x //BAR_W add def\n"                                                                     \
     "} def\n"
-#define PS_HEADER_BUFSIZE 1024
+/*      @brief Procedures used by PS_MODE_RUNLENGTH to draw a bar or skip a space of n modules */
+#define PS_RUN_PROCS                                                                               \
+    "/B {\n"                                                                                       \
+    "  //BAR_W mul dup x y 3 -1 roll //BAR_H rectfill\n"                                           \
+    "  /x exch x add def\n"                                                                        \
+    "} def\n" PS_SPACE_PROC
+#define PS_SPACE_PROC "/S {//BAR_W mul x add /x exch def} def\n"
+/*      @brief Procedure used by PS_MODE_IMAGE to draw a row of n modules from a hex string */
+#define PS_IMAGE_PROCS                                                                             \
+    "/I {\n"                                                                                       \
+    "  /img_w exch def /img_s exch def\n"                                                          \
+    "  gsave x y translate img_w //BAR_W mul //BAR_H scale\n"                                      \
+    "  img_w 1 true [img_w 0 0 1 0 0] {img_s} imagemask grestore\n"                                \
+    "  /x x img_w //BAR_W mul add def\n"                                                           \
+    "} def\n" PS_SPACE_PROC
 #define PS_FOOTER "showpage\n"
 #define PS_FOOTER_LEN 9
+/*      @brief Document Structuring Conventions comments preceding the prolog of a paged document */
+#define PS_DSC_HEADER                                                                              \
+    "%%!PS-Adobe-3.0\n"                                                                            \
+    "%%%%Creator: libbarcode\n"                                                                    \
+    "%%%%Pages: %d\n"                                                                              \
+    "%%%%EndComments\n"
+#define PS_DSC_END_PROLOG "%%EndProlog\n"
+/*      @brief Each page is enclosed in save/restore so that pages are independent of each other */
+#define PS_DSC_PAGE                                                                                \
+    "%%%%Page: %d %d\n"                                                                            \
+    "/pgsave save def\n"                                                                           \
+    "reset_x reset_y\n"
+#define PS_DSC_PAGE_END "pgsave restore\nshowpage\n"
+#define PS_DSC_TRAILER "%%Trailer\n%%EOF\n"
 #define PS_TEXT                                                                                    \
     "/Helvetica findfont\n"                                                                        \
     "/fontsize %d def\n"                                                                           \
     "fontsize scalefont\n"                                                                         \
     "setfont\n"                                                                                    \
-    "/str (%s) def\n"                                                                              \
+    "/str ("
+/*      @brief The text is written between PS_TEXT and PS_TEXT_SUFFIX */
+#define PS_TEXT_SUFFIX                                                                             \
+    ") def\n"                                                                                      \
     "newpath\n"                                                                                    \
-    "x %d u sub y //PAD sub moveto\n"                                                              \
+    "x %s u sub y //PAD sub moveto\n"                                                              \
     "str stringwidth pop 2 div neg 0 rmoveto\n"                                                    \
     "str show\n"                                                                                   \
     "closepath\n"
@@ -117,13 +154,22 @@
 #define PS_PAD 5       // mm
 #define PS_COL_W 94    // mm
 #define PS_BAR "bar\n"
-#define PS_WSPACE "/x %d //BAR_W mul x add def\n"
+/*      @brief Commands with a variable number are written as a prefix, the number and a suffix */
+#define PS_WSPACE "/x "
+#define PS_WSPACE_SUFFIX " //BAR_W mul x add def\n"
 #define PS_PADX "pad_x\n"
 #define PS_PADY "pad_y\n"
 #define PS_RESET_X "reset_x\n"
 #define PS_RESET_Y "reset_y\n"
-#define PS_COL_POS "/x //lmargin %0.9f u add %d mul def\n"
-#define PS_RPOS "%0.9f u %0.9f u rpos\n"
+#define PS_COL_POS "/x //lmargin "
+#define PS_COL_POS_INFIX " u add "
+#define PS_COL_POS_SUFFIX " mul def\n"
+#define PS_RPOS_INFIX " u "
+#define PS_RPOS_SUFFIX " u rpos\n"
+#define PS_RUN_BAR " B\n"
+#define PS_RUN_SPACE " S\n"
+#define PS_IMAGE "> "
+#define PS_IMAGE_SUFFIX " I\n"
 #define PS_CMD_BUFSIZE 64
 #define PS_FONT_SIZE 10
 #define PS_TEXT_BUFSIZE 254
@@ -131,11 +177,76 @@
 
 /*@}*/
 
+/**
+ *      @defgroup PDFProperties Properties of PDF barcode outputs
+ */
+/*@{*/
+/*      @brief The second line marks the file as binary for transfer programs */
+#define PDF_HEADER "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n"
+/*      @brief Object numbers of the objects every document has. Barcodes and pages follow. */
+#define PDF_CATALOG_OBJ 1
+#define PDF_PAGES_OBJ 2
+#define PDF_FONT_OBJ 3
+#define PDF_RESOURCES_OBJ 4
+#define PDF_FIRST_OBJ 5
+#define PDF_OBJ "%d 0 obj\n"
+#define PDF_ENDOBJ "endobj\n"
+#define PDF_CATALOG "<< /Type /Catalog /Pages " XSTR(PDF_PAGES_OBJ) " 0 R >>\n"
+#define PDF_FONT                                                                                   \
+    "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica "                                         \
+    "/Encoding /WinAnsiEncoding >>\n"
+/*      @brief Each distinct barcode is drawn once as a form, with the BBox and Length following */
+#define PDF_FORM                                                                                   \
+    "<< /Type /XObject /Subtype /Form "                                                            \
+    "/Resources << /Font << /F1 " XSTR(PDF_FONT_OBJ) " 0 R >> >> /BBox ["
+#define PDF_FORM_LENGTH "] /Length "
+#define PDF_STREAM "<< /Length "
+#define PDF_STREAM_BEGIN " >>\nstream\n"
+#define PDF_STREAM_END "\nendstream\n"
+#define PDF_PAGE                                                                                   \
+    "<< /Type /Page /Parent " XSTR(PDF_PAGES_OBJ) " 0 R "                                          \
+    "/Resources " XSTR(PDF_RESOURCES_OBJ) " 0 R /Contents %d 0 R >>\n"
+#define PDF_PAGES "<< /Type /Pages /Count %d /MediaBox [0 0 %s %s] /Kids ["
+#define PDF_PAGES_END "] >>\n"
+#define PDF_RESOURCES "<< /Font << /F1 " XSTR(PDF_FONT_OBJ) " 0 R >> /XObject <<"
+#define PDF_RESOURCES_END " >> >>\n"
+/*      @brief Places a form with its origin at a point, given by the prefix, x, y and suffix */
+#define PDF_PLACE "q 1 0 0 1 "
+#define PDF_PLACE_SUFFIX " cm /X%d Do Q\n"
+/*      @brief Bars are drawn in modules, scaled by the bar width and height, as @c re rectangles */
+#define PDF_BARS_SCALE "q %s 0 0 %s 0 0 cm\n"
+#define PDF_BAR_SUFFIX " 0 %d 1 re\n"
+#define PDF_BARS_END "f Q\n"
+/*      @brief Used by PS_MODE_IMAGE to draw a whole barcode as an inline 1-bit image mask */
+#define PDF_IMAGE "q %s 0 0 %s %s 0 cm\nBI /W %d /H 1 /IM true /D [1 0] /F /AHx ID\n"
+#define PDF_IMAGE_END "> EI Q\n"
+#define PDF_TEXT "BT /F1 %d Tf %s %s Td ("
+#define PDF_TEXT_SUFFIX ") Tj ET"
+#define PDF_XREF "xref\n0 %d\n0000000000 65535 f \n"
+/*      @brief Cross-reference entries must be exactly 20 bytes long */
+#define PDF_XREF_ENTRY "%010zu 00000 n \n"
+#define PDF_TRAILER                                                                                \
+    "trailer\n<< /Size %d /Root " XSTR(PDF_CATALOG_OBJ) " 0 R >>\n"                                \
+    "startxref\n%zu\n%%%%EOF\n"
+/*      @brief Width of characters missing from the Helvetica metrics, in thousandths of an em */
+#define PDF_DEFAULT_CHAR_WIDTH 556
+/*@}*/
+
 /**
  *      @brief Enumeration of types of bars in a barcode – black or white
  */
 typedef enum BarcodeColour BarType;
 
+/**
+ *      @brief Methods of drawing the bars of a PostScript barcode
+ */
+typedef enum PSBarMode PSMode;
+
+/**
+ *      @brief Characters that must be escaped in the text of a given output format
+ */
+typedef enum TextEscape TextEscape;
+
 /**
  *      @brief Represents layout options for a PostScript Document
  *      @see PS_DEFAULT_PROPS
@@ -149,6 +260,21 @@ typedef struct PageLayout Layout;
 
 enum BarcodeColour { White = 0, Black = 1 };
 
+/**
+ *      @detail PS_MODE_MODULE draws every black module with its own path and advances one module at
+ *              a time. PS_MODE_RUNLENGTH draws each bar as a single rectfill of its real width and
+ *              skips each space with a single move, using the procedures in PS_RUN_PROCS.
+ *              PS_MODE_IMAGE draws the whole barcode as a single one-row 1-bit @c imagemask scaled
+ *              to the bar width and height, using the procedure in PS_IMAGE_PROCS.
+ */
+enum PSBarMode { PS_MODE_MODULE = 0, PS_MODE_RUNLENGTH, PS_MODE_IMAGE };
+
+/**
+ *      @detail TEXT_ESCAPE_XML replaces @c < @c > and @c & with entity references. TEXT_ESCAPE_PS
+ *              precedes @c ( @c ) and @c \ with a backslash, as within a PostScript string literal.
+ */
+enum TextEscape { TEXT_ESCAPE_XML = 0, TEXT_ESCAPE_PS };
+
 struct PSProperties {
     char units[3]; /**< The units of all values stored in the struct – one of "p", "mm", "in", "cm"
                     */
@@ -161,6 +287,7 @@ struct PSProperties {
     float        padding;      /**< Amount of padding between barcodes */
     float        column_width; /**< The maximum width of a column of barcodes*/
     unsigned int fontsize;     /**< Font size */
+    PSMode       mode;         /**< How bars are drawn, see PSMode */
 };
 
 struct PageLayout {
@@ -173,6 +300,13 @@ struct PageLayout {
  */
 extern const PSProperties PS_DEFAULT_PROPS;
 
+/**
+ *      @brief Returns the number of points (1/72 in) in one of the units of a PSProperties struct.
+ *      @param units One of "p", "mm", "in" or "cm"
+ *      @return Points per unit, or 1 for unknown units
+ */
+double ps_unit_points(const char *);
+
 /**
  *      @brief Returns the maximum amount of memory (in bytes) needed for a barcode SVG encoding the
  *             supplied number of @c rects.
@@ -196,62 +330,76 @@ size_t ps_bufsize(int);
  *      @param w The width of the rectangle
  *      @param h The height of the rectangle
  *      @param colour The colour of the rectangle as a string (maximum length of SVG_COLOUR_LEN)
- *      @param dest A double pointer to a destination array of size SVG_RECT_BUFSIZE
- *      @return ERR_ARGUMENT or SUCCESS
+ *      @param dest The destination cursor
+ *      @return ERR_ARGUMENT, ERR_BUFFER_SIZE or SUCCESS
+ */
+int svg_rect(int, int, int, int, char *, Cursor *);
+
+/**
+ *      @brief Writes the string representation of barcode text (see c128_strrepr()), escaped for
+ *             an output format, without any intermediate string.
+ *      @param text The barcode text
+ *      @param textlen The length of @c text
+ *      @param escape The format to escape the text for
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int svg_rect(int, int, int, int, char *, char[][SVG_RECT_BUFSIZE]);
+int c128_text_escaped(const uchar *, int, TextEscape, Cursor *);
 
 /**
  *      @brief Generates an SVG text element for Code 128 barcodes.
- *      @param text The content of the SVG text element
+ *      @param text The barcode text, which is written as by c128_text_escaped()
+ *      @param textlen The length of @c text
  *      @param index The x-coordinate of the centre of the text (text-anchor="middle")
- *      @param dest A double pointer to a destination array of size SVG_TEXT_BUFSIZE
- *      @return SUCCESS
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int c128_text(char *, int, char[][SVG_TEXT_BUFSIZE]);
+int c128_text(const uchar *, int, int, Cursor *);
 
 /**
  *      @brief Generates a PostScript text element for Code 128 barcodes.
- *      @param text The content of the text element
+ *      @param text The barcode text, which is written as by c128_text_escaped()
+ *      @param textlen The length of @c text
  *      @param fsize The font size of the text
- *      @param index The x-coordinate of the centre of the text (centre-justified)
- *      @param dest A double pointer to a destination array of size PS_TEXT_BUFSIZE
- *      @return SUCCESS
+ *      @param index The distance of the centre of the text (centre-justified) back from the end of
+ *             the barcode, in micro-units
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int c128_ps_text(char *, int, int, char[][PS_TEXT_BUFSIZE]);
+int c128_ps_text(const uchar *, int, int, micro, Cursor *);
 
 /**
  *      @brief Generates a black SVG rectangle for Code 128 barcodes.
  *      @param x The x-coordinate of the top-left corner of the rectangle
  *      @param w The width of the rectangle
- *      @param dest A double pointer to a destination array of size SVG_RECT_BUFSIZE
- *      @return SUCCESS
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int c128_rect_black(int, int, char[][SVG_RECT_BUFSIZE]);
+int c128_rect_black(int, int, Cursor *);
 
 /**
  *      @brief Generates a white SVG rectangle for Code 128 barcodes.
  *      @param x The x-coordinate of the top-left corner of the rectangle
  *      @param w The width of the rectangle
- *      @param dest A double pointer to a destination array of size SVG_RECT_BUFSIZE
- *      @return SUCCESS
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int c128_rect_white(int, int, char[][SVG_RECT_BUFSIZE]);
+int c128_rect_white(int, int, Cursor *);
 
 /**
  *      @brief Generates a black PostScript rectangle for Code 128 barcodes.
- *      @param dest A double pointer to a destination array of size PS_CMD_BUFSIZE
- *      @return SUCCESS
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int c128_ps_rect_black(char[][PS_CMD_BUFSIZE]);
+int c128_ps_rect_black(Cursor *);
 
 /**
  *      @brief Generates a white PostScript rectangle for Code 128 barcodes.
  *      @param w The width of the rectangle (only available on white rectangles - for quiet zone)
- *      @param dest A double pointer to a destination array of size PS_CMD_BUFSIZE
- *      @return SUCCESS
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  */
-int c128_ps_rect_white(int, char[][PS_CMD_BUFSIZE]);
+int c128_ps_rect_white(int, Cursor *);
 
 /**
  *      @brief Generates an SVG representation of a barcode pattern for Code 128 barcodes.
@@ -260,86 +408,297 @@ int c128_ps_rect_white(int, char[][PS_CMD_BUFSIZE]);
  *      @param svg_x A pointer to an integer representing the x-coordinate from which to draw the
  *             pattern. This is automatically incremented within the function to facilitate drawing
  *             adjacent patterns.
- *      @param dest A double pointer to a destination string. There should still be
- *             <tt>SVG_RECT_BUFSIZE * width</tt> bytes of memory allocated from the end of the
- *             string, as the result is <tt>strncat</tt>ed with @c dest.
+ *      @param dest The destination cursor
  *      @return SUCCESS
  */
-int c128_pat2svg(pattern, int, int *, char **);
+int c128_pat2svg(pattern, int, int *, Cursor *);
 
 /**
  *      @brief Generates a PostScript representation of a barcode pattern for Code 128 barcodes.
  *      @param pat The pattern to be represented
  *      @param width The number of bars comprising the pattern
- *      @param ps_x A pointer to an integer representing the x-coordinate from which to draw the
- *             pattern. This is automatically incremented within the function to facilitate drawing
+ *      @param ps_x A pointer to the x-coordinate, in micro-units, from which to draw the pattern.
+ *             This is automatically incremented within the function to facilitate drawing
  *             adjacent patterns.
- *      @param dest A double pointer to a destination string. There should still be
- *             <tt>PS_CMD_BUFSIZE * width</tt> bytes of memory allocated from the end of the
- *             string, as the result is <tt>strncat</tt>ed with @c dest.
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
  *      @return SUCCESS
  */
-int c128_pat2ps(pattern, int, float *, char **, const PSProperties *);
+int c128_pat2ps(pattern, int, micro *, Cursor *, const PSProperties *);
+
+/**
+ *      @brief Generates a run-length PostScript representation of a barcode pattern, drawing each
+ *             bar and skipping each space with a single command.
+ *      @param pat The pattern to be represented, including its leading and trailing bars (see
+ *             C128_FULL_PATTERN)
+ *      @param width The number of bars comprising the pattern
+ *      @param ps_x A pointer to the x-coordinate, in micro-units, from which to draw the pattern.
+ *             This is automatically incremented within the function.
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @return SUCCESS
+ *      @see c128_pat2ps
+ */
+int c128_pat2ps_rl(pattern, int, micro *, Cursor *, const PSProperties *);
+
+/**
+ *      @brief Writes an SVG representation of a complete Code 128 barcode to a cursor.
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ */
+int c128_svg_write(Code128 *, Cursor *);
+
+/**
+ *      @brief Calculates the exact size of the SVG generated by c128_svg() (excluding the null
+ *             terminator).
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param size A pointer to the destination size
+ *      @return SUCCESS
+ */
+int c128_svg_size(Code128 *, size_t *);
+
+/**
+ *      @brief Packs the modules of a complete Code 128 barcode (excluding quiet zones) into a row
+ *             of bits, most significant bit first, where a 1 is a black module.
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param dest A destination array of at least C128_MAX_MODULE_BYTES bytes
+ *      @param width A pointer to the destination number of modules
+ *      @return SUCCESS or ERR_DATA_LENGTH if the barcode is too long
+ */
+int c128_modules(Code128 *, uchar *, int *);
+
+/**
+ *      @brief Skips a quiet zone in a PostScript barcode using the command of the bar mode in use.
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ */
+int c128_ps_quiet_zone(Cursor *, const PSProperties *);
+
+/**
+ *      @brief Generates a PostScript representation of a single symbol of a Code 128 barcode,
+ *             including the leading black and trailing white bars of data symbols.
+ *      @param pat The pattern of the symbol, as stored in Code128::data
+ *      @param stop Whether the pattern is the stop pattern
+ *      @param ps_x A pointer to the x-coordinate, in micro-units, from which to draw the symbol.
+ *             This is automatically incremented within the function.
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page. PS_MODE_IMAGE is
+ *             drawn as PS_MODE_MODULE, as images are not drawn a symbol at a time.
+ *      @return SUCCESS
+ */
+int c128_ps_symbol(pattern, bool, micro *, Cursor *, const PSProperties *);
+
+/**
+ *      @brief Generates a PostScript 1-bit image of a complete Code 128 barcode (excluding quiet
+ *             zones) for PS_MODE_IMAGE.
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param ps_x A pointer to the x-coordinate, in micro-units, from which to draw the barcode.
+ *             This is automatically incremented within the function.
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @return SUCCESS, ERR_DATA_LENGTH or ERR_BUFFER_SIZE
+ */
+int c128_ps_image(Code128 *, micro *, Cursor *, const PSProperties *);
 
 /**
  *      @brief Generates an SVG representation of a complete Code 128 barcode.
  *      @param code A pointer to a Code128 struct that contains the barcode to be used
- *      @param dest A double pointer to a destination string. Use svg_bufsize() to calculate the
- *             the size of @c dest
+ *      @param dest A double pointer to a destination string, whose memory is allocated internally
+ *             to the exact size of the SVG
  *      @return SUCCESS
- *      @see svg_bufsize
+ *      @see c128_svg_size
  */
 int c128_svg(Code128 *, char **);
 
 /**
- *      @brief Initialises a string to be encoded with a PostScript barcode(s)
- *      @param dest A double pointer to a destination string – memory is allocated inside the
- *             function
- *      @param barcodes The number of barcodes that will be encoded
+ *      @brief Streams an SVG representation of a complete Code 128 barcode to a sink.
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param sink The sink to write to, through a buffer of CURSOR_SINK_BUFSIZE bytes
+ *      @return SUCCESS or ERR_IO
+ *      @see c128_svg
+ */
+int c128_svg_stream(Code128 *, const Sink *);
+
+/**
+ *      @brief Initialises a cursor to be written with a PostScript barcode(s)
+ *      @param dest The destination cursor – memory is allocated inside the function
+ *      @param size The exact number of bytes that will be written, see c128_ps_layout_size()
  *      @return SUCCESS
  */
-int c128_ps_init(char **, int);
+int c128_ps_init(Cursor *, size_t);
 
 /**
- *      @brief Adds the PostScript header to a string initialised by c128_ps_init()
- *      @param dest The destination string initialised by c128_ps_init()
+ *      @brief Writes the PostScript header to a cursor
+ *      @param dest The destination cursor, e.g. initialised by c128_ps_init()
  *      @param props A PSProperties struct containing the PostScript layout properties
  *      @return SUCCESS
  *      @see c128_ps_init()
  */
-int c128_ps_header(char **, const PSProperties *);
+int c128_ps_header(Cursor *, const PSProperties *);
 
 /**
- *      @brief Adds a PostScript footer to a string representing a PostScript file, after use in
- *             c128_ps()
- *      @param dest The destination string
- *      @return SUCCESS
+ *      @brief Writes a PostScript footer to a cursor, after use in c128_ps()
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
  *      @see c128_ps
  */
-int c128_ps_footer(char **);
+int c128_ps_footer(Cursor *);
 
 /**
  *      @brief Generates a PostScript representation of a complete Code 128 barcode, following
- *             c128_ps_init() and c128_ps_header()
- *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
- *      @param num_codes The number of barcodes contained in @c codes
- *      @param dest A double pointer to a destination string – its memory is allocated in
- *             c128_ps_init
+ *             c128_ps_header()
+ *      @param code A pointer to a Code128 struct containing the barcode to be printed
+ *      @param dest The destination cursor
  *      @param props A PSProperties struct containing the properties of the page in the PostScript
  *             file
  *      @return SUCCESS
- *      @see c128_ps_init
  *      @see c128_ps_header
  *      @see c128_ps_footer
- *      @see ps_bufsize
  */
-int c128_ps(Code128 *, char **, const PSProperties *);
+int c128_ps(Code128 *, Cursor *, const PSProperties *);
+
+/**
+ *      @brief Moves from one cell of a page layout to the next, ready for c128_ps()
+ *      @param cell The index of the cell being moved to. Nothing is written for the first cell.
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ */
+int c128_ps_cell_position(int, Cursor *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Writes a PostScript file containing multiple barcodes to a cursor
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page in the PostScript
+ *             file
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns in
+ *             which the barcodes should be arranged
+ *      @return SUCCESS, ERR_BUFFER_SIZE, or ERR_INVALID_LAYOUT when num_codes exceeds
+ *              <tt>(*layout)->cols * (*layout)->rows</tt>
+ *      @see c128_ps_layout
+ */
+int c128_ps_layout_write(Code128 **, int, Cursor *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Calculates the exact size of the PostScript file generated by c128_ps_layout()
+ *             (excluding the null terminator).
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct
+ *      @param size A pointer to the destination size
+ *      @return SUCCESS or ERR_INVALID_LAYOUT
+ */
+int c128_ps_layout_size(Code128 **, int, const PSProperties *, Layout *, size_t *);
+
+/**
+ *      @brief Writes the DSC comments and prolog of a paged PostScript document to a cursor
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the PostScript layout properties
+ *      @param pages The number of pages that will follow, see c128_ps_num_pages()
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ *      @see c128_ps_paginate
+ */
+int c128_ps_dsc_header(Cursor *, const PSProperties *, int);
+
+/**
+ *      @brief Writes a single page of a paged PostScript document to a cursor, following
+ *             c128_ps_dsc_header()
+ *      @detail Pages are independent of each other, so a large document can be streamed out one
+ *              page at a time by writing each page to a cursor and flushing it before the next.
+ *      @param codes A double pointer to the Code128 structs to be printed on this page
+ *      @param num_codes The number of barcodes on this page, at most
+ *             <tt>layout->cols * layout->rows</tt>
+ *      @param page The ordinal of the page, starting from 1
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct
+ *      @return SUCCESS, ERR_BUFFER_SIZE or ERR_INVALID_LAYOUT
+ */
+int c128_ps_page(Code128 **, int, int, Cursor *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Writes the DSC trailer of a paged PostScript document to a cursor, after its last
+ *             page
+ *      @param dest The destination cursor
+ *      @return SUCCESS or ERR_BUFFER_SIZE
+ */
+int c128_ps_dsc_trailer(Cursor *);
+
+/**
+ *      @brief Returns the number of pages needed to lay out @c num_codes barcodes
+ *      @param num_codes The number of barcodes
+ *      @param layout A pointer to a Layout struct
+ *      @return The number of pages, or 0 for an empty layout
+ */
+int c128_ps_num_pages(int, Layout *);
+
+/**
+ *      @brief Writes a paged PostScript document containing any number of barcodes to a cursor
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @return SUCCESS, ERR_BUFFER_SIZE or ERR_INVALID_LAYOUT when the layout is empty
+ *      @see c128_ps_paginate
+ */
+int c128_ps_paginate_write(Code128 **, int, Cursor *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Calculates the exact size of the document generated by c128_ps_paginate()
+ *             (excluding the null terminator).
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct
+ *      @param size A pointer to the destination size
+ *      @return SUCCESS or ERR_INVALID_LAYOUT
+ */
+int c128_ps_paginate_size(Code128 **, int, const PSProperties *, Layout *, size_t *);
+
+/**
+ *      @brief Generates a PostScript document laying out any number of barcodes across as many
+ *             pages as needed, with Document Structuring Conventions comments (@c %%Pages,
+ *             @c %%Page, @c %%EndProlog) so that spoolers can select, reprint and stream pages.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest A double pointer to a destination string, whose memory is allocated internally
+ *             to the exact size of the document
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @return SUCCESS or ERR_INVALID_LAYOUT when the layout is empty
+ *      @see c128_ps_layout
+ */
+int c128_ps_paginate(Code128 **, int, char **, const PSProperties *, Layout *);
+
+/**
+ *      @brief Streams a paged PostScript document to a sink as it is generated, so that memory use
+ *             does not grow with the number of barcodes.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param sink The sink to write to, through a buffer of CURSOR_SINK_BUFSIZE bytes
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @return SUCCESS, ERR_INVALID_LAYOUT or ERR_IO
+ *      @see c128_ps_paginate
+ */
+int c128_ps_paginate_stream(Code128 **, int, const Sink *, const PSProperties *, Layout *);
 
 /**
  *      @brief Generates a PostScript file containing multiple barcodes
  *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
  *      @param num_codes The number of barcodes contained in @c codes
  *      @param dest A double pointer to a destination string, whose memory is allocated internally
+ *             to the exact size of the document
  *      @param props A PSProperties struct containing the properties of the page in the PostScript
  *             file
  *      @param layout A pointer to a Layout struct containing the number of rows and columns in
@@ -350,4 +709,74 @@ int c128_ps(Code128 *, char **, const PSProperties *);
  */
 int c128_ps_layout(Code128 **, int, char **, const PSProperties *, Layout *);
 
+/**
+ *      @brief Streams a PostScript file containing multiple barcodes to a sink.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param sink The sink to write to, through a buffer of CURSOR_SINK_BUFSIZE bytes
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @return SUCCESS, ERR_INVALID_LAYOUT or ERR_IO
+ *      @see c128_ps_layout
+ */
+int c128_ps_layout_stream(Code128 **, int, const Sink *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Writes a PDF document laying out any number of barcodes across as many pages as
+ *             needed to a cursor.
+ *      @detail Each distinct barcode is drawn once as a Form XObject and placed with @c Do wherever
+ *              it appears, so repeated barcodes cost only a few bytes each. Pages are the size of
+ *              the layout and its margins, and the layout matches c128_ps_paginate() except that
+ *              columns are always @c column_width and @c padding apart.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest The destination cursor
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @return SUCCESS, ERR_BUFFER_SIZE or ERR_INVALID_LAYOUT when the layout is empty
+ *      @see c128_pdf
+ */
+int c128_pdf_write(Code128 **, int, Cursor *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Calculates the exact size of the document generated by c128_pdf() (excluding the
+ *             null terminator).
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct
+ *      @param size A pointer to the destination size
+ *      @return SUCCESS or ERR_INVALID_LAYOUT
+ */
+int c128_pdf_size(Code128 **, int, const PSProperties *, Layout *, size_t *);
+
+/**
+ *      @brief Generates a PDF document laying out any number of barcodes across as many pages as
+ *             needed, see c128_pdf_write().
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest A double pointer to a destination string, whose memory is allocated internally
+ *             to the exact size of the document. The document contains no null bytes.
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @return SUCCESS or ERR_INVALID_LAYOUT when the layout is empty
+ *      @see c128_pdf_size
+ */
+int c128_pdf(Code128 **, int, char **, const PSProperties *, Layout *);
+
+/**
+ *      @brief Streams a PDF document to a sink as it is generated, a page at a time.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param sink The sink to write to, through a buffer of CURSOR_SINK_BUFSIZE bytes
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @return SUCCESS, ERR_INVALID_LAYOUT or ERR_IO
+ *      @see c128_pdf
+ */
+int c128_pdf_stream(Code128 **, int, const Sink *, const PSProperties *, Layout *);
+
 #endif
@@ -0,0 +1,43 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file mapped.h
+ *      @brief Declarations for rendering documents straight into memory-mapped files.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include "graphic.h"
+#include "symb.h"
+
+/**
+ *      @brief Writes a paged PostScript document to a file by rendering it directly into a memory
+ *             mapping of the file, on multiple threads
+ *      @detail The size of every page is measured first, so the file can be truncated to exactly
+ *              the size of the document and mapped. The pages are then divided into one contiguous
+ *              region per thread, and each thread renders its pages straight into the mapping at
+ *              their measured offsets, so no output is copied through a user-space buffer or
+ *              @c write. The output is identical to that of c128_ps_paginate().
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param path The path of the file to create or replace
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @param threads The number of threads, including the calling thread
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_INVALID_LAYOUT or ERR_IO
+ *      @see c128_ps_paginate
+ */
+int c128_ps_paginate_mapped(Code128 **, int, const char *, const PSProperties *, Layout *, int);
+
+#endif /* MAPPED_H */
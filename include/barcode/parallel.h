@@ -0,0 +1,66 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file parallel.h
+ *      @brief Declarations for rendering large documents on multiple threads.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "graphic.h"
+#include "symb.h"
+
+#include <stdio.h>
+
+/**
+ *      @brief Default number of pages that may be rendered ahead of the output, per thread
+ */
+#define PS_MT_WINDOW_PER_THREAD 2
+
+/**
+ *      @brief Writes a paged PostScript document to a file, rendering its pages on multiple threads
+ *      @detail Pages are rendered concurrently into per-page buffers by a pool of worker threads
+ *              and written out in order behind a single prolog, as each becomes ready. At most
+ *              @c window pages are rendered or waiting to be written at any time, so memory use is
+ *              bounded regardless of the number of barcodes. The output is identical to that of
+ *              c128_ps_paginate().
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param out The file to write the document to
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns on each
+ *             page
+ *      @param threads The number of worker threads
+ *      @param window The maximum number of pages in flight, or 0 for
+ *             <tt>PS_MT_WINDOW_PER_THREAD * threads</tt>
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_INVALID_LAYOUT or ERR_IO
+ *      @see c128_ps_paginate
+ */
+int c128_ps_paginate_mt(Code128 **, int, FILE *, const PSProperties *, Layout *, int, int);
+
+/**
+ *      @brief Writes a paged PostScript document to a sink, rendering its pages on multiple threads
+ *      @detail As c128_ps_paginate_mt(), but each page is passed to the sink whole, from the
+ *              calling thread, as soon as it is its turn to be written.
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_INVALID_LAYOUT or ERR_IO
+ *      @see c128_ps_paginate_mt
+ */
+int c128_ps_paginate_mt_stream(Code128 **,
+                               int,
+                               const Sink *,
+                               const PSProperties *,
+                               Layout *,
+                               int,
+                               int);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,115 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file pipeline.h
+ *      @brief Declarations for encoding, rendering and writing barcodes concurrently.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "cursor.h"
+#include "graphic.h"
+#include "symb.h"
+
+#include <stddef.h>
+
+/**
+ *      @brief Default number of barcodes that may be queued for or by each render worker
+ */
+#define PIPELINE_DEFAULT_DEPTH 64
+
+/**
+ *      @brief Reads the next record of a source.
+ *      @detail On success, sets @c data to the record, which only has to stay valid until the
+ *              next call, and @c len to its length, or sets @c data to NULL at the end of the
+ *              input. Any other status stops the pipeline and is returned by it.
+ */
+typedef int (*SourceNext)(void *, const uchar **, int *);
+
+/**
+ *      @brief Where a pipeline reads its records from.
+ */
+typedef struct RecordSource Source;
+
+/**
+ *      @brief Called with the index and status of each record that could not be encoded.
+ */
+typedef void (*PipelineReject)(void *, long, int);
+
+/**
+ *      @brief The kinds of document a pipeline writes.
+ */
+typedef enum PipelineFormat PipelineFormat;
+
+/**
+ *      @brief The settings of a pipeline.
+ */
+typedef struct PipelineOptions PipelineOptions;
+
+/**
+ *      @brief The work done by a pipeline.
+ */
+typedef struct PipelineStats PipelineStats;
+
+struct RecordSource {
+    SourceNext next; /**< Called from the encoding thread for each record */
+    void *     ctx;  /**< Passed to @c next */
+};
+
+enum PipelineFormat {
+    PIPELINE_SVG, /**< Each barcode as an SVG, as by c128_svg_write(), followed by a newline */
+    PIPELINE_PS   /**< Each barcode as a PostScript document, as by barcode_ctx_ps() */
+};
+
+struct PipelineOptions {
+    PipelineFormat       format;
+    const PSProperties * props;      /**< The properties of PostScript documents, or NULL */
+    int                  workers;    /**< Number of render workers */
+    int                  depth;      /**< Slots per worker, or 0 for PIPELINE_DEFAULT_DEPTH */
+    PipelineReject       reject;     /**< Called in order for failed records, or NULL */
+    void *               reject_ctx; /**< Passed to @c reject */
+};
+
+struct PipelineStats {
+    long               records; /**< Number of records read from the source */
+    long               written; /**< Number of barcodes written */
+    long               failed;  /**< Number of records that could not be encoded */
+    unsigned long long bytes;   /**< Total bytes written */
+};
+
+/**
+ *      @brief Encodes records from a source, renders them and writes them to a sink, each stage
+ *             running at the same time as the others.
+ *      @detail A dedicated thread reads and encodes records and deals them in turn to @c workers
+ *              render workers, and the calling thread collects the documents from the workers in
+ *              the same turn and writes them, so the output is in input order. Each worker has
+ *              @c depth slots, each holding one barcode and its rendered document, which pass from
+ *              the encoder to the worker and the worker to the writer through lock-free
+ *              single-producer, single-consumer queues. A stage that gets @c depth slots ahead of
+ *              the next waits for it, so memory is bounded by <tt>workers * depth</tt> documents
+ *              however long the input is.
+ *
+ *              Records that cannot be encoded are skipped and passed to @c reject. If the source
+ *              fails, the records read before it are still written and its status returned; if
+ *              the sink fails, the barcodes already queued are discarded. If a thread cannot be
+ *              started, nothing more is read, the barcodes already queued are discarded and
+ *              ERR_GENERIC is returned.
+ *      @param source The source to read records from
+ *      @param out The sink to write documents to
+ *      @param opts The settings of the pipeline
+ *      @param stats The destination of the work done, or NULL
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_GENERIC, ERR_IO or the status returned by the source
+ */
+int c128_pipeline(const Source *, const Sink *, const PipelineOptions *, PipelineStats *);
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,164 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file printer.h
+ *      @brief Declarations for driving label and receipt printers with their native commands.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @see compose.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef PRINTER_H
+#define PRINTER_H
+
+#include "cursor.h"
+#include "graphic.h"
+#include "sink.h"
+#include "symb.h"
+
+/**
+ *      @defgroup ZplProperties Properties of ZPL labels
+ */
+/*@{*/
+/*      @brief Resolution of most Zebra label printers */
+#define ZPL_DEFAULT_DPI 203
+/*      @brief Largest module width accepted by @c ^BY, in dots */
+#define ZPL_MAX_MODULE 10
+#define ZPL_LABEL_BEGIN "^XA\n"
+#define ZPL_LABEL_SIZE "^PW%d^LL%d\n"
+/*      @brief A Code 128 field in mode N, whose data is given its start code explicitly and may
+ *             contain @c ^FH hexadecimal escapes */
+#define ZPL_FIELD "^FO%d,%d^BY%d^BCN,%d,%c,N,N,N^FH^FD"
+#define ZPL_FIELD_END "^FS\n"
+#define ZPL_LABEL_END "^XZ\n"
+/*      @brief Introduces a @c ^FH escape of a byte as two hexadecimal digits */
+#define ZPL_HEX_INDICATOR '_'
+/*      @brief Introduces a @c ^BC invocation code, such as a start code or a code set change */
+#define ZPL_INVOKE '>'
+/*      @brief The invocation of a literal ZPL_INVOKE */
+#define ZPL_INVOKE_LITERAL "><"
+/*      @brief Invocation codes of the start codes A, B and C */
+#define ZPL_START_A ">9"
+#define ZPL_START_B ">:"
+#define ZPL_START_C ">;"
+/*      @brief The Code 128 value of invocation code @c >1, from which the values of @c >1 to @c >8
+ *             run consecutively */
+#define ZPL_INVOKE_FIRST_VALUE 95
+/*@}*/
+
+/**
+ *      @defgroup EscPosProperties Properties of ESC/POS receipts
+ */
+/*@{*/
+#define ESCPOS_DEFAULT_DPI 203
+#define ESCPOS_ESC 0x1B
+#define ESCPOS_GS 0x1D
+/*      @brief @c ESC @, which resets the printer */
+#define ESCPOS_INIT "\x1b@"
+/*      @brief Range of module widths accepted by @c GS w, in dots */
+#define ESCPOS_MIN_MODULE 2
+#define ESCPOS_MAX_MODULE 6
+/*      @brief Largest bar height accepted by @c GS h, and feed accepted by @c ESC J, in dots */
+#define ESCPOS_MAX_DOTS 255
+/*      @brief @c GS H position printing the text below the bars */
+#define ESCPOS_HRI_BELOW 2
+/*      @brief @c GS k barcode system of Code 128, whose data is preceded by its length */
+#define ESCPOS_CODE128 73
+/*      @brief Largest length of @c GS k data */
+#define ESCPOS_MAX_DATA 255
+/*      @brief Introduces a code set or function character in @c GS k data, such as @c {B */
+#define ESCPOS_CODE_PREFIX '{'
+/*      @brief @c GS v 0 in normal density, followed by the width in bytes and height in dots */
+#define ESCPOS_RASTER "\x1dv0\x00"
+#define ESCPOS_RASTER_SIZE 4
+/*      @brief Largest height of a single @c GS v 0 image */
+#define ESCPOS_MAX_RASTER_ROWS 2303
+/*@}*/
+
+/**
+ *      @brief Writes barcodes laid out on labels as ZPL, one label per page of the layout
+ *      @detail Each barcode is one @c ^BC field in mode N. Its data is recovered from its patterns,
+ *              so the printer is given the same start code and code set changes as chosen by
+ *              c128_encode(), and computes the same checksum. Barcodes are placed as by c128_pdf()
+ *              with the module width rounded to whole dots, and the printer draws the text.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest The cursor to write to
+ *      @param props A PSProperties struct containing the properties of the label
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @param dpi The resolution of the printer, such as ZPL_DEFAULT_DPI
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_INVALID_CODE_SET or ERR_NULL_PATTERN if a barcode is
+ *              malformed, ERR_INVALID_LAYOUT, ERR_BUFFER_SIZE or ERR_IO
+ */
+int c128_zpl_write(Code128 **, int, Cursor *, const PSProperties *, Layout *, int);
+
+/**
+ *      @brief Calculates the exact length of the ZPL written by c128_zpl_write()
+ *      @param size The number of bytes that will be written
+ *      @return As c128_zpl_write()
+ */
+int c128_zpl_size(Code128 **, int, const PSProperties *, Layout *, int, size_t *);
+
+/**
+ *      @brief Writes barcodes laid out on labels as ZPL to a newly allocated string
+ *      @param dest A pointer to the string, which must be freed
+ *      @return As c128_zpl_write()
+ *      @see c128_zpl_write
+ */
+int c128_zpl(Code128 **, int, char **, const PSProperties *, Layout *, int);
+
+/**
+ *      @brief Writes barcodes laid out on labels as ZPL to a sink, such as a printer's device
+ *      @return As c128_zpl_write()
+ *      @see c128_zpl_write
+ */
+int c128_zpl_stream(Code128 **, int, const Sink *, const PSProperties *, Layout *, int);
+
+/**
+ *      @brief Writes barcodes as ESC/POS commands printing each with the printer's own Code 128
+ *      @detail Each barcode is one @c GS k command, recovered from its patterns as in
+ *              c128_zpl_write() with @c {A, @c {B and @c {C for its start and code set changes and
+ *              @c {S for shifts. Barcodes are printed one below the other, indented by the left
+ *              margin and separated by the padding, with the text below. For barcodes side by
+ *              side, see c128_escpos_raster().
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param dest The cursor to write to
+ *      @param props A PSProperties struct containing the bar and margin sizes
+ *      @param dpi The resolution of the printer, such as ESCPOS_DEFAULT_DPI
+ *      @return SUCCESS, ERR_ARGUMENT, ERR_INVALID_CODE_SET or ERR_NULL_PATTERN if a barcode is
+ *              malformed, ERR_BUFFER_SIZE or ERR_IO
+ */
+int c128_escpos_write(Code128 **, int, Cursor *, const PSProperties *, int);
+
+/**
+ *      @brief Writes barcodes as ESC/POS @c GS k commands to a sink
+ *      @return As c128_escpos_write()
+ *      @see c128_escpos_write
+ */
+int c128_escpos_stream(Code128 **, int, const Sink *, const PSProperties *, int);
+
+/**
+ *      @brief Writes pages of barcodes as ESC/POS raster images, for printers without Code 128 or
+ *             layouts it cannot print
+ *      @detail Each page is rendered by c128_raster_layout() and sent as a @c GS v 0 image per
+ *              band, so a page is never held in memory whole.
+ *      @param codes A double pointer to a Code128 struct containing the barcodes to be printed
+ *      @param num_codes The number of barcodes contained in @c codes
+ *      @param sink The sink to write to
+ *      @param props A PSProperties struct containing the properties of a page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @param dpi The resolution of the printer
+ *      @param threads The number of threads rendering each page
+ *      @return As c128_raster_layout()
+ */
+int c128_escpos_raster(Code128 **, int, const Sink *, const PSProperties *, Layout *, int, int);
+
+#endif /* PRINTER_H */
@@ -0,0 +1,190 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file raster.h
+ *      @brief Declarations for rendering barcodes to 1-bit bitmaps and writing them as PBM or PNG.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "cursor.h"
+#include "deflate.h"
+#include "graphic.h"
+#include "sink.h"
+#include "symb.h"
+
+#include <stdint.h>
+
+/**
+ *      @defgroup RasterProperties Properties of bitmap outputs
+ */
+/*@{*/
+#define RASTER_DEFAULT_DPI 300
+/*      @brief Points per inch, the unit lengths are converted through */
+#define RASTER_POINTS_PER_INCH 72
+#define PBM_HEADER "P4\n%d %d\n"
+#define PBM_HEADER_BUFSIZE 32
+#define PNG_SIGNATURE "\x89PNG\r\n\x1a\n"
+#define PNG_SIGNATURE_SIZE 8
+#define PNG_IHDR_SIZE 13
+/*      @brief 1-bit greyscale, in which a 0 is black */
+#define PNG_BIT_DEPTH 1
+#define PNG_COLOUR_GREY 0
+/*      @brief Each row of a PNG is preceded by its filter type, of which only None is used */
+#define PNG_FILTER_NONE 0
+/*@}*/
+
+/**
+ *      @brief A 1-bit image, as rows of pixels packed most significant bit first, where a 1 is a
+ *             black pixel. Rows are padded to a whole byte, as in PBM.
+ */
+typedef struct RasterBitmap Bitmap;
+
+/**
+ *      @brief A PNG being written to a sink a number of rows at a time.
+ */
+typedef struct PngStream PngWriter;
+
+struct RasterBitmap {
+    uchar * bits;   /**< The rows of the image, @c stride bytes apart */
+    int     width;  /**< Width in pixels */
+    int     height; /**< Height in pixels */
+    int     stride; /**< Number of bytes in a row */
+};
+
+/**
+ *      @detail Rows are compressed by a zlib stream into @c idat, which is written out as an IDAT
+ *              chunk after every call to png_rows() that produced any compressed data. The zlib
+ *              stream refers to @c idat_sink, so a PngWriter must not be moved while in use.
+ */
+struct PngStream {
+    const Sink * out;       /**< The sink the PNG is written to */
+    int          width;     /**< Width in pixels */
+    int          stride;    /**< Number of bytes in a row, excluding its filter type */
+    int          status;    /**< The first error, after which nothing more is written */
+    GzipSink *   zlib;      /**< Compresses the filtered rows */
+    Sink         deflate;   /**< Writes to @c zlib */
+    Sink         idat_sink; /**< Collects the output of @c zlib in @c idat */
+    MemorySink   idat;      /**< Compressed data not yet written in an IDAT chunk */
+    uchar *      row;       /**< A filter type followed by a row of inverted pixels */
+    uint32_t     crc_table[256];
+};
+
+/**
+ *      @brief Converts a length to a whole number of pixels at a resolution.
+ *      @param length The length, in the units of @c props
+ *      @param props A PSProperties struct whose units are used
+ *      @param dpi The resolution in dots per inch
+ *      @return The length in pixels, rounded to the nearest pixel
+ */
+int raster_pixels(float, const PSProperties *, int);
+
+/**
+ *      @brief Returns the width of a module in pixels at a resolution, which is the bar width of
+ *             @c props rounded to a whole number of pixels so that every bar edge falls on a pixel
+ *             boundary, and at least 1.
+ *      @param props A PSProperties struct containing the bar width
+ *      @param dpi The resolution in dots per inch
+ *      @return The width of a module in pixels
+ */
+int raster_module_pixels(const PSProperties *, int);
+
+/**
+ *      @brief Sets the pixels of a row in a half-open range to black.
+ *      @detail Whole bytes within the range are filled with a single memset().
+ *      @param row The row
+ *      @param from The first pixel to set
+ *      @param to The pixel after the last pixel to set
+ */
+void bitmap_span(uchar *, int, int);
+
+/**
+ *      @brief Draws the bars of a Code 128 barcode into a row of pixels.
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param module_px The width of a module in pixels, see raster_module_pixels()
+ *      @param x The pixel at which the leading quiet zone starts
+ *      @param row The row, which must be wide enough for the barcode. Only black pixels are set.
+ *      @param width A pointer to the destination width of the barcode in pixels, including both
+ *             quiet zones
+ *      @return SUCCESS or ERR_DATA_LENGTH if the barcode is too long
+ */
+int c128_raster_row(Code128 *, int, int, uchar *, int *);
+
+/**
+ *      @brief Renders a Code 128 barcode, including its quiet zones, to a 1-bit bitmap.
+ *      @detail The bars are drawn into the first row, which is then copied to every other row.
+ *              The text of the barcode is not drawn.
+ *      @param code A pointer to a Code128 struct that contains the barcode to be used
+ *      @param props A PSProperties struct containing the bar width and height
+ *      @param dpi The resolution in dots per inch
+ *      @param dest The destination bitmap, whose memory is allocated internally and freed by
+ *             bitmap_free()
+ *      @return SUCCESS or ERR_DATA_LENGTH
+ */
+int c128_raster(Code128 *, const PSProperties *, int, Bitmap *);
+
+/**
+ *      @brief Frees the pixels of a bitmap.
+ *      @param bitmap The bitmap
+ */
+void bitmap_free(Bitmap *);
+
+/**
+ *      @brief Writes a bitmap to a sink as a binary PBM (P4) image.
+ *      @param bitmap The bitmap
+ *      @param sink The sink to write to
+ *      @return SUCCESS or ERR_IO
+ */
+int bitmap_pbm(const Bitmap *, const Sink *);
+
+/**
+ *      @brief Writes a bitmap to a sink as a 1-bit greyscale PNG image.
+ *      @param bitmap The bitmap
+ *      @param sink The sink to write to
+ *      @param level The compression level of the image data, where DEFLATE_LEVEL_STORE writes
+ *             stored blocks
+ *      @return SUCCESS or ERR_IO
+ */
+int bitmap_png(const Bitmap *, const Sink *, int);
+
+/**
+ *      @brief Writes the signature and header of a 1-bit greyscale PNG image to a sink, ready for
+ *             its rows to be written with png_rows().
+ *      @param png The writer to initialise
+ *      @param sink The sink to write to
+ *      @param width The width of the image in pixels
+ *      @param height The height of the image in pixels
+ *      @param level The compression level of the image data, see sink_zlib()
+ *      @return SUCCESS or ERR_IO
+ */
+int png_begin(PngWriter *, const Sink *, int, int, int);
+
+/**
+ *      @brief Writes rows of a bitmap to a PNG image.
+ *      @param png The writer
+ *      @param rows The first row, packed as in a Bitmap
+ *      @param stride The number of bytes between rows
+ *      @param count The number of rows
+ *      @return SUCCESS or ERR_IO
+ */
+int png_rows(PngWriter *, const uchar *, int, int);
+
+/**
+ *      @brief Finishes a PNG image after all of its rows have been written, and frees the memory
+ *             of the writer.
+ *      @param png The writer
+ *      @return SUCCESS or ERR_IO if writing failed at any point
+ */
+int png_end(PngWriter *);
+
+#endif /* RASTER_H */
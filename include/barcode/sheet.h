@@ -0,0 +1,84 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file sheet.h
+ *      @brief Declarations for editable single-page sheets of barcodes.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef SHEET_H
+#define SHEET_H
+
+#include "cache.h"
+#include "cursor.h"
+#include "graphic.h"
+#include "symb.h"
+
+#include <stddef.h>
+
+/**
+ *      @brief A rendered PostScript page of barcodes whose cells can be changed individually
+ */
+typedef struct PSSheet Sheet;
+
+/**
+ *      @detail The document is kept rendered in @c doc, with each cell's fragment (its position
+ *              commands and barcode) between <tt>offsets[cell]</tt> and <tt>offsets[cell + 1]</tt>.
+ *              Changing a cell re-renders that fragment alone and moves the rest of the document to
+ *              fit it. Empty cells keep their position commands, so a full sheet renders exactly as
+ *              c128_ps_layout() would.
+ */
+struct PSSheet {
+    Layout      layout;
+    int         cells;   /**< Number of cells, <tt>layout.rows * layout.cols</tt> */
+    Code128 **  codes;   /**< The barcode in each cell, or NULL if the cell is empty */
+    size_t *    offsets; /**< Start of each cell in @c doc, followed by the start of the footer */
+    Cursor      doc;     /**< The rendered document */
+    Cursor      scratch; /**< Buffer that changed cells are rendered into */
+    RenderCache cache;   /**< Symbol fragments, which also hold the properties of the page */
+};
+
+/**
+ *      @brief Initialises a sheet of empty cells
+ *      @param sheet The sheet to initialise
+ *      @param props A PSProperties struct containing the properties of the page
+ *      @param layout A pointer to a Layout struct containing the number of rows and columns
+ *      @return SUCCESS or ERR_INVALID_LAYOUT
+ */
+int c128_sheet_init(Sheet *, const PSProperties *, Layout *);
+
+/**
+ *      @brief Frees the memory held by a sheet, including its barcodes
+ *      @param sheet The sheet to free
+ */
+void c128_sheet_free(Sheet *);
+
+/**
+ *      @brief Encodes data into one cell of a sheet, re-rendering only that cell
+ *      @param sheet The sheet to change
+ *      @param cell The index of the cell, counting across each row in turn
+ *      @param data The data to encode, or NULL to empty the cell
+ *      @param data_len The length of @c data, or 0 to empty the cell
+ *      @return SUCCESS, ERR_ARGUMENT or any error returned by c128_encode(), in which case the
+ *              cell is left unchanged
+ */
+int c128_sheet_set(Sheet *, int, uchar *, int);
+
+/**
+ *      @brief Returns the rendered document of a sheet
+ *      @detail The string belongs to the sheet and is valid until the sheet is next changed.
+ *      @param sheet The sheet
+ *      @param len Set to the length of the document, if not NULL
+ *      @return The null-terminated PostScript document
+ */
+const char * c128_sheet_str(Sheet *, size_t *);
+
+#endif /* SHEET_H */
@@ -0,0 +1,63 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file sink.h
+ *      @brief Declarations for the built-in output sinks.
+ *      @detail A sink receives the output of a cursor initialised by cursor_init_sink() as its
+ *              buffer fills up. See the streaming renderers, e.g. c128_svg_stream().
+ *      @see cursor.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include "cursor.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ *      @brief Initial capacity of the buffer of a memory sink
+ */
+#define SINK_MEMORY_BUFSIZE 4096
+
+/**
+ *      @brief A growable heap buffer that output is collected in by a memory sink.
+ */
+typedef struct MemorySinkBuffer MemorySink;
+
+struct MemorySinkBuffer {
+    char * buf; /**< The output so far, or NULL if nothing has been written */
+    size_t len; /**< Number of bytes of output */
+    size_t cap; /**< Capacity of @c buf in bytes */
+};
+
+/**
+ *      @brief Initialises a sink that writes to a stdio stream.
+ *      @param sink The sink to initialise
+ *      @param file The stream to write to, which is not flushed or closed
+ */
+void sink_file(Sink *, FILE *);
+
+/**
+ *      @brief Initialises a sink that writes to a file descriptor, such as a pipe or socket.
+ *      @detail Short writes are continued and writes interrupted by a signal are retried.
+ *      @param sink The sink to initialise
+ *      @param fd The file descriptor to write to, which is not closed
+ */
+void sink_fd(Sink *, int);
+
+/**
+ *      @brief Initialises a sink that collects output in memory, and empties the buffer.
+ *      @param sink The sink to initialise
+ *      @param mem The buffer to collect output in. Its @c buf must be freed by the caller.
+ */
+void sink_memory(Sink *, MemorySink *);
+
+#endif /* SINK_H */
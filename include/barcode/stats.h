@@ -0,0 +1,147 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file stats.h
+ *      @brief Declarations for counting the calls, time and output of each stage of the library.
+ *      @detail Instrumentation is compiled in only when @c BARCODE_STATS is defined, such as by
+ *              <tt>make STATS=1</tt>. Otherwise the instrumented functions contain no trace of it
+ *              and every snapshot is zero.
+ *
+ *              Each thread counts into its own counters, so recording takes no locks. A thread's
+ *              counters are added to the process-wide totals by barcode_stats_publish(), which the
+ *              library's own worker threads call before exiting; long-lived threads of the
+ *              application should call it periodically, such as after each job.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ *      @brief A stage of producing a barcode.
+ */
+typedef enum BarcodeStage Stage;
+
+/**
+ *      @brief The counters of one stage.
+ */
+typedef struct StageCounters StageStats;
+
+/**
+ *      @brief The counters of every stage at one moment.
+ */
+typedef struct StageSnapshot StatsSnapshot;
+
+/**
+ *      @brief The start of an instrumented call, see STAGE_START().
+ */
+typedef struct StageTimer StageTimer;
+
+enum BarcodeStage {
+    STAGE_ENCODE,    /**< c128_encode() and c128_encode_into(), emitting patterns */
+    STAGE_STRREPR,   /**< c128_strrepr() */
+    STAGE_SVG,       /**< c128_svg(), c128_svg_write() and c128_svg_stream() */
+    STAGE_PS,        /**< c128_ps(), for each barcode rendered outside a layout */
+    STAGE_PS_LAYOUT, /**< c128_ps_layout(), c128_ps_layout_write() and c128_ps_layout_stream() */
+    STAGE_COUNT
+};
+
+struct StageCounters {
+    unsigned long long calls;  /**< Number of calls */
+    unsigned long long ns;     /**< Total time spent in the calls, in nanoseconds */
+    unsigned long long bytes;  /**< Total bytes of output */
+    unsigned long long errors; /**< Number of calls that failed */
+};
+
+struct StageSnapshot {
+    StageStats stages[STAGE_COUNT]; /**< The counters of each stage, indexed by Stage */
+};
+
+struct StageTimer {
+    long long start; /**< The time the call started, in nanoseconds */
+    size_t    bytes; /**< The output already written when the call started */
+};
+
+#ifdef BARCODE_STATS
+/**
+ *      @brief Starts timing a call. @c bytes is the output already written, such as @c pos of the
+ *             destination cursor, or 0.
+ */
+#define STAGE_START(timer, bytes) StageTimer timer = {barcode_stats_clock(), (bytes)}
+/**
+ *      @brief Records a call started by STAGE_START() against a stage, with the output written
+ *             since and its status.
+ */
+#define STAGE_STOP(timer, stage, bytes, status)                                                    \
+    barcode_stats_record((stage), &(timer), (bytes), (status))
+#else
+#define STAGE_START(timer, bytes)
+#define STAGE_STOP(timer, stage, bytes, status) ((void) 0)
+#endif
+
+/**
+ *      @brief Whether instrumentation was compiled into the library
+ */
+bool barcode_stats_enabled(void);
+
+/**
+ *      @brief Reads a monotonic clock, in nanoseconds
+ */
+long long barcode_stats_clock(void);
+
+/**
+ *      @brief Adds a call to the calling thread's counters of a stage.
+ *      @detail Used internally by STAGE_STOP().
+ *      @param stage The stage the call belongs to
+ *      @param timer The timer started by STAGE_START()
+ *      @param bytes The output written by the end of the call, as given to STAGE_START()
+ *      @param status The status returned by the call
+ */
+void barcode_stats_record(Stage, const StageTimer *, size_t, int);
+
+/**
+ *      @brief Reads the counters of the calling thread alone.
+ *      @param dest The snapshot to fill
+ */
+void barcode_stats_thread(StatsSnapshot *);
+
+/**
+ *      @brief Adds the calling thread's counters to the process-wide totals and zeroes them.
+ */
+void barcode_stats_publish(void);
+
+/**
+ *      @brief Reads the process-wide totals and the calling thread's unpublished counters.
+ *      @detail Each counter is read atomically, but not all of them at once, so a snapshot taken
+ *              while other threads publish may be part-way through a publication.
+ *      @param dest The snapshot to fill
+ */
+void barcode_stats_snapshot(StatsSnapshot *);
+
+/**
+ *      @brief Zeroes the process-wide totals and the calling thread's counters.
+ */
+void barcode_stats_reset(void);
+
+/**
+ *      @brief Adds the counters of one snapshot to another, such as to total those of threads
+ *             read with barcode_stats_thread().
+ *      @param total The snapshot to add to
+ *      @param add The snapshot to add
+ */
+void barcode_stats_add(StatsSnapshot *, const StatsSnapshot *);
+
+/**
+ *      @brief The name of a stage as a metric name, such as @c "ps_layout"
+ */
+const char * barcode_stage_name(Stage);
+
+#endif /* STATS_H */
@@ -0,0 +1,132 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file stream.h
+ *      @brief Declarations for encoding the records of a byte stream one at a time, as they are
+ *             read.
+ *      @detail Many functions defined here return externally-defined error codes, see errors.h for
+ *              more information.
+ *      @see errors.h
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "pipeline.h"
+#include "symb.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ *      @brief Size of the buffer a stream reads a file descriptor into, and so the longest record
+ *             it can hold
+ */
+#define ENCODE_STREAM_BUFSIZE 65536
+
+/**
+ *      @brief Maximum number of barcodes returned at once by encode_stream_block()
+ */
+#define ENCODE_STREAM_BLOCK 64
+
+/**
+ *      @brief Records read from a descriptor or memory and the barcodes last encoded from them.
+ */
+typedef struct EncodeStream EncodeStream;
+
+/**
+ *      @detail A stream holds a fixed read buffer and storage for one block of barcodes, so its
+ *              memory does not depend on the size of the input. Records are separated by a
+ *              delimiter; empty records are skipped and, when the delimiter is a newline, so is a
+ *              carriage return before it.
+ */
+struct EncodeStream {
+    int          fd;     /**< The descriptor read from, or -1 for a memory buffer */
+    const char * data;   /**< The input, or the read buffer of a descriptor */
+    size_t       start;  /**< Offset of the first byte of @c data not yet returned */
+    size_t       end;    /**< Offset of the end of the input read so far */
+    char *       buf;    /**< The read buffer of a descriptor, or NULL */
+    char         delim;  /**< The byte that ends each record */
+    bool         eof;    /**< Whether the whole input has been read */
+    int          status; /**< The first error reading the input */
+    long         number; /**< The number of the last record, from 1, counting empty records */
+    long         failed; /**< Number of records encode_stream_block() skipped as unencodable */
+    Code128 *    codes;  /**< Storage for a block of barcodes, with their patterns after them */
+    Code128 **   block;  /**< Pointers to @c codes, as returned by encode_stream_block() */
+};
+
+/**
+ *      @brief Initialises a stream reading records from a file descriptor, such as a pipe
+ *      @param stream The stream to initialise. Free it with encode_stream_free().
+ *      @param fd The descriptor to read from, which is not closed
+ *      @param delim The byte separating records, such as '\n'
+ *      @return SUCCESS
+ */
+int encode_stream_fd(EncodeStream *, int, char);
+
+/**
+ *      @brief Initialises a stream reading records from memory
+ *      @param stream The stream to initialise. Free it with encode_stream_free().
+ *      @param data The input, which is not copied and must outlive the stream
+ *      @param len The length of @c data
+ *      @param delim The byte separating records, such as '\n'
+ *      @return SUCCESS
+ */
+int encode_stream_memory(EncodeStream *, const char *, size_t, char);
+
+/**
+ *      @brief Frees the memory held by a stream
+ *      @param stream The stream to free
+ */
+void encode_stream_free(EncodeStream *);
+
+/**
+ *      @brief Reads the next record of a stream without encoding it
+ *      @detail A record too long for the read buffer is discarded and returned with a length of
+ *              -1, which no encoder accepts.
+ *      @param stream The stream to read from
+ *      @param data The destination of the record, valid until the next call, or of NULL at the end
+ *             of the input
+ *      @param len The destination of the record's length
+ *      @return SUCCESS or ERR_IO
+ */
+int encode_stream_record(EncodeStream *, const uchar **, int *);
+
+/**
+ *      @brief Reads and encodes the next record of a stream
+ *      @detail The barcode is stored in the stream and valid until the next call. A record that
+ *              cannot be encoded is consumed and its error returned, so the caller may report it,
+ *              using @c number, and carry on.
+ *      @param stream The stream to read from
+ *      @param dest The destination of the barcode, or of NULL at the end of the input
+ *      @return SUCCESS, ERR_IO, or the error encoding the record
+ */
+int encode_stream_next(EncodeStream *, Code128 **);
+
+/**
+ *      @brief Reads and encodes a block of records of a stream
+ *      @detail Records that cannot be encoded are skipped and counted in @c failed. The barcodes
+ *              are stored in the stream and valid until the next call.
+ *      @param stream The stream to read from
+ *      @param max The most barcodes to return, up to ENCODE_STREAM_BLOCK
+ *      @param dest The destination of an array of the barcodes
+ *      @param count The destination of the number of barcodes, which is 0 only at the end of the
+ *             input
+ *      @return SUCCESS, ERR_ARGUMENT or ERR_IO
+ */
+int encode_stream_block(EncodeStream *, int, Code128 ***, int *);
+
+/**
+ *      @brief Initialises a source for c128_pipeline() that reads the records of a stream
+ *      @param source The source to initialise
+ *      @param stream The stream to read from
+ */
+void encode_stream_source(Source *, EncodeStream *);
+
+#endif /* STREAM_H */
@@ -60,7 +60,7 @@
 /**
  *      @brief Evaluates to true if @c c is an ASCII control character or @c DEL.
  */
-#define IS_CTRL(c) (0 <= c && c < ASCII_NUM_CTRL || DEL == c)
+#define IS_CTRL(c) ((0 <= (c) && (c) < ASCII_NUM_CTRL) || DEL == (c))
 
 /**
  *      @brief Length of a string representation of a control character (excludes null
@@ -89,6 +89,9 @@
 #define C128_MAX_PATTERN_SIZE 42
 #define C128_MAX_STRREPR_SIZE (CTRL_STR_SIZE * C128_MAX_PATTERN_SIZE + 1)
 #define C128_INVERSE_SIZE 512
+// Modules in the longest barcode, excluding quiet zones
+#define C128_MAX_MODULES      (C128_DATA_WIDTH * (C128_MAX_PATTERN_SIZE - 1) + C128_STOP_WIDTH)
+#define C128_MAX_MODULE_BYTES ((C128_MAX_MODULES + 7) / 8)
 /*@}*/
 
 /**
@@ -118,6 +121,8 @@
 #define RSTOP   0b101011100
 /*      @brief Stop pattern with the trailing two bars added */
 #define STOPPT  0b1100011101011
+/*      @brief A data pattern with its leading black and trailing white bars added */
+#define C128_FULL_PATTERN(p) ((1 << (C128_DATA_WIDTH - 1)) | ((p) << 1))
 
 #define DEFAULT_C128_CODESET B
 /*      @brief A macro that outputs to the default code switching pattern enum given a codeset */
@@ -308,4 +313,22 @@ int c128_checksum(int *, int, int *);
  */
 int c128_encode(uchar *, int, Code128 **);
 
+/**
+ *      @brief Encodes a uchar array into an existing Code 128 barcode, without allocating.
+ *      @param data The data to be encoded.
+ *      @param data_len The length of the data array.
+ *      @param dest The barcode to overwrite, whose @c data must hold C128_MAX_PATTERN_SIZE
+ *             patterns.
+ *      @return As c128_encode(). On failure the contents of @c dest are unspecified.
+ *      @see c128_encode
+ */
+int c128_encode_into(uchar *, int, Code128 *);
+
+/**
+ *      @brief Frees a barcode allocated by c128_encode(), with the allocator that allocated it.
+ *      @param code The barcode to be freed, or NULL
+ *      @see barcode_set_allocator
+ */
+void c128_free(Code128 *);
+
 #endif /* SYMB_H */
@@ -10,6 +10,10 @@
  *      @author Elijah Schutz
  *      @date 12/12/18
  */
+
+#ifndef UTIL_H
+#define UTIL_H
+
 #include <stdbool.h>
 
 /**
@@ -38,3 +42,57 @@ bool isdigits(char *, int);
  *      @return A string of length len
  */
 char * slice(char *, int, int);
+
+/**
+ *      @brief Storage class of variables with one instance per thread
+ */
+#if defined(_MSC_VER) && !defined(__clang__)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+/**
+ *      @brief Number of micro-units in a unit
+ */
+#define MICRO_PER_UNIT 1000000
+
+/**
+ *      @brief Maximum length of a number formatted by fmt_int() or fmt_micro()
+ */
+#define FMT_BUFSIZE 28
+
+/**
+ *      @brief Converts a float length to micro-units, rounding to the nearest micro-unit
+ */
+#define TO_MICRO(x) ((micro) ((double) (x) * MICRO_PER_UNIT + ((x) < 0 ? -0.5 : 0.5)))
+
+/**
+ *      @brief A length in millionths of a unit.
+ *      @detail Layout calculations are done in integer micro-units rather than floats so that
+ *              positions do not drift, and output is the same on every platform.
+ */
+typedef long long micro;
+
+/**
+ *      @brief Formats an integer in base 10 without using the C library, so the output does not
+ *             depend on the locale
+ *      @param dest A destination array of at least FMT_BUFSIZE bytes. No null terminator is
+ *             written.
+ *      @param value The integer to format
+ *      @return The number of characters written
+ */
+int fmt_int(char *, long long);
+
+/**
+ *      @brief Formats a micro-unit length as a decimal number of units with the fewest digits that
+ *             represent it exactly, e.g. 6350000 as "6.35" and 10000000 as "10"
+ *      @param dest A destination array of at least FMT_BUFSIZE bytes. No null terminator is
+ *             written.
+ *      @param value The length to format
+ *      @return The number of characters written
+ *      @see fmt_int
+ */
+int fmt_micro(char *, micro);
+
+#endif /* UTIL_H */
@@ -0,0 +1,201 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file alloc.c
+ *      @brief Definitions for replacing the allocator used by the library.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/alloc.h"
+
+#include "barcode/util.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *      @brief Rounds a size up to a multiple of ALLOC_ALIGN
+ */
+#define ALLOC_ROUND(n) (((n) + ALLOC_ALIGN - 1) / ALLOC_ALIGN * ALLOC_ALIGN)
+
+/**
+ *      @brief Offset of BumpArena::last when there is no allocation to give back
+ */
+#define ARENA_NO_LAST SIZE_MAX
+
+static const Allocator *              global_allocator;
+static THREAD_LOCAL const Allocator * thread_allocator;
+
+void barcode_set_allocator(const Allocator * allocator) {
+    global_allocator = allocator;
+}
+
+const Allocator * barcode_use_allocator(const Allocator * allocator) {
+    const Allocator * previous = thread_allocator;
+    thread_allocator           = allocator;
+    return previous;
+}
+
+const Allocator * barcode_allocator(void) {
+    return thread_allocator ? thread_allocator : global_allocator;
+}
+
+void * barcode_malloc(size_t size) {
+    const Allocator * allocator = barcode_allocator();
+    return allocator ? allocator->alloc(allocator->ctx, size) : malloc(size);
+}
+
+void * barcode_calloc(size_t num, size_t size) {
+    const Allocator * allocator = barcode_allocator();
+    if (!allocator) {
+        return calloc(num, size);
+    }
+    if (num > 0 && size > SIZE_MAX / num) {
+        return NULL;
+    }
+
+    void * ptr = allocator->alloc(allocator->ctx, num * size);
+    if (ptr) {
+        memset(ptr, 0, num * size);
+    }
+    return ptr;
+}
+
+void * barcode_realloc(void * ptr, size_t size) {
+    const Allocator * allocator = barcode_allocator();
+    return allocator ? allocator->resize(allocator->ctx, ptr, size) : realloc(ptr, size);
+}
+
+void barcode_free(void * ptr) {
+    const Allocator * allocator = barcode_allocator();
+    if (!allocator) {
+        free(ptr);
+    } else if (ptr) {
+        allocator->release(allocator->ctx, ptr);
+    }
+}
+
+static void stats_grow(AllocStats * stats, size_t current) {
+    stats->current = current;
+    stats->peak    = current > stats->peak ? current : stats->peak;
+    stats->count++;
+}
+
+/**
+ *      @detail Each allocation is preceded by a header of ALLOC_ALIGN bytes holding its size, so
+ *              it can be copied when resized. The arena's current usage is the offset of the next
+ *              allocation.
+ */
+static void * arena_alloc(void * ctx, size_t size) {
+    Arena * arena = ctx;
+    size_t  used  = arena->stats.current;
+    if (size > arena->cap || ALLOC_ALIGN + ALLOC_ROUND(size) > arena->cap - used) {
+        return NULL;
+    }
+
+    char * header      = arena->buf + used;
+    *(size_t *) header = size;
+    arena->last        = used;
+    stats_grow(&arena->stats, used + ALLOC_ALIGN + ALLOC_ROUND(size));
+    return header + ALLOC_ALIGN;
+}
+
+static void arena_release(void * ctx, void * ptr) {
+    Arena * arena = ctx;
+    if (ARENA_NO_LAST != arena->last && (char *) ptr == arena->buf + arena->last + ALLOC_ALIGN) {
+        arena->stats.current = arena->last;
+        arena->last          = ARENA_NO_LAST;
+    }
+}
+
+/**
+ *      @detail The most recent allocation is resized in place, which is how buffers such as those
+ *              of cursors usually grow. Others are copied to a new allocation.
+ */
+static void * arena_resize(void * ctx, void * ptr, size_t size) {
+    Arena * arena = ctx;
+    if (!ptr) {
+        return arena_alloc(ctx, size);
+    }
+
+    char * header = (char *) ptr - ALLOC_ALIGN;
+    if (ARENA_NO_LAST != arena->last && header == arena->buf + arena->last) {
+        if (size > arena->cap || ALLOC_ALIGN + ALLOC_ROUND(size) > arena->cap - arena->last) {
+            return NULL;
+        }
+        *(size_t *) header = size;
+        stats_grow(&arena->stats, arena->last + ALLOC_ALIGN + ALLOC_ROUND(size));
+        return ptr;
+    }
+
+    size_t old  = *(size_t *) header;
+    void * copy = arena_alloc(ctx, size);
+    if (copy) {
+        memcpy(copy, ptr, old < size ? old : size);
+    }
+    return copy;
+}
+
+void arena_init(Arena * arena, void * buf, size_t cap) {
+    arena->allocator = (Allocator){arena_alloc, arena_resize, arena_release, arena};
+    arena->stats     = (AllocStats){0, 0, 0};
+    arena->buf       = buf;
+    arena->cap       = cap;
+    arena->last      = ARENA_NO_LAST;
+}
+
+void arena_reset(Arena * arena) {
+    arena->stats.current = 0;
+    arena->last          = ARENA_NO_LAST;
+}
+
+static void * pool_alloc(void * ctx, size_t size) {
+    Pool * pool  = ctx;
+    void * block = pool->free_list;
+    if (size > pool->block_size || !block) {
+        return NULL;
+    }
+
+    pool->free_list = *(void **) block;
+    stats_grow(&pool->stats, pool->stats.current + pool->block_size);
+    return block;
+}
+
+static void pool_release(void * ctx, void * ptr) {
+    Pool * pool     = ctx;
+    *(void **) ptr  = pool->free_list;
+    pool->free_list = ptr;
+    pool->stats.current -= pool->block_size;
+}
+
+static void * pool_resize(void * ctx, void * ptr, size_t size) {
+    Pool * pool = ctx;
+    if (!ptr) {
+        return pool_alloc(ctx, size);
+    }
+    return size <= pool->block_size ? ptr : NULL;
+}
+
+/**
+ *      @detail Free blocks are linked through their first bytes, in order of address.
+ */
+void pool_init(Pool * pool, void * buf, size_t cap, size_t block_size) {
+    pool->allocator  = (Allocator){pool_alloc, pool_resize, pool_release, pool};
+    pool->stats      = (AllocStats){0, 0, 0};
+    pool->buf        = buf;
+    pool->block_size = ALLOC_ROUND(block_size > sizeof(void *) ? block_size : sizeof(void *));
+    pool->num_blocks = cap / pool->block_size;
+    pool->free_list  = NULL;
+
+    for (size_t i = pool->num_blocks; i > 0; i--) {
+        void * block     = pool->buf + (i - 1) * pool->block_size;
+        *(void **) block = pool->free_list;
+        pool->free_list  = block;
+    }
+}
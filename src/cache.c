@@ -0,0 +1,182 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file cache.c
+ *      @brief Definitions of render cache functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/cache.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+#include "barcode/util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *      @detail Symbol indices are the Code 128 values of data symbols, followed by the three start
+ *              symbols and the stop symbol. The stop pattern includes its trailing bars.
+ */
+static pattern symbol_pattern(int symbol) {
+    static const pattern starts[] = {START_A, START_B, START_C};
+
+    if (symbol < C128_START_SYMBOL) {
+        return C128_CODE[symbol];
+    }
+    if (symbol < C128_STOP_SYMBOL) {
+        return starts[symbol - C128_START_SYMBOL];
+    }
+    return STOPPT;
+}
+
+/**
+ *      @detail Records the offsets, in modules from the left of the pattern, of the black modules
+ *              of a pattern including its leading and trailing bars.
+ */
+static int black_modules(pattern pat, bool stop, uchar * dest) {
+    int width = stop ? C128_STOP_WIDTH : C128_DATA_WIDTH;
+    int bars  = 0;
+
+    if (!stop) {
+        pat = C128_FULL_PATTERN(pat);
+    }
+    for (int i = 0; i < width; i++) {
+        if (((pat >> (width - 1 - i)) & 1) == Black) {
+            dest[bars++] = i;
+        }
+    }
+    return bars;
+}
+
+/**
+ *      @detail Renders every symbol back to back, recording where each one starts.
+ */
+static void render_symbols(RenderCache * cache, Cursor * dest) {
+    for (int i = 0; i < C128_NUM_SYMBOLS; i++) {
+        micro ps_x           = 0;
+        cache->ps_offsets[i] = dest->pos;
+        c128_ps_symbol(symbol_pattern(i), C128_STOP_SYMBOL == i, &ps_x, dest, &cache->props);
+    }
+    cache->ps_offsets[C128_NUM_SYMBOLS] = dest->pos;
+}
+
+/**
+ *      @detail The fragments are measured with a NULL cursor and then rendered into a single
+ *              allocation of exactly the measured size.
+ */
+int c128_cache_init(RenderCache * cache, const PSProperties * props) {
+    cache->props = *props;
+
+    memset(cache->symbols, C128_NO_SYMBOL, sizeof cache->symbols);
+    for (int i = 0; i < C128_STOP_SYMBOL; i++) {
+        cache->symbols[symbol_pattern(i)] = i;
+    }
+
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+    render_symbols(cache, &measure);
+
+    Cursor cursor;
+    cursor_alloc(&cursor, measure.pos);
+    render_symbols(cache, &cursor);
+    cache->ps = cursor.buf;
+
+    for (int i = 0; i < C128_NUM_SYMBOLS; i++) {
+        cache->svg_num_bars[i] =
+            black_modules(symbol_pattern(i), C128_STOP_SYMBOL == i, cache->svg_bars[i]);
+    }
+
+    return SUCCESS;
+}
+
+void c128_cache_free(RenderCache * cache) {
+    barcode_free(cache->ps);
+    cache->ps = NULL;
+}
+
+int c128_cache_symbol(const RenderCache * cache, Code128 * code, int i) {
+    pattern pat = code->data[i];
+    if (i + 1 == code->datalen) {
+        return STOPPT == pat ? C128_STOP_SYMBOL : C128_NO_SYMBOL;
+    }
+    if (pat >= C128_INVERSE_SIZE) {
+        return C128_NO_SYMBOL;
+    }
+    return cache->symbols[pat];
+}
+
+/**
+ *      @detail Image barcodes are a single command already, so they are not cached and are
+ *              rendered by c128_ps().
+ */
+int c128_ps_cached(Code128 * code, Cursor * dest, const RenderCache * cache) {
+    const PSProperties * props = &cache->props;
+    if (PS_MODE_IMAGE == props->mode) {
+        return c128_ps(code, dest, props);
+    }
+
+    micro bar_width   = TO_MICRO(props->bar_width);
+    micro quiet_width = C128_QUIET_WIDTH * bar_width;
+    micro ps_x        = quiet_width;
+
+    c128_ps_quiet_zone(dest, props);
+
+    for (int i = 0; i < code->datalen; i++) {
+        int symbol = c128_cache_symbol(cache, code, i);
+        if (C128_NO_SYMBOL == symbol) {
+            c128_ps_symbol(code->data[i], i + 1 == code->datalen, &ps_x, dest, props);
+            continue;
+        }
+
+        size_t offset = cache->ps_offsets[symbol];
+        cursor_write(dest, cache->ps + offset, cache->ps_offsets[symbol + 1] - offset);
+        ps_x += (C128_STOP_SYMBOL == symbol ? C128_STOP_WIDTH : C128_DATA_WIDTH) * bar_width;
+    }
+
+    c128_ps_quiet_zone(dest, props);
+    ps_x += quiet_width;
+
+    c128_ps_text(code->text, code->textlen, props->fontsize, ps_x / 2, dest);
+
+    return SUCCESS;
+}
+
+int c128_svg_cached(Code128 * code, Cursor * dest, const RenderCache * cache) {
+    cursor_write(dest, SVG_HEADER, strlen(SVG_HEADER));
+
+    int svg_x = C128_QUIET_WIDTH * SVG_RECT_WIDTH;
+    for (int i = 0; i < code->datalen; i++) {
+        bool          stop   = i + 1 == code->datalen;
+        int           symbol = c128_cache_symbol(cache, code, i);
+        uchar         uncached[C128_STOP_WIDTH];
+        const uchar * bars;
+        int           num_bars;
+
+        if (C128_NO_SYMBOL == symbol) {
+            num_bars = black_modules(code->data[i], stop, uncached);
+            bars     = uncached;
+        } else {
+            num_bars = cache->svg_num_bars[symbol];
+            bars     = cache->svg_bars[symbol];
+        }
+
+        for (int bar = 0; bar < num_bars; bar++) {
+            cursor_write(dest, SVG_RECT_PREFIX, strlen(SVG_RECT_PREFIX));
+            cursor_int(dest, svg_x + bars[bar] * SVG_RECT_WIDTH);
+            cursor_write(dest, SVG_BLACK_SUFFIX, strlen(SVG_BLACK_SUFFIX));
+        }
+        svg_x += (stop ? C128_STOP_WIDTH : C128_DATA_WIDTH) * SVG_RECT_WIDTH;
+    }
+    svg_x += C128_QUIET_WIDTH * SVG_RECT_WIDTH;
+
+    c128_text(code->text, code->textlen, svg_x / 2, dest);
+
+    return cursor_write(dest, SVG_FOOTER, SVG_FOOTER_LEN);
+}
@@ -0,0 +1,477 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file compose.c
+ *      @brief Definitions for compositing whole pages of barcodes into bitmaps on multiple
+ *             threads.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/compose.h"
+
+#include "barcode/alloc.h"
+#include "barcode/deflate.h"
+#include "barcode/errors.h"
+#include "barcode/printer.h"
+#include "barcode/sink.h"
+#include "barcode/util.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *      @brief Glyphs of the printable ASCII characters, as columns from left to right whose least
+ *             significant bit is the top row
+ */
+static const uchar FONT_5X7[][FONT_GLYPH_WIDTH] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+    {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+    {0x3E, 0x41, 0x49, 0x49, 0x7A}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+    {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F},
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00},
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0x7C, 0x14, 0x14, 0x14, 0x08},
+    {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00},
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08}};
+
+/**
+ *      @brief The position and text of a barcode on the page.
+ */
+typedef struct ComposeCell ComposeCell;
+
+/**
+ *      @brief A buffer holding one rendered band until it is written out.
+ */
+typedef struct BandSlot BandSlot;
+
+/**
+ *      @brief State shared between the writer and the workers rendering a page.
+ */
+typedef struct BandJob BandJob;
+
+struct ComposeCell {
+    int  text_x;   /**< Left of the first glyph */
+    int  text_top; /**< Top row of the glyphs */
+    int  textlen;  /**< Number of characters in @c text */
+    char text[CTRL_STR_SIZE * C128_MAX_DATA_LEN]; /**< The string representation of the text */
+};
+
+struct BandSlot {
+    uchar * bits;  /**< The rendered band, with the stride of the page */
+    bool    ready; /**< Whether the band has been rendered and may be written */
+};
+
+/**
+ *      @detail Every barcode in a row of the layout shares the same rows of pixels, so the bars of
+ *              each layout row are drawn once into @c bar_rows and copied into every band they
+ *              cross. Only text is drawn per band.
+ */
+struct BandJob {
+    const ComposeCell * cells;
+    int                 num_cells;
+    const uchar *       bar_rows;   /**< One row of pixels of the bars of each layout row */
+    const int *         bar_tops;   /**< The top row of the bars of each layout row */
+    int                 num_rows;   /**< The number of layout rows with barcodes */
+    int                 row_stride; /**< Bytes between the rows of @c bar_rows */
+    int                 bar_height; /**< Height of the bars in pixels */
+    int                 scale;      /**< Size of a pixel of the font, in pixels */
+    int                 width;      /**< Width of the page in pixels */
+    int                 height;     /**< Height of the page in pixels */
+    int                 stride;     /**< Bytes between rows of the page */
+    int                 bands;      /**< Total number of bands */
+    int                 window;     /**< Number of slots */
+    BandSlot *          slots;      /**< Band @c n is rendered into <tt>slots[n % window]</tt> */
+    int                 next;       /**< The next band to be claimed by a worker */
+    int                 written;    /**< The number of bands written out */
+    bool                stop;       /**< Set when writing fails, to stop the workers early */
+    pthread_mutex_t     lock;
+    pthread_cond_t      claimable; /**< Signalled when a slot is freed */
+    pthread_cond_t      ready;     /**< Signalled when a band is rendered */
+};
+
+/**
+ *      @detail Characters without a glyph are drawn as a question mark.
+ */
+static const uchar * font_glyph(char c) {
+    return FONT_5X7[(' ' <= c && c <= '~' ? c : '?') - ' '];
+}
+
+/**
+ *      @brief Sets a span of a row to black, clipped to the width of the page.
+ */
+static void clipped_span(uchar * row, int from, int to, int width) {
+    bitmap_span(row, from > 0 ? from : 0, to < width ? to : width);
+}
+
+/**
+ *      @detail Each row of glyph pixels is drawn as runs of set columns, repeated for each of the
+ *              @c scale rows of pixels it covers that fall within the band.
+ */
+static void
+draw_text(const BandJob * job, const ComposeCell * cell, uchar * bits, int top, int rows) {
+    int scale = job->scale;
+    for (int gy = 0; gy < FONT_GLYPH_HEIGHT; gy++) {
+        int from = cell->text_top + gy * scale;
+        int to   = from + scale;
+        from     = from > top ? from : top;
+        to       = to < top + rows ? to : top + rows;
+
+        for (int y = from; y < to; y++) {
+            uchar * row = bits + (size_t) (y - top) * job->stride;
+            for (int i = 0; i < cell->textlen; i++) {
+                const uchar * glyph = font_glyph(cell->text[i]);
+                int           left  = cell->text_x + i * FONT_ADVANCE * scale;
+                int           gx    = 0;
+                while (gx < FONT_GLYPH_WIDTH) {
+                    if (!((glyph[gx] >> gy) & 1)) {
+                        gx++;
+                        continue;
+                    }
+                    int run = 1;
+                    while (gx + run < FONT_GLYPH_WIDTH && ((glyph[gx + run] >> gy) & 1)) {
+                        run++;
+                    }
+                    clipped_span(row, left + gx * scale, left + (gx + run) * scale, job->width);
+                    gx += run;
+                }
+            }
+        }
+    }
+}
+
+/**
+ *      @detail The bars of each layout row crossing the band are copied in first. Bars of different
+ *              layout rows never overlap, but text may sit beside other text, so text is drawn on
+ *              top rather than copied.
+ */
+static void render_band(const BandJob * job, int band, uchar * bits) {
+    int top  = band * COMPOSE_BAND_ROWS;
+    int rows = job->height - top < COMPOSE_BAND_ROWS ? job->height - top : COMPOSE_BAND_ROWS;
+    memset(bits, 0, (size_t) rows * job->stride);
+
+    for (int r = 0; r < job->num_rows; r++) {
+        int from = job->bar_tops[r] > top ? job->bar_tops[r] : top;
+        int to   = job->bar_tops[r] + job->bar_height;
+        to       = to < top + rows ? to : top + rows;
+        for (int y = from; y < to; y++) {
+            memcpy(bits + (size_t) (y - top) * job->stride,
+                   job->bar_rows + (size_t) r * job->row_stride,
+                   job->stride);
+        }
+    }
+
+    int glyph_height = FONT_GLYPH_HEIGHT * job->scale;
+    for (int i = 0; i < job->num_cells; i++) {
+        const ComposeCell * cell = &job->cells[i];
+        if (cell->text_top < top + rows && cell->text_top + glyph_height > top) {
+            draw_text(job, cell, bits, top, rows);
+        }
+    }
+}
+
+static void * band_worker(void * arg) {
+    BandJob * job = arg;
+
+    pthread_mutex_lock(&job->lock);
+    for (;;) {
+        // Wait until the slot for the next band has been written out
+        while (!job->stop && job->next < job->bands && job->next - job->written >= job->window) {
+            pthread_cond_wait(&job->claimable, &job->lock);
+        }
+        if (job->stop || job->next >= job->bands) {
+            break;
+        }
+        int        band = job->next++;
+        BandSlot * slot = &job->slots[band % job->window];
+        pthread_mutex_unlock(&job->lock);
+
+        render_band(job, band, slot->bits);
+
+        pthread_mutex_lock(&job->lock);
+        slot->ready = true;
+        pthread_cond_broadcast(&job->ready);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/**
+ *      @brief Writes a band as an ESC/POS raster image, which has the same packing as a Bitmap.
+ */
+static int escpos_band(const Sink * out, const uchar * bits, int stride, int rows) {
+    uchar header[ESCPOS_RASTER_SIZE + 4];
+    memcpy(header, ESCPOS_RASTER, ESCPOS_RASTER_SIZE);
+    header[ESCPOS_RASTER_SIZE]     = stride & 0xFF;
+    header[ESCPOS_RASTER_SIZE + 1] = (stride >> 8) & 0xFF;
+    header[ESCPOS_RASTER_SIZE + 2] = rows & 0xFF;
+    header[ESCPOS_RASTER_SIZE + 3] = (rows >> 8) & 0xFF;
+
+    int status = out->write(out->ctx, (const char *) header, sizeof header);
+    if (SUCCESS == status) {
+        status = out->write(out->ctx, (const char *) bits, (size_t) rows * stride);
+    }
+    return status;
+}
+
+/**
+ *      @detail Writes the string representation of barcode text, as drawn by c128_text_escaped()
+ *              without escaping.
+ */
+static int cell_text(const Code128 * code, char * dest) {
+    int len = 0;
+    for (int i = 0; i < code->textlen; i++) {
+        char c = (char) code->text[i];
+        if (!IS_CTRL(c)) {
+            dest[len++] = c;
+            continue;
+        }
+
+        const char * ctrl = DEL == c ? DEL_STRREPR : ctrl_strrepr[(int) c];
+        for (int j = 0; j < CTRL_STR_SIZE && '\0' != ctrl[j]; j++) {
+            dest[len++] = ctrl[j];
+        }
+    }
+    return len;
+}
+
+/**
+ *      @detail Positions are converted from the units of @c props as late as possible, so that
+ *              rounding to whole pixels never accumulates across the page. Rows are laid out
+ *              upwards from the bottom margin, as in c128_pdf().
+ */
+static int compose_cells(BandJob *            job,
+                         Code128 **           codes,
+                         int                  num_codes,
+                         const PSProperties * props,
+                         Layout *             layout,
+                         int                  dpi,
+                         ComposeCell *        cells,
+                         int *                bar_tops,
+                         uchar **             bar_rows) {
+    float col_pitch = props->column_width + props->padding;
+    float row_pitch = props->bar_height + props->fontsize + props->padding;
+    int   module_px = raster_module_pixels(props, dpi);
+    int   pad       = raster_pixels(props->padding, props, dpi);
+
+    // Barcodes wider than their column may run past the edge of the page, so the bars are drawn
+    // into rows wide enough for every barcode and clipped when copied
+    int right = job->width;
+    for (int i = 0; i < num_codes; i++) {
+        int x     = raster_pixels(props->lmargin + (i % layout->cols) * col_pitch, props, dpi);
+        int width = (C128_DATA_WIDTH * codes[i]->datalen + 2 + 2 * C128_QUIET_WIDTH) * module_px;
+        right     = x + width > right ? x + width : right;
+    }
+    job->row_stride = CEILDIV(right, 8);
+
+    size_t rows_size = (size_t) job->num_rows * job->row_stride;
+    *bar_rows        = barcode_calloc(1, rows_size + 1);
+    VERIFY_NULL(*bar_rows, rows_size + 1);
+
+    for (int r = 0; r < job->num_rows; r++) {
+        float bottom = props->bmargin + props->padding + r * row_pitch + props->bar_height;
+        bar_tops[r]  = job->height - raster_pixels(bottom, props, dpi);
+    }
+
+    for (int i = 0; i < num_codes; i++) {
+        int   row = i / layout->cols;
+        int   x   = raster_pixels(props->lmargin + (i % layout->cols) * col_pitch, props, dpi);
+        int   width;
+        int   status = c128_raster_row(
+            codes[i], module_px, x, *bar_rows + (size_t) row * job->row_stride, &width);
+        if (SUCCESS != status) {
+            return status;
+        }
+
+        ComposeCell * cell = &cells[i];
+        cell->textlen      = cell_text(codes[i], cell->text);
+        int text_width     = (cell->textlen * FONT_ADVANCE - 1) * job->scale;
+        cell->text_x       = x + (width - text_width) / 2;
+        cell->text_top     = bar_tops[row] + job->bar_height + pad - FONT_GLYPH_HEIGHT * job->scale;
+    }
+    return SUCCESS;
+}
+
+/**
+ *      @detail The calling thread lays out the page, then waits on each band in order and writes
+ *              it as soon as it is ready, freeing its slot for a later band, as in
+ *              c128_ps_paginate_mt_stream().
+ */
+int c128_raster_layout(Code128 **           codes,
+                       int                  num_codes,
+                       const Sink *         out,
+                       const PSProperties * props,
+                       Layout *             layout,
+                       int                  dpi,
+                       RasterFormat         format,
+                       int                  threads) {
+    if (threads < 1 || dpi < 1) {
+        return ERR_ARGUMENT;
+    }
+    unsigned int max_codes = layout->cols * layout->rows;
+    if ((unsigned int) num_codes > max_codes || max_codes == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    float width  = props->lmargin + layout->cols * (props->column_width + props->padding) -
+                  props->padding + props->rmargin;
+    float height = props->bmargin + props->padding +
+                   (layout->rows - 1) * (props->bar_height + props->fontsize + props->padding) +
+                   props->bar_height + props->tmargin;
+    int bar_height = raster_pixels(props->bar_height, props, dpi);
+    int scale      = (props->fontsize * dpi + RASTER_POINTS_PER_INCH * FONT_POINTS_PER_PIXEL / 2) /
+                (RASTER_POINTS_PER_INCH * FONT_POINTS_PER_PIXEL);
+
+    BandJob job = {.num_cells  = num_codes,
+                   .num_rows   = CEILDIV(num_codes, (int) layout->cols),
+                   .bar_height = bar_height > 0 ? bar_height : 1,
+                   .scale      = scale > 0 ? scale : 1,
+                   .width      = raster_pixels(width, props, dpi),
+                   .height     = raster_pixels(height, props, dpi),
+                   .next       = 0,
+                   .written    = 0,
+                   .stop       = false};
+    job.stride = CEILDIV(job.width, 8);
+    job.bands  = CEILDIV(job.height, COMPOSE_BAND_ROWS);
+    job.window = COMPOSE_WINDOW_PER_THREAD * threads;
+    job.window = job.window < job.bands ? job.window : job.bands;
+
+    size_t        cells_size = sizeof(ComposeCell) * (num_codes + 1);
+    size_t        tops_size  = sizeof(int) * (job.num_rows + 1);
+    ComposeCell * cells      = barcode_malloc(cells_size);
+    VERIFY_NULL(cells, cells_size);
+    int * bar_tops = barcode_malloc(tops_size);
+    VERIFY_NULL(bar_tops, tops_size);
+    uchar * bar_rows = NULL;
+
+    int status =
+        compose_cells(&job, codes, num_codes, props, layout, dpi, cells, bar_tops, &bar_rows);
+    job.cells    = cells;
+    job.bar_tops = bar_tops;
+    job.bar_rows = bar_rows;
+    if (SUCCESS != status) {
+        barcode_free(cells);
+        barcode_free(bar_tops);
+        barcode_free(bar_rows);
+        return status;
+    }
+
+    size_t slots_size = sizeof *job.slots * (job.window + 1);
+    job.slots         = barcode_calloc(1, slots_size);
+    VERIFY_NULL(job.slots, slots_size);
+    size_t band_size = (size_t) COMPOSE_BAND_ROWS * job.stride;
+    for (int i = 0; i < job.window; i++) {
+        job.slots[i].bits = barcode_malloc(band_size);
+        VERIFY_NULL(job.slots[i].bits, band_size);
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.claimable, NULL);
+    pthread_cond_init(&job.ready, NULL);
+
+    PngWriter png;
+    if (RASTER_PNG == format) {
+        status = png_begin(&png, out, job.width, job.height, DEFLATE_LEVEL_DEFAULT);
+    } else if (RASTER_PBM == format) {
+        char header[PBM_HEADER_BUFSIZE];
+        int  len = snprintf(header, sizeof header, PBM_HEADER, job.width, job.height);
+        status   = out->write(out->ctx, header, len);
+    }
+
+    size_t      workers_size = sizeof(pthread_t) * threads;
+    pthread_t * workers      = barcode_malloc(workers_size);
+    VERIFY_NULL(workers, workers_size);
+    // Workers are only started once the header is written, as nothing else would stop them
+    int started = 0;
+    while (SUCCESS == status && started < threads &&
+           0 == pthread_create(&workers[started], NULL, band_worker, &job)) {
+        started++;
+    }
+
+    for (int band = 0; band < job.bands && SUCCESS == status; band++) {
+        BandSlot * slot = &job.slots[band % job.window];
+        // Without workers, each band is rendered just before it is written
+        if (0 == started) {
+            render_band(&job, band, slot->bits);
+            slot->ready = true;
+        }
+
+        pthread_mutex_lock(&job.lock);
+        while (!slot->ready) {
+            pthread_cond_wait(&job.ready, &job.lock);
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        int rows = job.height - band * COMPOSE_BAND_ROWS;
+        rows     = rows < COMPOSE_BAND_ROWS ? rows : COMPOSE_BAND_ROWS;
+        if (RASTER_PNG == format) {
+            status = png_rows(&png, slot->bits, job.stride, rows);
+        } else if (RASTER_ESCPOS == format) {
+            status = escpos_band(out, slot->bits, job.stride, rows);
+        } else {
+            status = out->write(out->ctx, (const char *) slot->bits, (size_t) rows * job.stride);
+        }
+
+        pthread_mutex_lock(&job.lock);
+        slot->ready = false;
+        job.written++;
+        if (SUCCESS != status) {
+            job.stop = true;
+        }
+        pthread_cond_broadcast(&job.claimable);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    if (RASTER_PNG == format) {
+        int ended = png_end(&png);
+        status    = SUCCESS != status ? status : ended;
+    }
+
+    barcode_free(workers);
+    for (int i = 0; i < job.window; i++) {
+        barcode_free(job.slots[i].bits);
+    }
+    barcode_free(job.slots);
+    barcode_free(cells);
+    barcode_free(bar_tops);
+    barcode_free(bar_rows);
+    pthread_cond_destroy(&job.ready);
+    pthread_cond_destroy(&job.claimable);
+    pthread_mutex_destroy(&job.lock);
+
+    return status;
+}
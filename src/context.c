@@ -0,0 +1,135 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file context.c
+ *      @brief Definitions of render context functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/context.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+
+/**
+ *      @brief The kinds of document a context renders.
+ */
+typedef enum CtxDocument { CTX_SVG, CTX_PS, CTX_PS_LAYOUT } CtxDocument;
+
+/**
+ *      @detail PostScript documents are framed by the header formatted when the context was
+ *              initialised, so only the barcodes themselves are rendered.
+ */
+static int ctx_write(BarcodeCtx * ctx,
+                     CtxDocument  doc,
+                     Code128 **   codes,
+                     int          num_codes,
+                     Layout *     layout) {
+    const RenderCache * cache  = ctx->cached ? &ctx->cache : NULL;
+    Cursor *            out    = &ctx->out;
+    int                 status = SUCCESS;
+
+    if (CTX_SVG == doc) {
+        c128_svg_cached(codes[0], out, &ctx->cache);
+        return SUCCESS;
+    }
+
+    cursor_write(out, ctx->header.buf, ctx->header.pos);
+    if (CTX_PS_LAYOUT == doc) {
+        status = c128_ps_cells(codes, num_codes, out, &ctx->cache.props, layout, cache);
+    } else if (NULL != cache) {
+        c128_ps_cached(codes[0], out, cache);
+    } else {
+        c128_ps(codes[0], out, &ctx->cache.props);
+    }
+    c128_ps_footer(out);
+    return status;
+}
+
+/**
+ *      @detail The document is rendered into the output buffer, which is grown to fit and the
+ *              document rendered again if it overflowed, so the buffer soon reaches the size of
+ *              the largest document and stays there.
+ */
+static int ctx_render(BarcodeCtx *  ctx,
+                      CtxDocument   doc,
+                      Code128 **    codes,
+                      int           num_codes,
+                      Layout *      layout,
+                      const char ** dest,
+                      size_t *      len) {
+    ctx->out.pos = 0;
+    int status   = ctx_write(ctx, doc, codes, num_codes, layout);
+    if (SUCCESS == status && CURSOR_OVERFLOWED(&ctx->out)) {
+        cursor_grow(&ctx->out, ctx->out.pos);
+        ctx->stats.grows++;
+        status = ctx_write(ctx, doc, codes, num_codes, layout);
+    }
+    if (SUCCESS != status) {
+        ctx->stats.errors++;
+        return status;
+    }
+
+    ctx->stats.renders++;
+    ctx->stats.bytes += ctx->out.pos;
+    *dest = cursor_str(&ctx->out);
+    if (NULL != len) {
+        *len = ctx->out.pos;
+    }
+    return SUCCESS;
+}
+
+int barcode_ctx_init(BarcodeCtx * ctx, const PSProperties * props) {
+    c128_cache_init(&ctx->cache, props);
+    ctx->cached = PS_MODE_IMAGE != props->mode;
+    ctx->code   = (Code128){.data = ctx->patterns};
+    ctx->stats  = (CtxStats){0, 0, 0, 0, 0};
+
+    cursor_init(&ctx->header, NULL, 0);
+    c128_ps_header(&ctx->header, props);
+    cursor_alloc(&ctx->header, ctx->header.pos);
+    c128_ps_header(&ctx->header, props);
+
+    cursor_init(&ctx->out, NULL, 0);
+    return SUCCESS;
+}
+
+void barcode_ctx_free(BarcodeCtx * ctx) {
+    barcode_free(ctx->header.buf);
+    barcode_free(ctx->out.buf);
+    c128_cache_free(&ctx->cache);
+}
+
+int barcode_ctx_encode(BarcodeCtx * ctx, uchar * data, int data_len, Code128 ** dest) {
+    int status = c128_encode_into(data, data_len, &ctx->code);
+    if (SUCCESS != status) {
+        ctx->stats.errors++;
+        return status;
+    }
+
+    ctx->stats.encodes++;
+    *dest = &ctx->code;
+    return SUCCESS;
+}
+
+int barcode_ctx_svg(BarcodeCtx * ctx, Code128 * code, const char ** dest, size_t * len) {
+    return ctx_render(ctx, CTX_SVG, &code, 1, NULL, dest, len);
+}
+
+int barcode_ctx_ps(BarcodeCtx * ctx, Code128 * code, const char ** dest, size_t * len) {
+    return ctx_render(ctx, CTX_PS, &code, 1, NULL, dest, len);
+}
+
+int barcode_ctx_ps_layout(BarcodeCtx *  ctx,
+                          Code128 **    codes,
+                          int           num_codes,
+                          Layout *      layout,
+                          const char ** dest,
+                          size_t *      len) {
+    return ctx_render(ctx, CTX_PS_LAYOUT, codes, num_codes, layout, dest, len);
+}
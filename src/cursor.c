@@ -0,0 +1,170 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file cursor.c
+ *      @brief Definitions of output cursor functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/cursor.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void cursor_init(Cursor * cursor, char * buf, size_t cap) {
+    cursor->buf     = buf;
+    cursor->pos     = 0;
+    cursor->cap     = cap;
+    cursor->sink    = NULL;
+    cursor->flushed = 0;
+    cursor->status  = SUCCESS;
+}
+
+void cursor_init_sink(Cursor * cursor, char * buf, size_t cap, const Sink * sink) {
+    cursor_init(cursor, buf, cap);
+    cursor->sink = sink;
+}
+
+int cursor_alloc(Cursor * cursor, size_t size) {
+    // + 1 for the null terminator added by cursor_str()
+    char * buf = barcode_malloc(size + 1);
+    VERIFY_NULL(buf, size + 1);
+
+    cursor_init(cursor, buf, size);
+    return SUCCESS;
+}
+
+int cursor_grow(Cursor * cursor, size_t size) {
+    if (NULL == cursor->buf || size > cursor->cap) {
+        char * buf = barcode_realloc(cursor->buf, size + 1);
+        VERIFY_NULL(buf, size + 1);
+        cursor->buf = buf;
+        cursor->cap = size;
+    }
+    cursor->pos = 0;
+    return SUCCESS;
+}
+
+/**
+ *      @detail Data that does not fit in the rest of the buffer is written after flushing it. Data
+ *              larger than the whole buffer is passed straight to the sink rather than copied.
+ */
+static int sink_write(Cursor * cursor, const char * data, size_t len) {
+    size_t buffered = cursor->pos - cursor->flushed;
+    cursor->pos += len;
+    if (SUCCESS != cursor->status) {
+        return cursor->status;
+    }
+
+    if (len <= cursor->cap - buffered) {
+        memcpy(cursor->buf + buffered, data, len);
+        return SUCCESS;
+    }
+
+    if (buffered > 0) {
+        cursor->status = cursor->sink->write(cursor->sink->ctx, cursor->buf, buffered);
+        cursor->flushed += buffered;
+    }
+    if (SUCCESS == cursor->status && len >= cursor->cap) {
+        cursor->status = cursor->sink->write(cursor->sink->ctx, data, len);
+        cursor->flushed += len;
+    } else if (SUCCESS == cursor->status) {
+        memcpy(cursor->buf, data, len);
+    }
+    return cursor->status;
+}
+
+/**
+ *      @detail When the data does not fit, @c pos is advanced regardless so that it records the
+ *              size the output needs. Every later write then also fails, so output is never written
+ *              at the wrong position.
+ */
+int cursor_write(Cursor * cursor, const char * data, size_t len) {
+    if (NULL != cursor->sink) {
+        return sink_write(cursor, data, len);
+    }
+    if (NULL == cursor->buf || cursor->pos > cursor->cap || len > cursor->cap - cursor->pos) {
+        cursor->pos += len;
+        return NULL == cursor->buf ? SUCCESS : ERR_BUFFER_SIZE;
+    }
+    memcpy(cursor->buf + cursor->pos, data, len);
+    cursor->pos += len;
+    return SUCCESS;
+}
+
+int cursor_puts(Cursor * cursor, const char * str) {
+    return cursor_write(cursor, str, strlen(str));
+}
+
+/**
+ *      @detail Output is formatted into a stack buffer first rather than straight into the cursor,
+ *              as @c vsnprintf always writes a null terminator, which may not fit in an exactly
+ *              sized buffer. Output too long for the stack buffer is formatted on the heap.
+ */
+int cursor_printf(Cursor * cursor, const char * fmt, ...) {
+    char    tmp[CURSOR_FMT_BUFSIZE];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(tmp, CURSOR_FMT_BUFSIZE, fmt, args);
+    va_end(args);
+
+    if (len < 0) {
+        return ERR_ARGUMENT;
+    }
+    if (len < CURSOR_FMT_BUFSIZE) {
+        return cursor_write(cursor, tmp, len);
+    }
+    if (NULL == cursor->sink && (NULL == cursor->buf || CURSOR_OVERFLOWED(cursor) ||
+                                 (size_t) len > cursor->cap - cursor->pos)) {
+        return cursor_write(cursor, NULL, len);
+    }
+
+    char * long_tmp = barcode_malloc(len + 1);
+    VERIFY_NULL(long_tmp, len + 1);
+
+    va_start(args, fmt);
+    vsnprintf(long_tmp, len + 1, fmt, args);
+    va_end(args);
+
+    int status = cursor_write(cursor, long_tmp, len);
+    barcode_free(long_tmp);
+    return status;
+}
+
+int cursor_int(Cursor * cursor, long long value) {
+    char num[FMT_BUFSIZE];
+    return cursor_write(cursor, num, fmt_int(num, value));
+}
+
+int cursor_micro(Cursor * cursor, micro value) {
+    char num[FMT_BUFSIZE];
+    return cursor_write(cursor, num, fmt_micro(num, value));
+}
+
+int cursor_flush(Cursor * cursor) {
+    size_t buffered = cursor->pos - cursor->flushed;
+    if (NULL != cursor->sink && SUCCESS == cursor->status && buffered > 0) {
+        cursor->status = cursor->sink->write(cursor->sink->ctx, cursor->buf, buffered);
+        cursor->flushed += buffered;
+    }
+    return cursor->status;
+}
+
+char * cursor_str(Cursor * cursor) {
+    if (NULL == cursor->buf || NULL != cursor->sink || cursor->pos > cursor->cap) {
+        return NULL;
+    }
+    cursor->buf[cursor->pos] = '\0';
+    return cursor->buf;
+}
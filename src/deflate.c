@@ -0,0 +1,420 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file deflate.c
+ *      @brief Definitions for the built-in DEFLATE compressor and its gzip and zlib sinks.
+ *      @see RFC 1950, RFC 1951 and RFC 1952
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/deflate.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GZIP_HEADER "\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\x03"
+#define GZIP_HEADER_SIZE 10
+/*      @brief A 32K window and no dictionary, with check bits making the header divisible by 31 */
+#define ZLIB_HEADER "\x78\x01"
+#define ZLIB_HEADER_SIZE 2
+#define ADLER_MOD 65521
+/*      @brief The most bytes that can be summed before the Adler-32 sums must be reduced */
+#define ADLER_NMAX 5552
+#define CRC32_POLY 0xEDB88320u
+#define END_OF_BLOCK 256
+#define BLOCK_STORED 0
+#define BLOCK_FIXED 1
+
+/*      @brief Base lengths and extra bits of length codes 257 to 285 */
+static const uint16_t LEN_BASE[]  = {3,  4,  5,  6,  7,  8,  9,   10,  11,  13,
+                                     15, 17, 19, 23, 27, 31, 35,  43,  51,  59,
+                                     67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t  LEN_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                     2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+/*      @brief Base distances and extra bits of distance codes 0 to 29 */
+static const uint16_t DIST_BASE[]  = {1,    2,    3,    4,    5,    7,    9,    13,   17,    25,
+                                      33,   49,   65,   97,   129,  193,  257,  385,  513,   769,
+                                      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385,
+                                      24577};
+static const uint8_t  DIST_EXTRA[] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static uint16_t reverse_bits(uint16_t code, int len) {
+    uint16_t rev = 0;
+    for (int i = 0; i < len; i++) {
+        rev  = (rev << 1) | (code & 1);
+        code = code >> 1;
+    }
+    return rev;
+}
+
+void deflate_crc_table(uint32_t * table) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? CRC32_POLY ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+}
+
+uint32_t deflate_crc32(const uint32_t * table, uint32_t crc, const uint8_t * data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ *      @detail Huffman codes are packed starting from their most significant bit, unlike every
+ *              other field, so the fixed codes of RFC 1951 section 3.2.6 are stored reversed.
+ */
+static void init_tables(GzipSink * gz) {
+    deflate_crc_table(gz->crc_table);
+
+    for (int sym = 0; sym < 288; sym++) {
+        uint16_t code;
+        int      len;
+        if (sym < 144) {
+            code = 0x30 + sym;
+            len  = 8;
+        } else if (sym < 256) {
+            code = 0x190 + sym - 144;
+            len  = 9;
+        } else if (sym < 280) {
+            code = sym - 256;
+            len  = 7;
+        } else {
+            code = 0xC0 + sym - 280;
+            len  = 8;
+        }
+        gz->lit_codes[sym] = reverse_bits(code, len);
+        gz->lit_lens[sym]  = len;
+    }
+}
+
+/**
+ *      @detail The sums are reduced only every ADLER_NMAX bytes, the most that cannot overflow.
+ */
+static uint32_t update_adler(uint32_t adler, const uint8_t * data, size_t len) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (len > 0) {
+        size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+        len -= n;
+        while (n-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
+
+/**
+ *      @detail Whole bytes are moved to the output buffer once 32 bits have built up, so @c bits
+ *              never holds more than 32 + 16 bits.
+ */
+static inline void put_bits(GzipSink * gz, uint32_t value, int len) {
+    gz->bits |= (uint64_t) value << gz->num_bits;
+    gz->num_bits += len;
+    if (gz->num_bits >= 32) {
+        uint8_t * out = gz->outbuf + gz->out_len;
+        out[0]        = gz->bits;
+        out[1]        = gz->bits >> 8;
+        out[2]        = gz->bits >> 16;
+        out[3]        = gz->bits >> 24;
+        gz->out_len += 4;
+        gz->bits >>= 32;
+        gz->num_bits -= 32;
+    }
+}
+
+/**
+ *      @brief Pads the output to a byte boundary and moves every pending bit to the output buffer.
+ */
+static void align_bits(GzipSink * gz) {
+    while (gz->num_bits > 0) {
+        gz->outbuf[gz->out_len++] = gz->bits;
+        gz->bits >>= 8;
+        gz->num_bits = gz->num_bits > 8 ? gz->num_bits - 8 : 0;
+    }
+    gz->bits = 0;
+}
+
+static void put_bytes(GzipSink * gz, const uint8_t * data, int len) {
+    memcpy(gz->outbuf + gz->out_len, data, len);
+    gz->out_len += len;
+}
+
+static void flush_output(GzipSink * gz) {
+    if (SUCCESS == gz->status && gz->out_len > 0) {
+        gz->status = gz->out->write(gz->out->ctx, (const char *) gz->outbuf, gz->out_len);
+    }
+    gz->out_len = 0;
+}
+
+static inline int hash(const uint8_t * p) {
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (DEFLATE_HASH_SIZE - 1);
+}
+
+/**
+ *      @brief Adds a position to the head of its hash chain, if three bytes are available there.
+ */
+static inline void insert(GzipSink * gz, int pos) {
+    if (pos + DEFLATE_MIN_MATCH <= gz->end) {
+        int h         = hash(gz->window + pos);
+        gz->prev[pos] = gz->head[h];
+        gz->head[h]   = pos;
+    }
+}
+
+/**
+ *      @brief Finds the longest earlier match for the input at @p pos within the window.
+ *      @return The length of the match, which is less than DEFLATE_MIN_MATCH if there is none
+ */
+static int longest_match(const GzipSink * gz, int pos, int * dist) {
+    const uint8_t * window = gz->window;
+    const uint8_t * scan   = window + pos;
+    int             limit  = gz->end - pos;
+    int             best   = DEFLATE_MIN_MATCH - 1;
+    if (limit > DEFLATE_MAX_MATCH) {
+        limit = DEFLATE_MAX_MATCH;
+    }
+    if (limit < DEFLATE_MIN_MATCH) {
+        return 0;
+    }
+
+    int cand = gz->head[hash(scan)];
+    for (int chain = gz->max_chain; cand >= 0 && chain > 0; chain--) {
+        if (pos - cand > DEFLATE_WSIZE) {
+            break;
+        }
+
+        const uint8_t * match = window + cand;
+        if (match[best] == scan[best] && match[0] == scan[0] && match[1] == scan[1]) {
+            int len = 2;
+            while (len < limit && match[len] == scan[len]) {
+                len++;
+            }
+            if (len > best) {
+                best  = len;
+                *dist = pos - cand;
+                if (len == limit) {
+                    break;
+                }
+            }
+        }
+        cand = gz->prev[cand];
+    }
+    return best;
+}
+
+static void put_match(GzipSink * gz, int len, int dist) {
+    int code = 28;
+    while (LEN_BASE[code] > len) {
+        code--;
+    }
+    put_bits(gz, gz->lit_codes[257 + code], gz->lit_lens[257 + code]);
+    put_bits(gz, len - LEN_BASE[code], LEN_EXTRA[code]);
+
+    code = 29;
+    while (DIST_BASE[code] > dist) {
+        code--;
+    }
+    put_bits(gz, reverse_bits(code, 5), 5);
+    put_bits(gz, dist - DIST_BASE[code], DIST_EXTRA[code]);
+}
+
+static void put_stored(GzipSink * gz, int final) {
+    int len = gz->end - gz->start;
+    put_bits(gz, final | BLOCK_STORED << 1, 3);
+    align_bits(gz);
+
+    uint8_t header[4] = {len & 0xFF, len >> 8, ~len & 0xFF, (~len >> 8) & 0xFF};
+    put_bytes(gz, header, 4);
+    put_bytes(gz, gz->window + gz->start, len);
+}
+
+/**
+ *      @detail Matching is greedy, and every position a match covers is still added to the hash
+ *              chains so that later matches can start inside it. If the block comes out larger
+ *              than it would stored, the output is rewound and it is stored instead, which is also
+ *              the fast path taken when @c max_chain is 0.
+ */
+static void compress_block(GzipSink * gz, int final) {
+    int      out_len  = gz->out_len;
+    uint64_t bits     = gz->bits;
+    int      num_bits = gz->num_bits;
+    if (0 == gz->max_chain) {
+        put_stored(gz, final);
+        return;
+    }
+
+    put_bits(gz, final | BLOCK_FIXED << 1, 3);
+    int pos = gz->start;
+    while (pos < gz->end) {
+        int dist = 0;
+        int len  = longest_match(gz, pos, &dist);
+        if (len >= DEFLATE_MIN_MATCH) {
+            put_match(gz, len, dist);
+            for (int i = 0; i < len; i++) {
+                insert(gz, pos + i);
+            }
+            pos += len;
+        } else {
+            put_bits(gz, gz->lit_codes[gz->window[pos]], gz->lit_lens[gz->window[pos]]);
+            insert(gz, pos);
+            pos++;
+        }
+    }
+    put_bits(gz, gz->lit_codes[END_OF_BLOCK], gz->lit_lens[END_OF_BLOCK]);
+
+    long fixed  = (long) (gz->out_len - out_len) * 8 + gz->num_bits - num_bits;
+    long stored = 3 + (8 - (num_bits + 3) % 8) % 8 + 32 + 8L * (gz->end - gz->start);
+    if (fixed > stored) {
+        gz->out_len  = out_len;
+        gz->bits     = bits;
+        gz->num_bits = num_bits;
+        put_stored(gz, final);
+    }
+}
+
+/**
+ *      @brief Moves the last DEFLATE_WSIZE bytes of input to the start of the window, along with
+ *             the hash chains that point into them.
+ */
+static void slide_window(GzipSink * gz) {
+    int shift = gz->end - DEFLATE_WSIZE;
+    memmove(gz->window, gz->window + shift, DEFLATE_WSIZE);
+    memmove(gz->prev, gz->prev + shift, DEFLATE_WSIZE * sizeof(*gz->prev));
+    for (int i = 0; i < DEFLATE_HASH_SIZE; i++) {
+        gz->head[i] = gz->head[i] >= shift ? gz->head[i] - shift : -1;
+    }
+    for (int i = 0; i < DEFLATE_WSIZE; i++) {
+        gz->prev[i] = gz->prev[i] >= shift ? gz->prev[i] - shift : -1;
+    }
+    gz->start -= shift;
+    gz->end -= shift;
+}
+
+static int gzip_write(void * ctx, const char * data, size_t len) {
+    GzipSink * gz = ctx;
+    if (DEFLATE_GZIP == gz->format) {
+        gz->crc = deflate_crc32(gz->crc_table, gz->crc, (const uint8_t *) data, len);
+    } else {
+        gz->adler = update_adler(gz->adler, (const uint8_t *) data, len);
+    }
+    gz->size += len;
+
+    while (len > 0 && SUCCESS == gz->status) {
+        size_t n = DEFLATE_BLOCK_SIZE - (gz->end - gz->start);
+        n        = n < len ? n : len;
+        memcpy(gz->window + gz->end, data, n);
+        gz->end += n;
+        data += n;
+        len -= n;
+
+        if (DEFLATE_BLOCK_SIZE == gz->end - gz->start) {
+            compress_block(gz, 0);
+            flush_output(gz);
+            gz->start = gz->end;
+            if (gz->end > DEFLATE_WSIZE) {
+                slide_window(gz);
+            }
+        }
+    }
+    return gz->status;
+}
+
+static int deflate_open(Sink *        sink,
+                        GzipSink **   gz,
+                        const Sink *  out,
+                        int           level,
+                        DeflateFormat format) {
+    GzipSink * stream = barcode_malloc(sizeof(GzipSink));
+    VERIFY_NULL(stream, sizeof(GzipSink));
+
+    if (level < DEFLATE_LEVEL_STORE) {
+        level = DEFLATE_LEVEL_STORE;
+    } else if (level > DEFLATE_LEVEL_MAX) {
+        level = DEFLATE_LEVEL_MAX;
+    }
+
+    stream->out       = out;
+    stream->format    = format;
+    stream->max_chain = level * DEFLATE_CHAIN_PER_LEVEL;
+    stream->status    = SUCCESS;
+    stream->crc       = 0;
+    stream->adler     = 1;
+    stream->size      = 0;
+    stream->start     = 0;
+    stream->end       = 0;
+    stream->bits      = 0;
+    stream->num_bits  = 0;
+    stream->out_len   = 0;
+    memset(stream->head, -1, sizeof(stream->head));
+    init_tables(stream);
+
+    if (DEFLATE_GZIP == format) {
+        put_bytes(stream, (const uint8_t *) GZIP_HEADER, GZIP_HEADER_SIZE);
+    } else {
+        put_bytes(stream, (const uint8_t *) ZLIB_HEADER, ZLIB_HEADER_SIZE);
+    }
+    flush_output(stream);
+
+    sink->write = gzip_write;
+    sink->ctx   = stream;
+    *gz         = stream;
+    return stream->status;
+}
+
+int sink_gzip(Sink * sink, GzipSink ** gz, const Sink * out, int level) {
+    return deflate_open(sink, gz, out, level, DEFLATE_GZIP);
+}
+
+int sink_zlib(Sink * sink, GzipSink ** gz, const Sink * out, int level) {
+    return deflate_open(sink, gz, out, level, DEFLATE_ZLIB);
+}
+
+/**
+ *      @detail The gzip trailer is the CRC-32 and length of the input, least significant byte
+ *              first, and the zlib trailer is the Adler-32 of the input, most significant first.
+ */
+int sink_gzip_finish(GzipSink * gz) {
+    if (SUCCESS == gz->status) {
+        compress_block(gz, 1);
+        align_bits(gz);
+
+        uint8_t trailer[8];
+        int     len = 0;
+        if (DEFLATE_GZIP == gz->format) {
+            for (int i = 0; i < 4; i++) {
+                trailer[i]     = gz->crc >> (8 * i);
+                trailer[i + 4] = gz->size >> (8 * i);
+            }
+            len = 8;
+        } else {
+            for (int i = 0; i < 4; i++) {
+                trailer[i] = gz->adler >> (24 - 8 * i);
+            }
+            len = 4;
+        }
+        put_bytes(gz, trailer, len);
+        flush_output(gz);
+    }
+
+    int status = gz->status;
+    barcode_free(gz);
+    return status;
+}
@@ -0,0 +1,556 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file export.c
+ *      @brief Definitions of bulk export functions.
+ *      @detail io_uring is driven through its system calls directly rather than liburing, so there
+ *              are no dependencies beyond the kernel headers. It is only built on Linux; elsewhere
+ *              exports always use threads.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/export.h"
+
+#include "barcode/alloc.h"
+#include "barcode/cursor.h"
+#include "barcode/errors.h"
+#include "barcode/graphic.h"
+#include "barcode/sink.h"
+#include "barcode/stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#define EXPORT_OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC)
+#define EXPORT_MODE 0666
+
+typedef struct ExportJob ExportJob;
+
+struct ExportJob {
+    Code128 **        codes;
+    int               num_codes;
+    const char *      path_fmt;
+    const Allocator * allocator; /**< The allocator of the calling thread, used by the workers */
+    int               next;      /**< The next barcode to be claimed by a worker */
+    int               status;    /**< The first error of any worker */
+    pthread_mutex_t   lock;
+};
+
+/**
+ *      @detail Conversions may have flags, a width and a precision, but no length modifier, so that
+ *              the one argument passed is always read as an @c int.
+ */
+bool c128_export_path_valid(const char * path_fmt) {
+    int conversions = 0;
+    for (const char * p = path_fmt; '\0' != *p; p++) {
+        if ('%' != *p) {
+            continue;
+        }
+        if ('%' == *++p) {
+            continue;
+        }
+        p += strspn(p, "-+ #0");
+        p += strspn(p, "0123456789");
+        if ('.' == *p) {
+            p++;
+            p += strspn(p, "0123456789");
+        }
+        if ('d' != *p) {
+            return false;
+        }
+        conversions++;
+    }
+    return 1 == conversions;
+}
+
+static int export_path(char * path, const char * path_fmt, int index) {
+    if (!c128_export_path_valid(path_fmt)) {
+        return ERR_ARGUMENT;
+    }
+    int len = snprintf(path, EXPORT_PATH_MAX, path_fmt, index);
+    return len < 0 || len >= EXPORT_PATH_MAX ? ERR_ARGUMENT : SUCCESS;
+}
+
+/**
+ *      @detail Renders into whatever buffer the cursor already has, growing it if it is too small.
+ */
+static int render_svg(Code128 * code, Cursor * dest) {
+    dest->pos  = 0;
+    int status = c128_svg_write(code, dest);
+    if (CURSOR_OVERFLOWED(dest)) {
+        cursor_grow(dest, dest->pos);
+        status = c128_svg_write(code, dest);
+    }
+    return status;
+}
+
+#ifdef __linux__
+
+/*      @brief Each file of a batch needs at most two submissions at once, a write and a close */
+#define URING_ENTRIES (2 * EXPORT_BATCH)
+/*      @brief Set in the user data of close submissions to tell them apart from writes */
+#define URING_CLOSE_TAG (1ULL << 32)
+
+typedef struct Uring      Uring;
+typedef struct ExportSlot ExportSlot;
+
+/**
+ *      @detail The submission and completion rings are shared with the kernel. Only @c tail is
+ *              private: submissions are queued at it and published to the kernel by uring_submit().
+ *              Once a system call on the ring fails, completions may still be outstanding, and
+ *              they could not be told apart from those of a later batch, so the ring is marked
+ *              failed and not used again.
+ */
+struct Uring {
+    int                   fd;
+    unsigned              tail; /**< Tail of the submission queue including unpublished entries */
+    unsigned *            sq_tail;
+    unsigned *            sq_mask;
+    unsigned *            sq_array;
+    struct io_uring_sqe * sqes;
+    unsigned *            cq_head;
+    unsigned *            cq_tail;
+    unsigned *            cq_mask;
+    struct io_uring_cqe * cqes;
+    void *                sq_ring;
+    size_t                sq_ring_size;
+    void *                cq_ring;
+    size_t                cq_ring_size;
+    size_t                sqes_size;
+    bool                  failed; /**< Whether submitting or waiting has failed */
+};
+
+/**
+ *      @detail One file of a batch. Its buffer is kept from batch to batch.
+ */
+struct ExportSlot {
+    Cursor cursor;
+    char   path[EXPORT_PATH_MAX];
+    int    fd; /**< The open file, or negative if the file is skipped or closed */
+};
+
+static void uring_free(Uring * ring) {
+    if (NULL != ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (NULL != ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (NULL != ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+}
+
+static void * uring_map(Uring * ring, size_t size, off_t offset) {
+    void * map =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, offset);
+    return MAP_FAILED == map ? NULL : map;
+}
+
+/**
+ *      @detail Asks the kernel whether it supports every operation used by the export.
+ */
+static bool uring_supported(Uring * ring) {
+    static const int ops[] = {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE};
+
+    size_t probe_size =
+        sizeof(struct io_uring_probe) + sizeof(struct io_uring_probe_op) * IORING_OP_LAST;
+    struct io_uring_probe * probe = barcode_calloc(1, probe_size);
+    VERIFY_NULL(probe, probe_size);
+
+    long probed = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe,
+                          IORING_OP_LAST);
+    bool supported = 0 == probed;
+    for (size_t i = 0; supported && i < sizeof ops / sizeof *ops; i++) {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    barcode_free(probe);
+    return supported;
+}
+
+static int uring_init(Uring * ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    memset(ring, 0, sizeof *ring);
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return ERR_UNSUPPORTED;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Newer kernels map both rings at once
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->sq_ring = uring_map(ring, ring->sq_ring_size, IORING_OFF_SQ_RING);
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->sq_ring = uring_map(ring, ring->sq_ring_size, IORING_OFF_SQ_RING);
+        ring->cq_ring = uring_map(ring, ring->cq_ring_size, IORING_OFF_CQ_RING);
+    }
+    ring->sqes = uring_map(ring, ring->sqes_size, IORING_OFF_SQES);
+
+    if (NULL == ring->sq_ring || NULL == ring->cq_ring || NULL == ring->sqes ||
+        !uring_supported(ring)) {
+        uring_free(ring);
+        return ERR_UNSUPPORTED;
+    }
+
+    char * sq      = ring->sq_ring;
+    char * cq      = ring->cq_ring;
+    ring->sq_tail  = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head  = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail  = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask  = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    ring->tail     = *ring->sq_tail;
+    return SUCCESS;
+}
+
+/**
+ *      @detail Returns a cleared submission queue entry. The caller must not queue more entries
+ *              between submissions than the ring holds.
+ */
+static struct io_uring_sqe * uring_sqe(Uring * ring) {
+    unsigned              index = ring->tail++ & *ring->sq_mask;
+    struct io_uring_sqe * sqe   = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof *sqe);
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+/**
+ *      @detail Publishes the queued entries and submits them, waiting for them all to complete in
+ *              the same system call where possible.
+ */
+static int uring_submit(Uring * ring, unsigned count) {
+    __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    while (submitted < count) {
+        long ret = syscall(__NR_io_uring_enter,
+                           ring->fd,
+                           count - submitted,
+                           count - submitted,
+                           IORING_ENTER_GETEVENTS,
+                           NULL,
+                           0);
+        if (ret < 0 && EINTR != errno) {
+            ring->failed = true;
+            return ERR_IO;
+        }
+        if (ret > 0) {
+            submitted += ret;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ *      @detail Returns the next completion, waiting for one if there are none, or NULL on failure.
+ *              Call uring_seen() when done with it.
+ */
+static struct io_uring_cqe * uring_cqe(Uring * ring) {
+    for (;;) {
+        unsigned head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            return &ring->cqes[head & *ring->cq_mask];
+        }
+
+        long ret = syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && EINTR != errno) {
+            ring->failed = true;
+            return NULL;
+        }
+    }
+}
+
+static void uring_seen(Uring * ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *      @detail Renders a batch and opens all of its files with one submission. Slots whose path or
+ *              file could not be made are skipped.
+ */
+static int open_batch(Uring *      ring,
+                      ExportSlot * slots,
+                      Code128 **   codes,
+                      int          count,
+                      int          first,
+                      const char * path_fmt) {
+    int      status = SUCCESS;
+    unsigned opens  = 0;
+
+    for (int i = 0; i < count; i++) {
+        slots[i].fd = -1;
+        if (SUCCESS != export_path(slots[i].path, path_fmt, first + i)) {
+            status = ERR_ARGUMENT;
+            continue;
+        }
+        render_svg(codes[i], &slots[i].cursor);
+
+        struct io_uring_sqe * sqe = uring_sqe(ring);
+        sqe->opcode               = IORING_OP_OPENAT;
+        sqe->fd                   = AT_FDCWD;
+        sqe->addr                 = (uintptr_t) slots[i].path;
+        sqe->len                  = EXPORT_MODE;
+        sqe->open_flags           = EXPORT_OPEN_FLAGS;
+        sqe->user_data            = i;
+        opens++;
+    }
+
+    if (SUCCESS != uring_submit(ring, opens)) {
+        return ERR_IO;
+    }
+    for (unsigned i = 0; i < opens; i++) {
+        struct io_uring_cqe * cqe = uring_cqe(ring);
+        if (NULL == cqe) {
+            return ERR_IO;
+        }
+        slots[cqe->user_data].fd = cqe->res;
+        if (cqe->res < 0) {
+            status = ERR_IO;
+        }
+        uring_seen(ring);
+    }
+    return status;
+}
+
+/**
+ *      @detail Each write is linked to the close of its file, so the close only runs once the write
+ *              has finished. If the write fails, the kernel cancels the close, so the file is
+ *              closed here instead.
+ */
+static int write_batch(Uring * ring, ExportSlot * slots, int count) {
+    int      status = SUCCESS;
+    unsigned queued = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (slots[i].fd < 0) {
+            continue;
+        }
+
+        struct io_uring_sqe * write = uring_sqe(ring);
+        write->opcode               = IORING_OP_WRITE;
+        write->fd                   = slots[i].fd;
+        write->addr                 = (uintptr_t) slots[i].cursor.buf;
+        write->len                  = slots[i].cursor.pos;
+        write->off                  = 0;
+        write->flags                = IOSQE_IO_LINK;
+        write->user_data            = i;
+
+        struct io_uring_sqe * close = uring_sqe(ring);
+        close->opcode               = IORING_OP_CLOSE;
+        close->fd                   = slots[i].fd;
+        close->user_data            = i | URING_CLOSE_TAG;
+        queued += 2;
+    }
+
+    if (SUCCESS != uring_submit(ring, queued)) {
+        return ERR_IO;
+    }
+    for (unsigned i = 0; i < queued; i++) {
+        struct io_uring_cqe * cqe = uring_cqe(ring);
+        if (NULL == cqe) {
+            return ERR_IO;
+        }
+
+        ExportSlot * slot = &slots[cqe->user_data & ~URING_CLOSE_TAG];
+        if (cqe->user_data & URING_CLOSE_TAG) {
+            if (-ECANCELED == cqe->res) {
+                close(slot->fd);
+            } else if (cqe->res < 0) {
+                status = ERR_IO;
+            }
+            slot->fd = -1;
+        } else if ((size_t) cqe->res != slot->cursor.pos) {
+            status = ERR_IO;
+        }
+        uring_seen(ring);
+    }
+    return status;
+}
+
+/**
+ *      @detail Closes the files of a batch left open when the ring failed part-way through it.
+ */
+static void close_batch(ExportSlot * slots, int count) {
+    for (int i = 0; i < count; i++) {
+        if (slots[i].fd >= 0) {
+            close(slots[i].fd);
+            slots[i].fd = -1;
+        }
+    }
+}
+
+int c128_svg_export_uring(Code128 ** codes, int num_codes, const char * path_fmt) {
+    Uring ring;
+    if (SUCCESS != uring_init(&ring, URING_ENTRIES)) {
+        return ERR_UNSUPPORTED;
+    }
+
+    size_t       slots_size = sizeof(ExportSlot) * EXPORT_BATCH;
+    ExportSlot * slots      = barcode_malloc(slots_size);
+    VERIFY_NULL(slots, slots_size);
+    for (int i = 0; i < EXPORT_BATCH; i++) {
+        cursor_alloc(&slots[i].cursor, EXPORT_BUFSIZE);
+    }
+
+    int status = SUCCESS;
+    for (int first = 0; first < num_codes; first += EXPORT_BATCH) {
+        int count = num_codes - first < EXPORT_BATCH ? num_codes - first : EXPORT_BATCH;
+
+        int opened  = open_batch(&ring, slots, codes + first, count, first, path_fmt);
+        int written = ring.failed ? ERR_IO : write_batch(&ring, slots, count);
+        if (SUCCESS == status) {
+            status = SUCCESS != opened ? opened : written;
+        }
+        if (ring.failed) {
+            close_batch(slots, count);
+            break;
+        }
+    }
+
+    for (int i = 0; i < EXPORT_BATCH; i++) {
+        barcode_free(slots[i].cursor.buf);
+    }
+    barcode_free(slots);
+    uring_free(&ring);
+    return status;
+}
+
+#else
+
+int c128_svg_export_uring(Code128 ** codes, int num_codes, const char * path_fmt) {
+    (void) codes;
+    (void) num_codes;
+    (void) path_fmt;
+    return ERR_UNSUPPORTED;
+}
+
+#endif /* __linux__ */
+
+static int write_file(const char * path, const char * data, size_t len) {
+    int fd = open(path, EXPORT_OPEN_FLAGS, EXPORT_MODE);
+    if (fd < 0) {
+        return ERR_IO;
+    }
+
+    Sink sink;
+    sink_fd(&sink, fd);
+    int status = sink.write(sink.ctx, data, len);
+    if (0 != close(fd)) {
+        status = ERR_IO;
+    }
+    return status;
+}
+
+static void * export_worker(void * arg) {
+    ExportJob * job = arg;
+    char        path[EXPORT_PATH_MAX];
+    Cursor      cursor;
+    barcode_use_allocator(job->allocator);
+    cursor_alloc(&cursor, EXPORT_BUFSIZE);
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->num_codes) {
+            break;
+        }
+
+        int status = export_path(path, job->path_fmt, i);
+        if (SUCCESS == status) {
+            render_svg(job->codes[i], &cursor);
+            status = write_file(path, cursor.buf, cursor.pos);
+        }
+        if (SUCCESS != status) {
+            pthread_mutex_lock(&job->lock);
+            if (SUCCESS == job->status) {
+                job->status = status;
+            }
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+
+    barcode_free(cursor.buf);
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail Barcodes are claimed one at a time, so if some workers cannot be started, the
+ *              calling thread joins in and the export still covers every barcode.
+ */
+int c128_svg_export_threads(Code128 ** codes, int num_codes, const char * path_fmt, int threads) {
+    if (threads < 1) {
+        return ERR_ARGUMENT;
+    }
+
+    ExportJob job = {.codes     = codes,
+                     .num_codes = num_codes,
+                     .path_fmt  = path_fmt,
+                     .allocator = barcode_allocator(),
+                     .next      = 0,
+                     .status    = SUCCESS};
+    pthread_mutex_init(&job.lock, NULL);
+
+    size_t      workers_size = sizeof(pthread_t) * threads;
+    pthread_t * workers      = barcode_malloc(workers_size);
+    VERIFY_NULL(workers, workers_size);
+    int started = 0;
+    while (started < threads && 0 == pthread_create(&workers[started], NULL, export_worker, &job)) {
+        started++;
+    }
+    if (started < threads) {
+        export_worker(&job);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    barcode_free(workers);
+    pthread_mutex_destroy(&job.lock);
+    return job.status;
+}
+
+int c128_svg_export(Code128 ** codes, int num_codes, const char * path_fmt, int threads) {
+    if (threads < 1) {
+        return ERR_ARGUMENT;
+    }
+
+    int status = c128_svg_export_uring(codes, num_codes, path_fmt);
+    if (ERR_UNSUPPORTED == status) {
+        status = c128_svg_export_threads(codes, num_codes, path_fmt, threads);
+    }
+    return status;
+}
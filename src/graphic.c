@@ -13,8 +13,12 @@
 
 #include "barcode/graphic.h"
 
+#include "barcode/alloc.h"
+#include "barcode/cache.h"
 #include "barcode/errors.h"
+#include "barcode/stats.h"
 #include "barcode/symb.h"
+#include "barcode/util.h"
 
 #include <string.h>
 
@@ -29,7 +33,8 @@ const PSProperties PS_DEFAULT_PROPS = {.units = PS_UNIT,
                                        .bar_height   = PS_HEIGHT,
                                        .padding      = PS_PAD,
                                        .column_width = PS_COL_W,
-                                       .fontsize     = PS_FONT_SIZE};
+                                       .fontsize     = PS_FONT_SIZE,
+                                       .mode         = PS_MODE_MODULE};
 
 size_t svg_bufsize(int rects) {
     // Add 1 to allow for the null terminator
@@ -42,58 +47,119 @@ size_t ps_bufsize(int rects) {
     return PS_CMD_BUFSIZE * rects + PS_TEXT_BUFSIZE + 1;
 }
 
-int svg_rect(int x, int y, int w, int h, char * colour, char dest[][SVG_RECT_BUFSIZE]) {
+int svg_rect(int x, int y, int w, int h, char * colour, Cursor * dest) {
     if (strlen(colour) > SVG_COLOUR_LEN) {
         fprintf(stderr, "colour code '%s' too long", colour);
         return ERR_ARGUMENT;
     }
 
-    snprintf(*dest,
-             SVG_RECT_BUFSIZE,
-             "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"%s\"/>",
-             x,
-             y,
-             w,
-             h,
-             colour);
-    return SUCCESS;
+    cursor_puts(dest, "<rect x=\"");
+    cursor_int(dest, x);
+    cursor_puts(dest, "\" y=\"");
+    cursor_int(dest, y);
+    cursor_puts(dest, "\" width=\"");
+    cursor_int(dest, w);
+    cursor_puts(dest, "\" height=\"");
+    cursor_int(dest, h);
+    cursor_puts(dest, "\" fill=\"");
+    cursor_puts(dest, colour);
+    return cursor_puts(dest, "\"/>");
 }
 
-int c128_text(char * text, int index, char dest[][SVG_TEXT_BUFSIZE]) {
-    snprintf(*dest,
-             SVG_TEXT_BUFSIZE,
-             "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" font-family=\"Helvetica\" "
-             "font-size=\"%d\" fill=\"black\">%s</text>",
-             index,
-             SVG_LINE_HEIGHT,
-             SVG_FONT_SIZE,
-             text);
-    return SUCCESS;
+/**
+ *      @detail Returns the escape sequence of a character of a string representation, or NULL if it
+ *              is written as is.
+ */
+static const char * escape_char(char c, TextEscape escape) {
+    if (TEXT_ESCAPE_XML == escape) {
+        switch (c) {
+        case '<':
+            return "&lt;";
+        case '>':
+            return "&gt;";
+        case '&':
+            return "&amp;";
+        }
+    } else {
+        switch (c) {
+        case '(':
+            return "\\(";
+        case ')':
+            return "\\)";
+        case '\\':
+            return "\\\\";
+        }
+    }
+    return NULL;
 }
 
-int c128_ps_text(char * text, int fsize, int index, char dest[][PS_TEXT_BUFSIZE]) {
-    snprintf(*dest, PS_TEXT_BUFSIZE, PS_TEXT, fsize, text, index);
-    return SUCCESS;
+/**
+ *      @detail Runs of characters that need no escaping are copied straight from @c text, so most
+ *              text is written with a single cursor_write().
+ */
+int c128_text_escaped(const uchar * text, int textlen, TextEscape escape, Cursor * dest) {
+    int run = 0; // Start of the current run of unescaped characters
+
+    for (int i = 0; i < textlen; i++) {
+        char         c       = (char) text[i];
+        const char * repr    = escape_char(c, escape);
+        bool         is_ctrl = IS_CTRL(c);
+        if (NULL == repr && !is_ctrl) {
+            continue;
+        }
+
+        cursor_write(dest, (const char *) text + run, i - run);
+        run = i + 1;
+        if (!is_ctrl) {
+            cursor_puts(dest, repr);
+            continue;
+        }
+
+        const char * ctrl = DEL == c ? DEL_STRREPR : ctrl_strrepr[(int) c];
+        for (int j = 0; j < CTRL_STR_SIZE && '\0' != ctrl[j]; j++) {
+            const char * ctrl_repr = escape_char(ctrl[j], escape);
+            if (NULL != ctrl_repr) {
+                cursor_puts(dest, ctrl_repr);
+            } else {
+                cursor_write(dest, ctrl + j, 1);
+            }
+        }
+    }
+
+    return cursor_write(dest, (const char *) text + run, textlen - run);
 }
 
-int c128_rect_black(int x, int w, char dest[][SVG_RECT_BUFSIZE]) {
-    svg_rect(x, SVG_DEFAULT_Y, w, SVG_RECT_HEIGHT, "black", dest);
-    return SUCCESS;
+int c128_text(const uchar * text, int textlen, int index, Cursor * dest) {
+    cursor_printf(dest, SVG_TEXT, index, SVG_LINE_HEIGHT, SVG_FONT_SIZE);
+    c128_text_escaped(text, textlen, TEXT_ESCAPE_XML, dest);
+    return cursor_write(dest, SVG_TEXT_SUFFIX, strlen(SVG_TEXT_SUFFIX));
 }
 
-int c128_rect_white(int x, int w, char dest[][SVG_RECT_BUFSIZE]) {
-    svg_rect(x, SVG_DEFAULT_Y, w, SVG_RECT_HEIGHT, "white", dest);
-    return SUCCESS;
+int c128_ps_text(const uchar * text, int textlen, int fsize, micro index, Cursor * dest) {
+    char num[FMT_BUFSIZE + 1];
+    num[fmt_micro(num, index)] = '\0';
+
+    cursor_printf(dest, PS_TEXT, fsize);
+    c128_text_escaped(text, textlen, TEXT_ESCAPE_PS, dest);
+    return cursor_printf(dest, PS_TEXT_SUFFIX, num);
 }
 
-int c128_ps_rect_black(char dest[][PS_CMD_BUFSIZE]) {
-    strncpy(*dest, PS_BAR, strlen(PS_BAR));
-    return SUCCESS;
+int c128_rect_black(int x, int w, Cursor * dest) {
+    return svg_rect(x, SVG_DEFAULT_Y, w, SVG_RECT_HEIGHT, "black", dest);
 }
 
-int c128_ps_rect_white(int w, char dest[][PS_CMD_BUFSIZE]) {
-    snprintf(*dest, PS_CMD_BUFSIZE, PS_WSPACE, w);
-    return SUCCESS;
+int c128_rect_white(int x, int w, Cursor * dest) {
+    return svg_rect(x, SVG_DEFAULT_Y, w, SVG_RECT_HEIGHT, "white", dest);
+}
+
+int c128_ps_rect_black(Cursor * dest) {
+    return cursor_write(dest, PS_BAR, strlen(PS_BAR));
+}
+
+int c128_ps_rect_white(int w, Cursor * dest) {
+    cursor_write(dest, PS_WSPACE, strlen(PS_WSPACE));
+    cursor_int(dest, w);
+    return cursor_write(dest, PS_WSPACE_SUFFIX, strlen(PS_WSPACE_SUFFIX));
 }
 
 /**
@@ -106,7 +172,7 @@ int c128_ps_rect_white(int w, char dest[][PS_CMD_BUFSIZE]) {
  *              black and white bars are added to string, generating a barcode SVG from the internal
  *              representation.
  */
-int c128_pat2svg(pattern pat, int width, int * svg_x, char ** dest) {
+int c128_pat2svg(pattern pat, int width, int * svg_x, Cursor * dest) {
     /**
      * A decrementing counter is used so iteration begins from the left. Using the example above,
      * <tt>i == 6</tt> on the first iteration, <tt>(p >> 6) & 1 == 1</tt>, yielding a black bar.
@@ -114,9 +180,7 @@ int c128_pat2svg(pattern pat, int width, int * svg_x, char ** dest) {
 
     for (int i = width - 1; i >= 0; i--) {
         if (((pat >> i) & 1) == Black) {
-            char bar[SVG_RECT_BUFSIZE];
-            c128_rect_black(*svg_x, SVG_RECT_WIDTH, &bar);
-            strncat(*dest, bar, SVG_RECT_BUFSIZE);
+            c128_rect_black(*svg_x, SVG_RECT_WIDTH, dest);
             // For a white bar, nothing is added as the group fill is white
             // See SVG_HEADER in graphic.h
         }
@@ -129,37 +193,60 @@ int c128_pat2svg(pattern pat, int width, int * svg_x, char ** dest) {
  *      @detail See c128_pat2svg() for details on the algorithim used to print barcodes
  *      @see c128_pat2svg
  */
-int c128_pat2ps(pattern pat, int width, float * ps_x, char ** dest, const PSProperties * props) {
-    char bar[PS_CMD_BUFSIZE];
-    memset(&bar, 0, PS_CMD_BUFSIZE);
+int c128_pat2ps(pattern pat, int width, micro * ps_x, Cursor * dest, const PSProperties * props) {
+    micro bar_width = TO_MICRO(props->bar_width);
     for (int i = width - 1; i >= 0; i--) {
         if (((pat >> i) & 1) == Black) {
-            c128_ps_rect_black(&bar);
+            c128_ps_rect_black(dest);
         } else {
             // 1, as there is a single bar
-            c128_ps_rect_white(1, &bar);
+            c128_ps_rect_white(1, dest);
         }
-        strncat(*dest, bar, PS_CMD_BUFSIZE);
-        *ps_x += props->bar_width;
-        memset(&bar, 0, PS_CMD_BUFSIZE);
+        *ps_x += bar_width;
     }
     return SUCCESS;
 }
 
-int c128_svg(Code128 * code, char ** dest) {
+/**
+ *      @detail The pattern is scanned from the left as in c128_pat2svg(), but instead of emitting a
+ *              command per module, the length of each run of same-coloured modules is counted and a
+ *              single PS_RUN_BAR or PS_RUN_SPACE command is emitted for the whole run. Code 128
+ *              bars and spaces are at most 4 modules wide, so each data pattern yields exactly 6
+ *              commands (7 for the stop pattern) rather than 11 (13).
+ */
+int c128_pat2ps_rl(pattern              pat,
+                   int                  width,
+                   micro *              ps_x,
+                   Cursor *             dest,
+                   const PSProperties * props) {
+    micro bar_width = TO_MICRO(props->bar_width);
+    int   i         = width - 1;
+    while (i >= 0) {
+        BarType colour = (pat >> i) & 1;
+        int     run    = 0;
+        while (i >= 0 && ((pat >> i) & 1) == colour) {
+            run++;
+            i--;
+        }
+        cursor_int(dest, run);
+        if (Black == colour) {
+            cursor_write(dest, PS_RUN_BAR, strlen(PS_RUN_BAR));
+        } else {
+            cursor_write(dest, PS_RUN_SPACE, strlen(PS_RUN_SPACE));
+        }
+        *ps_x += run * bar_width;
+    }
+    return SUCCESS;
+}
+
+static int svg_write(Code128 * code, Cursor * dest) {
     /**
      * Code 128 barcodes have whitespace 'quiet zone' of a prescribed width preceding and following
      * the barcode, which is required for it to be properly readable.
      */
     static const int quiet_width = C128_QUIET_WIDTH * SVG_RECT_WIDTH;
 
-    // +2 to account for the extra two bars at the end of the code
-    int    rects     = code->datalen * C128_DATA_WIDTH + 2 * C128_QUIET_WIDTH + 2;
-    size_t dest_size = svg_bufsize(rects);
-    *dest            = calloc(1, dest_size);
-    VERIFY_NULL(*dest, dest_size);
-
-    strncpy(*dest, SVG_HEADER, strlen(SVG_HEADER));
+    cursor_write(dest, SVG_HEADER, strlen(SVG_HEADER));
 
     // x-coordinate
     // As the background is white, the leading quiet zone is implemented by having quiet_width
@@ -170,14 +257,10 @@ int c128_svg(Code128 * code, char ** dest) {
          * All Code 128 patterns are preceded by a black bar and followed by a white bar, so this is
          * removed from the internal representation and added when generating a barcode image.
          */
-        char    bbar[SVG_RECT_BUFSIZE];
         pattern pat = code->data[i];
         if (i + 1 != code->datalen) {
             // Add leading black bar
-
-            memset(&bbar, 0, SVG_RECT_BUFSIZE);
-            c128_rect_black(svg_x, SVG_RECT_WIDTH, &bbar);
-            strncat(*dest, bbar, strlen(bbar));
+            c128_rect_black(svg_x, SVG_RECT_WIDTH, dest);
             svg_x += SVG_RECT_WIDTH;
 
             // - 2 to account for leading and trailing bars
@@ -195,58 +278,108 @@ int c128_svg(Code128 * code, char ** dest) {
     svg_x += quiet_width;
 
     // Add the barcode text beneath the barcode at its centre
-    char * text;
-    c128_strrepr(code->text, code->textlen, &text);
+    c128_text(code->text, code->textlen, svg_x / 2, dest);
 
-    char svg_text[SVG_TEXT_BUFSIZE];
-    c128_text(text, svg_x / 2, &svg_text);
+    return cursor_write(dest, SVG_FOOTER, SVG_FOOTER_LEN);
+}
 
-    strncat(*dest, svg_text, SVG_TEXT_BUFSIZE);
+int c128_svg_write(Code128 * code, Cursor * dest) {
+    STAGE_START(timer, dest->pos);
+    int status = svg_write(code, dest);
+    STAGE_STOP(timer, STAGE_SVG, dest->pos, status);
+    return status;
+}
 
-    strncat(*dest, SVG_FOOTER, SVG_FOOTER_LEN);
+/**
+ *      @detail The SVG is rendered to a NULL cursor, which counts the bytes that would be written
+ *              without writing them.
+ */
+int c128_svg_size(Code128 * code, size_t * size) {
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
 
-    free(text);
+    int status = svg_write(code, &measure);
+    *size      = measure.pos;
+    return status;
+}
 
-    return SUCCESS;
+int c128_svg(Code128 * code, char ** dest) {
+    STAGE_START(timer, 0);
+    size_t size;
+    int    status = c128_svg_size(code, &size);
+    if (SUCCESS != status) {
+        STAGE_STOP(timer, STAGE_SVG, 0, status);
+        return status;
+    }
+
+    Cursor cursor;
+    cursor_alloc(&cursor, size);
+    status = svg_write(code, &cursor);
+    *dest  = cursor_str(&cursor);
+
+    STAGE_STOP(timer, STAGE_SVG, cursor.pos, status);
+    return status;
 }
 
 /**
- *      @detail This function is used internally, so you're probably looking for c128_ps_layout()
- *      @see c128_ps_layout()
+ *      @detail Ends a streaming render by flushing whatever is left in the cursor's buffer.
  */
-int c128_ps_init(char ** dest, int barcodes) {
-    // + 1 for null terminator
-    size_t dest_size = PS_HEADER_BUFSIZE +
-                       ps_bufsize(C128_MAX_PATTERN_SIZE * C128_DATA_WIDTH + 2 * C128_QUIET_WIDTH +
-                                  PS_MAX_POSITION_CMDS * PS_CMD_BUFSIZE) *
-                           barcodes +
-                       strlen(PS_FOOTER) + 1;
-    *dest = calloc(1, dest_size);
-    VERIFY_NULL(*dest, dest_size);
+static int stream_end(Cursor * cursor, int status) {
+    int flushed = cursor_flush(cursor);
+    return SUCCESS != status ? status : flushed;
+}
 
-    return SUCCESS;
+int c128_svg_stream(Code128 * code, const Sink * sink) {
+    char   buf[CURSOR_SINK_BUFSIZE];
+    Cursor cursor;
+    cursor_init_sink(&cursor, buf, sizeof buf, sink);
+
+    return stream_end(&cursor, c128_svg_write(code, &cursor));
 }
 
 /**
  *      @detail This function is used internally, so you're probably looking for c128_ps_layout()
  *      @see c128_ps_layout()
  */
-int c128_ps_header(char ** dest, const PSProperties * props) {
-    char header[PS_HEADER_BUFSIZE];
-    snprintf(header,
-             PS_HEADER_BUFSIZE,
-             PS_HEADER,
-             props->units,
-             props->lmargin,
-             props->rmargin,
-             props->tmargin,
-             props->bmargin,
-             props->bar_width,
-             props->bar_height,
-             props->padding,
-             props->column_width);
-
-    strncpy(*dest, header, PS_HEADER_BUFSIZE);
+int c128_ps_init(Cursor * dest, size_t size) {
+    return cursor_alloc(dest, size);
+}
+
+/**
+ *      @detail Writes PS_PROLOG and any procedures needed by the bar mode. Shared by the headers of
+ *              single-page and paged documents.
+ */
+static int ps_prolog(Cursor * dest, const PSProperties * props) {
+    const float lengths[] = {props->lmargin,
+                             props->rmargin,
+                             props->tmargin,
+                             props->bmargin,
+                             props->bar_width,
+                             props->bar_height,
+                             props->padding,
+                             props->column_width};
+    char        nums[sizeof lengths / sizeof *lengths][FMT_BUFSIZE + 1];
+    for (size_t i = 0; i < sizeof lengths / sizeof *lengths; i++) {
+        nums[i][fmt_micro(nums[i], TO_MICRO(lengths[i]))] = '\0';
+    }
+
+    cursor_printf(dest,
+                  PS_PROLOG,
+                  props->units,
+                  nums[0],
+                  nums[1],
+                  nums[2],
+                  nums[3],
+                  nums[4],
+                  nums[5],
+                  nums[6],
+                  nums[7]);
+
+    if (PS_MODE_RUNLENGTH == props->mode) {
+        cursor_write(dest, PS_RUN_PROCS, strlen(PS_RUN_PROCS));
+    } else if (PS_MODE_IMAGE == props->mode) {
+        cursor_write(dest, PS_IMAGE_PROCS, strlen(PS_IMAGE_PROCS));
+    }
 
     return SUCCESS;
 }
@@ -255,102 +388,933 @@ int c128_ps_header(char ** dest, const PSProperties * props) {
  *      @detail This function is used internally, so you're probably looking for c128_ps_layout()
  *      @see c128_ps_layout()
  */
-int c128_ps_footer(char ** dest) {
-    strncat(*dest, PS_FOOTER, PS_FOOTER_LEN);
-    return SUCCESS;
+int c128_ps_header(Cursor * dest, const PSProperties * props) {
+    cursor_write(dest, "%!PS\n", strlen("%!PS\n"));
+    return ps_prolog(dest, props);
 }
 
 /**
  *      @detail This function is used internally, so you're probably looking for c128_ps_layout()
  *      @see c128_ps_layout()
  */
-int c128_ps(Code128 * code, char ** dest, const PSProperties * props) {
-    char quiet_zone[PS_CMD_BUFSIZE];
-    c128_ps_rect_white(C128_QUIET_WIDTH, &quiet_zone);
-    strncat(*dest, quiet_zone, PS_CMD_BUFSIZE);
+int c128_ps_footer(Cursor * dest) {
+    return cursor_write(dest, PS_FOOTER, PS_FOOTER_LEN);
+}
+
+/**
+ *      @detail The modules of each pattern are shifted into an accumulator from the left, as in
+ *              c128_pat2svg(), and flushed a byte at a time. The final byte is padded with white
+ *              modules, as rows of PostScript images are padded to a whole byte.
+ */
+int c128_modules(Code128 * code, uchar * dest, int * width) {
+    if (code->datalen > C128_MAX_PATTERN_SIZE) {
+        return ERR_DATA_LENGTH;
+    }
 
-    int   quiet_width = C128_QUIET_WIDTH * props->bar_width;
-    float ps_x        = quiet_width;
+    unsigned int acc   = 0;
+    int          bits  = 0;
+    int          bytes = 0;
 
+    *width = 0;
     for (int i = 0; i < code->datalen; i++) {
-        pattern pat = code->data[i];
+        pattern pat;
+        int     pat_width;
+        if (i + 1 != code->datalen) {
+            pat       = C128_FULL_PATTERN(code->data[i]);
+            pat_width = C128_DATA_WIDTH;
+        } else {
+            pat       = code->data[i];
+            pat_width = C128_STOP_WIDTH;
+        }
+
+        acc = (acc << pat_width) | pat;
+        bits += pat_width;
+        *width += pat_width;
+        while (bits >= 8) {
+            bits -= 8;
+            dest[bytes++] = (acc >> bits) & 0xFF;
+        }
+    }
+    if (bits > 0) {
+        dest[bytes] = (acc << (8 - bits)) & 0xFF;
+    }
+    return SUCCESS;
+}
 
-        char bar[PS_CMD_BUFSIZE];
-        memset(&bar, 0, PS_CMD_BUFSIZE);
+int c128_ps_image(Code128 * code, micro * ps_x, Cursor * dest, const PSProperties * props) {
+    static const char hex[] = "0123456789ABCDEF";
 
-        if (i + 1 != code->datalen) {
-            c128_ps_rect_black(&bar);
-            strncat(*dest, bar, PS_CMD_BUFSIZE);
-            ps_x += props->bar_width;
+    uchar modules[C128_MAX_MODULE_BYTES];
+    int   width;
+    int   status = c128_modules(code, modules, &width);
+    if (SUCCESS != status) {
+        return status;
+    }
 
-            c128_pat2ps(pat, C128_DATA_WIDTH - 2, &ps_x, dest, props);
+    // <, two hex digits per byte
+    char data[1 + 2 * C128_MAX_MODULE_BYTES];
+    int  len    = 0;
+    data[len++] = '<';
+    for (int i = 0; i < CEILDIV(width, 8); i++) {
+        data[len++] = hex[modules[i] >> 4];
+        data[len++] = hex[modules[i] & 0xF];
+    }
+    cursor_write(dest, data, len);
 
-            memset(&bar, 0, PS_CMD_BUFSIZE);
-            c128_ps_rect_white(1, &bar);
-            strncat(*dest, bar, PS_CMD_BUFSIZE);
-            ps_x += props->bar_width;
-        } else {
-            c128_pat2ps(pat, C128_STOP_WIDTH, &ps_x, dest, props);
+    *ps_x += width * TO_MICRO(props->bar_width);
+    cursor_write(dest, PS_IMAGE, strlen(PS_IMAGE));
+    cursor_int(dest, width);
+    return cursor_write(dest, PS_IMAGE_SUFFIX, strlen(PS_IMAGE_SUFFIX));
+}
+
+/**
+ *      @detail Skips a quiet zone with the command of the bar mode in use.
+ */
+int c128_ps_quiet_zone(Cursor * dest, const PSProperties * props) {
+    if (PS_MODE_MODULE == props->mode) {
+        return c128_ps_rect_white(C128_QUIET_WIDTH, dest);
+    }
+    cursor_int(dest, C128_QUIET_WIDTH);
+    return cursor_write(dest, PS_RUN_SPACE, strlen(PS_RUN_SPACE));
+}
+
+/**
+ *      @detail All Code 128 patterns are preceded by a black bar and followed by a white bar, which
+ *              are removed from the internal representation and added here, except for the stop
+ *              pattern, which is stored in full.
+ */
+int c128_ps_symbol(pattern              pat,
+                   bool                 stop,
+                   micro *              ps_x,
+                   Cursor *             dest,
+                   const PSProperties * props) {
+    if (PS_MODE_RUNLENGTH == props->mode) {
+        // The leading black and trailing white bars are drawn as part of the pattern's runs
+        if (!stop) {
+            return c128_pat2ps_rl(C128_FULL_PATTERN(pat), C128_DATA_WIDTH, ps_x, dest, props);
         }
+        return c128_pat2ps_rl(pat, C128_STOP_WIDTH, ps_x, dest, props);
     }
 
-    ps_x += props->bar_width;
-    strncat(*dest, quiet_zone, PS_CMD_BUFSIZE);
+    if (!stop) {
+        micro bar_width = TO_MICRO(props->bar_width);
+
+        c128_ps_rect_black(dest);
+        *ps_x += bar_width;
+
+        c128_pat2ps(pat, C128_DATA_WIDTH - 2, ps_x, dest, props);
+
+        c128_ps_rect_white(1, dest);
+        *ps_x += bar_width;
+        return SUCCESS;
+    }
+    return c128_pat2ps(pat, C128_STOP_WIDTH, ps_x, dest, props);
+}
+
+/**
+ *      @detail This function is used internally, so you're probably looking for c128_ps_layout()
+ *      @see c128_ps_layout()
+ */
+static int ps_write(Code128 * code, Cursor * dest, const PSProperties * props) {
+    c128_ps_quiet_zone(dest, props);
+
+    micro quiet_width = C128_QUIET_WIDTH * TO_MICRO(props->bar_width);
+    micro ps_x        = quiet_width;
+
+    if (PS_MODE_IMAGE == props->mode) {
+        c128_ps_image(code, &ps_x, dest, props);
+    } else {
+        for (int i = 0; i < code->datalen; i++) {
+            c128_ps_symbol(code->data[i], i + 1 == code->datalen, &ps_x, dest, props);
+        }
+    }
+
+    c128_ps_quiet_zone(dest, props);
     ps_x += quiet_width;
 
-    char * text;
-    c128_strrepr(code->text, code->textlen, &text);
+    c128_ps_text(code->text, code->textlen, props->fontsize, ps_x / 2, dest);
+
+    return SUCCESS;
+}
 
-    char ps_text[PS_TEXT_BUFSIZE];
-    c128_ps_text(text, props->fontsize, ps_x / 2, &ps_text);
+int c128_ps(Code128 * code, Cursor * dest, const PSProperties * props) {
+    STAGE_START(timer, dest->pos);
+    int status = ps_write(code, dest, props);
+    STAGE_STOP(timer, STAGE_PS, dest->pos, status);
+    return status;
+}
 
-    strncat(*dest, ps_text, PS_TEXT_BUFSIZE);
+/**
+ *      @detail Positions are relative to the previous cell, so the first cell of a page needs no
+ *              commands. Moving to a new row resets x; moving to a new column sets it absolutely.
+ */
+int c128_ps_cell_position(int cell, Cursor * dest, const PSProperties * props, Layout * layout) {
+    if (cell <= 0) {
+        return SUCCESS;
+    }
 
-    free(text);
+    int row = cell / layout->cols;
+    int col = cell % layout->cols;
 
+    if (row != (cell - 1) / (int) layout->cols) {
+        cursor_int(dest, 0);
+        cursor_write(dest, PS_RPOS_INFIX, strlen(PS_RPOS_INFIX));
+        cursor_micro(dest, TO_MICRO(props->bar_height) + (micro) props->fontsize * MICRO_PER_UNIT);
+        cursor_write(dest, PS_RPOS_SUFFIX, strlen(PS_RPOS_SUFFIX));
+        cursor_write(dest, PS_PADY, strlen(PS_PADY));
+        cursor_write(dest, PS_RESET_X, strlen(PS_RESET_X));
+    }
+    if (col != (cell - 1) % (int) layout->cols) {
+        cursor_write(dest, PS_COL_POS, strlen(PS_COL_POS));
+        cursor_micro(dest, TO_MICRO(props->column_width));
+        cursor_write(dest, PS_COL_POS_INFIX, strlen(PS_COL_POS_INFIX));
+        cursor_int(dest, col);
+        cursor_write(dest, PS_COL_POS_SUFFIX, strlen(PS_COL_POS_SUFFIX));
+        cursor_write(dest, PS_PADX, strlen(PS_PADX));
+    }
     return SUCCESS;
 }
 
+/**
+ *      @detail Lays out up to a page of barcodes from the current position, moving to the next row
+ *              or column between barcodes.
+ */
+static void ps_cells(Code128 **           codes,
+                     int                  num_codes,
+                     Cursor *             dest,
+                     const PSProperties * props,
+                     Layout *             layout,
+                     const RenderCache *  cache) {
+    for (int i = 0; i < num_codes; i++) {
+        c128_ps_cell_position(i, dest, props, layout);
+
+        if (NULL != cache) {
+            c128_ps_cached(codes[i], dest, cache);
+        } else {
+            ps_write(codes[i], dest, props);
+        }
+    }
+}
+
+/**
+ *      @detail Builds a render cache for a document if it has enough barcodes for the cache to pay
+ *              for itself, returning NULL otherwise.
+ */
+static RenderCache * ps_document_cache(int num_codes, const PSProperties * props) {
+    if (num_codes < PS_CACHE_MIN_CODES || PS_MODE_IMAGE == props->mode) {
+        return NULL;
+    }
+
+    RenderCache * cache = barcode_malloc(sizeof *cache);
+    VERIFY_NULL(cache, sizeof *cache);
+    c128_cache_init(cache, props);
+    return cache;
+}
+
+static void ps_document_cache_free(RenderCache * cache) {
+    if (NULL != cache) {
+        c128_cache_free(cache);
+        barcode_free(cache);
+    }
+}
+
+static int ps_layout_write(Code128 **           codes,
+                           int                  num_codes,
+                           Cursor *             dest,
+                           const PSProperties * props,
+                           Layout *             layout,
+                           const RenderCache *  cache) {
+    unsigned int max_codes = layout->cols * layout->rows;
+    if ((unsigned int) num_codes > max_codes || max_codes == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    c128_ps_header(dest, props);
+    ps_cells(codes, num_codes, dest, props, layout, cache);
+    return c128_ps_footer(dest);
+}
+
+static int ps_layout_document(Code128 **           codes,
+                              int                  num_codes,
+                              Cursor *             dest,
+                              const PSProperties * props,
+                              Layout *             layout) {
+    RenderCache * cache  = ps_document_cache(num_codes, props);
+    int           status = ps_layout_write(codes, num_codes, dest, props, layout, cache);
+    ps_document_cache_free(cache);
+    return status;
+}
+
+int c128_ps_layout_write(Code128 **           codes,
+                         int                  num_codes,
+                         Cursor *             dest,
+                         const PSProperties * props,
+                         Layout *             layout) {
+    STAGE_START(timer, dest->pos);
+    int status = ps_layout_document(codes, num_codes, dest, props, layout);
+    STAGE_STOP(timer, STAGE_PS_LAYOUT, dest->pos, status);
+    return status;
+}
+
+/**
+ *      @detail As with c128_svg_size(), the document is rendered to a NULL cursor to measure it.
+ */
+int c128_ps_layout_size(Code128 **           codes,
+                        int                  num_codes,
+                        const PSProperties * props,
+                        Layout *             layout,
+                        size_t *             size) {
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+
+    int status = ps_layout_document(codes, num_codes, &measure, props, layout);
+    *size      = measure.pos;
+    return status;
+}
+
+/**
+ *      @detail The document is measured with c128_ps_layout_size() before being rendered, so
+ *              exactly as much memory as is written (plus a null terminator) is allocated.
+ */
 int c128_ps_layout(Code128 **           codes,
                    int                  num_codes,
                    char **              dest,
                    const PSProperties * props,
                    Layout *             layout) {
+    STAGE_START(timer, 0);
+    RenderCache * cache = ps_document_cache(num_codes, props);
+
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+    int status = ps_layout_write(codes, num_codes, &measure, props, layout, cache);
+
+    if (SUCCESS == status) {
+        Cursor cursor;
+        c128_ps_init(&cursor, measure.pos);
+        status = ps_layout_write(codes, num_codes, &cursor, props, layout, cache);
+        *dest  = cursor_str(&cursor);
+    }
+
+    ps_document_cache_free(cache);
+    STAGE_STOP(timer, STAGE_PS_LAYOUT, SUCCESS == status ? measure.pos : 0, status);
+    return status;
+}
+
+int c128_ps_layout_stream(Code128 **           codes,
+                          int                  num_codes,
+                          const Sink *         sink,
+                          const PSProperties * props,
+                          Layout *             layout) {
+    char   buf[CURSOR_SINK_BUFSIZE];
+    Cursor cursor;
+    cursor_init_sink(&cursor, buf, sizeof buf, sink);
+
+    return stream_end(&cursor, c128_ps_layout_write(codes, num_codes, &cursor, props, layout));
+}
+
+int c128_ps_dsc_header(Cursor * dest, const PSProperties * props, int pages) {
+    cursor_printf(dest, PS_DSC_HEADER, pages);
+    ps_prolog(dest, props);
+    return cursor_write(dest, PS_DSC_END_PROLOG, strlen(PS_DSC_END_PROLOG));
+}
+
+int c128_ps_page(Code128 **           codes,
+                 int                  num_codes,
+                 int                  page,
+                 Cursor *             dest,
+                 const PSProperties * props,
+                 Layout *             layout) {
     unsigned int max_codes = layout->cols * layout->rows;
     if ((unsigned int) num_codes > max_codes || max_codes == 0) {
         return ERR_INVALID_LAYOUT;
     }
 
-    c128_ps_init(dest, num_codes);
-    c128_ps_header(dest, props);
+    cursor_printf(dest, PS_DSC_PAGE, page, page);
+    ps_cells(codes, num_codes, dest, props, layout, NULL);
+    return cursor_write(dest, PS_DSC_PAGE_END, strlen(PS_DSC_PAGE_END));
+}
 
-    int row, col, lrow = -1, lcol = -1;
-    for (int i = 0; i < num_codes; i++) {
-        row = i / layout->cols;
-        col = i % layout->cols;
-
-        if (lrow != -1 && row != lrow) {
-            char rpos[PS_CMD_BUFSIZE];
-            snprintf(rpos, PS_CMD_BUFSIZE, PS_RPOS, 0.0, props->bar_height + props->fontsize);
-            strncat(*dest, rpos, PS_CMD_BUFSIZE);
-            strncat(*dest, PS_PADY, PS_CMD_BUFSIZE);
-            strncat(*dest, PS_RESET_X, PS_CMD_BUFSIZE);
+int c128_ps_page_cached(Code128 **          codes,
+                        int                 num_codes,
+                        int                 page,
+                        Cursor *            dest,
+                        const RenderCache * cache,
+                        Layout *            layout) {
+    unsigned int max_codes = layout->cols * layout->rows;
+    if ((unsigned int) num_codes > max_codes || max_codes == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    cursor_printf(dest, PS_DSC_PAGE, page, page);
+    ps_cells(codes, num_codes, dest, &cache->props, layout, cache);
+    return cursor_write(dest, PS_DSC_PAGE_END, strlen(PS_DSC_PAGE_END));
+}
+
+int c128_ps_cells(Code128 **           codes,
+                  int                  num_codes,
+                  Cursor *             dest,
+                  const PSProperties * props,
+                  Layout *             layout,
+                  const RenderCache *  cache) {
+    unsigned int max_codes = layout->cols * layout->rows;
+    if ((unsigned int) num_codes > max_codes || max_codes == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    ps_cells(codes, num_codes, dest, props, layout, cache);
+    return SUCCESS;
+}
+
+int c128_ps_dsc_trailer(Cursor * dest) {
+    return cursor_write(dest, PS_DSC_TRAILER, strlen(PS_DSC_TRAILER));
+}
+
+int c128_ps_num_pages(int num_codes, Layout * layout) {
+    int per_page = layout->cols * layout->rows;
+    if (per_page == 0) {
+        return 0;
+    }
+    return CEILDIV(num_codes, per_page);
+}
+
+static int ps_paginate_write(Code128 **           codes,
+                             int                  num_codes,
+                             Cursor *             dest,
+                             const PSProperties * props,
+                             Layout *             layout,
+                             const RenderCache *  cache) {
+    int per_page = layout->cols * layout->rows;
+    if (per_page == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    int pages = c128_ps_num_pages(num_codes, layout);
+    c128_ps_dsc_header(dest, props, pages);
+
+    for (int page = 0; page < pages; page++) {
+        int first = page * per_page;
+        int count = num_codes - first < per_page ? num_codes - first : per_page;
+        if (NULL != cache) {
+            c128_ps_page_cached(codes + first, count, page + 1, dest, cache, layout);
+        } else {
+            c128_ps_page(codes + first, count, page + 1, dest, props, layout);
         }
-        if (lcol != -1 && col != lcol) {
-            char col_pos[PS_CMD_BUFSIZE];
-            snprintf(col_pos, PS_CMD_BUFSIZE, PS_COL_POS, props->column_width, col);
-            strncat(*dest, col_pos, PS_CMD_BUFSIZE);
-            strncat(*dest, PS_PADX, PS_CMD_BUFSIZE);
-            // strncat(*dest, PS_RESET_Y, PS_CMD_BUFSIZE);
+    }
+
+    return c128_ps_dsc_trailer(dest);
+}
+
+int c128_ps_paginate_write(Code128 **           codes,
+                           int                  num_codes,
+                           Cursor *             dest,
+                           const PSProperties * props,
+                           Layout *             layout) {
+    RenderCache * cache  = ps_document_cache(num_codes, props);
+    int           status = ps_paginate_write(codes, num_codes, dest, props, layout, cache);
+    ps_document_cache_free(cache);
+    return status;
+}
+
+int c128_ps_paginate_size(Code128 **           codes,
+                          int                  num_codes,
+                          const PSProperties * props,
+                          Layout *             layout,
+                          size_t *             size) {
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+
+    int status = c128_ps_paginate_write(codes, num_codes, &measure, props, layout);
+    *size      = measure.pos;
+    return status;
+}
+
+int c128_ps_paginate(Code128 **           codes,
+                     int                  num_codes,
+                     char **              dest,
+                     const PSProperties * props,
+                     Layout *             layout) {
+    RenderCache * cache = ps_document_cache(num_codes, props);
+
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+    int status = ps_paginate_write(codes, num_codes, &measure, props, layout, cache);
+
+    if (SUCCESS == status) {
+        Cursor cursor;
+        c128_ps_init(&cursor, measure.pos);
+        status = ps_paginate_write(codes, num_codes, &cursor, props, layout, cache);
+        *dest  = cursor_str(&cursor);
+    }
+
+    ps_document_cache_free(cache);
+    return status;
+}
+
+int c128_ps_paginate_stream(Code128 **           codes,
+                            int                  num_codes,
+                            const Sink *         sink,
+                            const PSProperties * props,
+                            Layout *             layout) {
+    char   buf[CURSOR_SINK_BUFSIZE];
+    Cursor cursor;
+    cursor_init_sink(&cursor, buf, sizeof buf, sink);
+
+    return stream_end(&cursor, c128_ps_paginate_write(codes, num_codes, &cursor, props, layout));
+}
+
+/*      @brief Widths of the printable ASCII characters in Helvetica, in thousandths of an em */
+static const short HELVETICA_WIDTHS[] = {
+    278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278, 556, 556, 556,
+    556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556, 1015, 667, 667, 722, 722, 667,
+    611, 778, 722, 278, 500, 667, 556, 833, 722, 778, 667, 778, 722, 667, 611, 722, 667, 944, 667,
+    667, 611, 278, 278, 278, 469, 556, 333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500,
+    222, 833, 556, 556, 556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584};
+
+typedef struct PdfDocument PdfDocument;
+
+/**
+ *      @detail Lengths are converted to micro-points once, as PDF has no units other than points.
+ *              Barcodes are looked up by content in an open-addressed hash table of the index of
+ *              the first barcode with that content, so each distinct barcode is drawn once as a
+ *              form and every other occurrence only places it.
+ */
+struct PdfDocument {
+    Code128 **           codes;      /**< Every barcode in the document */
+    Cursor *             dest;
+    const PSProperties * props;
+    Layout *             layout;
+    micro                left;       /**< Left margin in micro-points */
+    micro                bottom;     /**< Bottom margin in micro-points */
+    micro                bar_width;  /**< Width of a module in micro-points */
+    micro                bar_height; /**< Height of a barcode in micro-points */
+    micro                padding;    /**< Padding between barcodes in micro-points */
+    micro                col_pitch;  /**< Distance between the left edges of adjacent columns */
+    micro                row_pitch;  /**< Distance between the bottom edges of adjacent rows */
+    size_t *             offsets;    /**< Offset of each object by number, for the xref table */
+    int                  num_objs;   /**< Number of the next object, counting object 0 */
+    int *                slots;      /**< Indices of barcodes by the hash of their content, or -1 */
+    int                  num_slots;  /**< Size of @c slots, a power of two */
+    int *                forms;      /**< Number of the form drawing each barcode, or 0 */
+    int *                pages;      /**< Number of the object of each page */
+};
+
+double ps_unit_points(const char * units) {
+    if (0 == strcmp(units, "in")) {
+        return 72;
+    }
+    if (0 == strcmp(units, "mm")) {
+        return 72 / 25.4;
+    }
+    if (0 == strcmp(units, "cm")) {
+        return 72 / 2.54;
+    }
+    return 1;
+}
+
+static int pdf_char_width(char c) {
+    return ' ' <= c && c <= '~' ? HELVETICA_WIDTHS[c - ' '] : PDF_DEFAULT_CHAR_WIDTH;
+}
+
+/**
+ *      @detail PDF has no equivalent of @c stringwidth, so the width of the text as written by
+ *              c128_text_escaped() is summed from the font metrics to centre it.
+ */
+static micro pdf_text_width(const Code128 * code, unsigned int fontsize) {
+    micro width = 0;
+    for (int i = 0; i < code->textlen; i++) {
+        char c = (char) code->text[i];
+        if (!IS_CTRL(c)) {
+            width += pdf_char_width(c);
+            continue;
         }
 
-        c128_ps((codes)[i], dest, props);
+        const char * ctrl = DEL == c ? DEL_STRREPR : ctrl_strrepr[(int) c];
+        for (int j = 0; j < CTRL_STR_SIZE && '\0' != ctrl[j]; j++) {
+            width += pdf_char_width(ctrl[j]);
+        }
+    }
+    return width * fontsize * (MICRO_PER_UNIT / 1000);
+}
 
-        lrow = row;
-        lcol = col;
+static unsigned int pdf_code_hash(const Code128 * code) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < code->datalen; i++) {
+        hash = (hash ^ code->data[i]) * 16777619u;
+    }
+    for (int i = 0; i < code->textlen; i++) {
+        hash = (hash ^ code->text[i]) * 16777619u;
     }
+    return hash;
+}
+
+static bool pdf_code_equal(const Code128 * a, const Code128 * b) {
+    return a->datalen == b->datalen && a->textlen == b->textlen &&
+           0 == memcmp(a->data, b->data, a->datalen * sizeof *a->data) &&
+           0 == memcmp(a->text, b->text, a->textlen);
+}
+
+/**
+ *      @brief Returns the index of the first barcode with the same content as barcode @p index,
+ *             which is @p index itself if there was none before it.
+ */
+static int pdf_find_code(PdfDocument * doc, int index) {
+    unsigned int slot = pdf_code_hash(doc->codes[index]) & (doc->num_slots - 1);
+    while (-1 != doc->slots[slot]) {
+        if (pdf_code_equal(doc->codes[doc->slots[slot]], doc->codes[index])) {
+            return doc->slots[slot];
+        }
+        slot = (slot + 1) & (doc->num_slots - 1);
+    }
+    doc->slots[slot] = index;
+    return index;
+}
+
+static int pdf_init(PdfDocument *        doc,
+                    Code128 **           codes,
+                    int                  num_codes,
+                    Cursor *             dest,
+                    const PSProperties * props,
+                    Layout *             layout) {
+    double scale = ps_unit_points(props->units);
+    int    pages = c128_ps_num_pages(num_codes, layout);
 
-    c128_ps_footer(dest);
+    doc->codes      = codes;
+    doc->dest       = dest;
+    doc->props      = props;
+    doc->layout     = layout;
+    doc->left       = TO_MICRO(props->lmargin * scale);
+    doc->bottom     = TO_MICRO(props->bmargin * scale);
+    doc->bar_width  = TO_MICRO(props->bar_width * scale);
+    doc->bar_height = TO_MICRO(props->bar_height * scale);
+    doc->padding    = TO_MICRO(props->padding * scale);
+    doc->col_pitch  = TO_MICRO(props->column_width * scale) + doc->padding;
+    doc->row_pitch  = TO_MICRO((props->bar_height + props->fontsize) * scale) + doc->padding;
+    doc->num_objs   = PDF_FIRST_OBJ;
 
+    doc->num_slots = 16;
+    while (doc->num_slots < 2 * num_codes) {
+        doc->num_slots *= 2;
+    }
+
+    size_t offsets_size = (PDF_FIRST_OBJ + num_codes + 2 * pages) * sizeof(*doc->offsets);
+    size_t slots_size   = doc->num_slots * sizeof(*doc->slots);
+    size_t forms_size   = (num_codes + 1) * sizeof(*doc->forms);
+    size_t pages_size   = (pages + 1) * sizeof(*doc->pages);
+    doc->offsets        = barcode_malloc(offsets_size);
+    VERIFY_NULL(doc->offsets, offsets_size);
+    doc->slots = barcode_malloc(slots_size);
+    VERIFY_NULL(doc->slots, slots_size);
+    doc->forms = barcode_calloc(1, forms_size);
+    VERIFY_NULL(doc->forms, forms_size);
+    doc->pages = barcode_malloc(pages_size);
+    VERIFY_NULL(doc->pages, pages_size);
+
+    memset(doc->slots, -1, slots_size);
     return SUCCESS;
 }
+
+static void pdf_free(PdfDocument * doc) {
+    barcode_free(doc->offsets);
+    barcode_free(doc->slots);
+    barcode_free(doc->forms);
+    barcode_free(doc->pages);
+}
+
+/**
+ *      @brief Begins an object, recording its offset for the cross-reference table.
+ */
+static int pdf_object(PdfDocument * doc, int num) {
+    doc->offsets[num] = doc->dest->pos;
+    return cursor_printf(doc->dest, PDF_OBJ, num);
+}
+
+/**
+ *      @brief Draws the bars of a barcode as one rectangle per bar, in modules scaled to size
+ */
+static void pdf_bars(const uchar * modules, int width, Cursor * dest, const PdfDocument * doc) {
+    char bar_w[FMT_BUFSIZE + 1];
+    char bar_h[FMT_BUFSIZE + 1];
+    bar_w[fmt_micro(bar_w, doc->bar_width)]  = '\0';
+    bar_h[fmt_micro(bar_h, doc->bar_height)] = '\0';
+    cursor_printf(dest, PDF_BARS_SCALE, bar_w, bar_h);
+
+    int i = 0;
+    while (i < width) {
+        if (((modules[i / 8] >> (7 - i % 8)) & 1) != Black) {
+            i++;
+            continue;
+        }
+
+        int run = 0;
+        while (i + run < width && ((modules[(i + run) / 8] >> (7 - (i + run) % 8)) & 1) == Black) {
+            run++;
+        }
+        cursor_int(dest, C128_QUIET_WIDTH + i);
+        cursor_printf(dest, PDF_BAR_SUFFIX, run);
+        i += run;
+    }
+    cursor_write(dest, PDF_BARS_END, strlen(PDF_BARS_END));
+}
+
+/**
+ *      @brief Draws the bars of a barcode as an inline image mask for PS_MODE_IMAGE
+ */
+static void pdf_image(const uchar * modules, int width, Cursor * dest, const PdfDocument * doc) {
+    static const char hex[] = "0123456789ABCDEF";
+
+    char image_w[FMT_BUFSIZE + 1];
+    char image_h[FMT_BUFSIZE + 1];
+    char quiet_w[FMT_BUFSIZE + 1];
+    image_w[fmt_micro(image_w, width * doc->bar_width)]            = '\0';
+    image_h[fmt_micro(image_h, doc->bar_height)]                   = '\0';
+    quiet_w[fmt_micro(quiet_w, C128_QUIET_WIDTH * doc->bar_width)] = '\0';
+    cursor_printf(dest, PDF_IMAGE, image_w, image_h, quiet_w, width);
+
+    char data[2 * C128_MAX_MODULE_BYTES];
+    int  len = 0;
+    for (int i = 0; i < CEILDIV(width, 8); i++) {
+        data[len++] = hex[modules[i] >> 4];
+        data[len++] = hex[modules[i] & 0xF];
+    }
+    cursor_write(dest, data, len);
+    cursor_write(dest, PDF_IMAGE_END, strlen(PDF_IMAGE_END));
+}
+
+/**
+ *      @detail The form's origin is the bottom left of the leading quiet zone, as with the current
+ *              point of c128_ps(), and the text is centred on the barcode PAD below it.
+ */
+static void pdf_form_content(Code128 * code, Cursor * dest, const PdfDocument * doc) {
+    uchar modules[C128_MAX_MODULE_BYTES];
+    int   width;
+    c128_modules(code, modules, &width);
+
+    if (PS_MODE_IMAGE == doc->props->mode) {
+        pdf_image(modules, width, dest, doc);
+    } else {
+        pdf_bars(modules, width, dest, doc);
+    }
+
+    micro total = (width + 2 * C128_QUIET_WIDTH) * doc->bar_width;
+    char  text_x[FMT_BUFSIZE + 1];
+    char  text_y[FMT_BUFSIZE + 1];
+    text_x[fmt_micro(text_x, (total - pdf_text_width(code, doc->props->fontsize)) / 2)] = '\0';
+    text_y[fmt_micro(text_y, -doc->padding)]                                           = '\0';
+
+    cursor_printf(dest, PDF_TEXT, doc->props->fontsize, text_x, text_y);
+    c128_text_escaped(code->text, code->textlen, TEXT_ESCAPE_PS, dest);
+    cursor_write(dest, PDF_TEXT_SUFFIX, strlen(PDF_TEXT_SUFFIX));
+}
+
+/**
+ *      @detail Stream lengths must precede their data, so the content is measured with a NULL
+ *              cursor first. The bounding box takes in the text below the barcode, and either side
+ *              of it should the text be wider than the barcode.
+ */
+static int pdf_form(Code128 * code, int num, PdfDocument * doc) {
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+    pdf_form_content(code, &measure, doc);
+
+    micro total   = (code->datalen * C128_DATA_WIDTH + 2 + 2 * C128_QUIET_WIDTH) * doc->bar_width;
+    micro text_w  = pdf_text_width(code, doc->props->fontsize);
+    micro text_x  = (total - text_w) / 2;
+    micro box[4]  = {text_x < 0 ? text_x : 0,
+                     -doc->padding - (micro) doc->props->fontsize * MICRO_PER_UNIT,
+                     text_x < 0 ? text_x + text_w : total,
+                     doc->bar_height};
+    Cursor * dest = doc->dest;
+
+    pdf_object(doc, num);
+    cursor_write(dest, PDF_FORM, strlen(PDF_FORM));
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+            cursor_write(dest, " ", 1);
+        }
+        cursor_micro(dest, box[i]);
+    }
+    cursor_write(dest, PDF_FORM_LENGTH, strlen(PDF_FORM_LENGTH));
+    cursor_int(dest, measure.pos);
+    cursor_write(dest, PDF_STREAM_BEGIN, strlen(PDF_STREAM_BEGIN));
+    pdf_form_content(code, dest, doc);
+    cursor_write(dest, PDF_STREAM_END, strlen(PDF_STREAM_END));
+    return cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+}
+
+/**
+ *      @detail Rows are laid out upwards from the bottom margin and columns rightwards from the
+ *              left margin, as in c128_ps_page(), with every barcode placed by its form.
+ */
+static void pdf_page_content(int first, int num_codes, Cursor * dest, const PdfDocument * doc) {
+    const int * forms = doc->forms + first;
+    for (int i = 0; i < num_codes; i++) {
+        int row = i / doc->layout->cols;
+        int col = i % doc->layout->cols;
+
+        cursor_write(dest, PDF_PLACE, strlen(PDF_PLACE));
+        cursor_micro(dest, doc->left + col * doc->col_pitch);
+        cursor_write(dest, " ", 1);
+        cursor_micro(dest, doc->bottom + doc->padding + row * doc->row_pitch);
+        cursor_printf(dest, PDF_PLACE_SUFFIX, forms[i]);
+    }
+}
+
+/**
+ *      @detail The forms of any barcodes not seen on an earlier page are written first, as objects
+ *              cannot be nested, followed by the page's content stream and the page itself.
+ */
+static int pdf_page(int first, int num_codes, int page, PdfDocument * doc) {
+    for (int i = first; i < first + num_codes; i++) {
+        int same = pdf_find_code(doc, i);
+        if (same != i) {
+            doc->forms[i] = doc->forms[same];
+            continue;
+        }
+        doc->forms[i] = doc->num_objs++;
+        pdf_form(doc->codes[i], doc->forms[i], doc);
+    }
+
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+    pdf_page_content(first, num_codes, &measure, doc);
+
+    Cursor * dest     = doc->dest;
+    int      contents = doc->num_objs++;
+    pdf_object(doc, contents);
+    cursor_write(dest, PDF_STREAM, strlen(PDF_STREAM));
+    cursor_int(dest, measure.pos);
+    cursor_write(dest, PDF_STREAM_BEGIN, strlen(PDF_STREAM_BEGIN));
+    pdf_page_content(first, num_codes, dest, doc);
+    cursor_write(dest, PDF_STREAM_END, strlen(PDF_STREAM_END));
+    cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+
+    doc->pages[page] = doc->num_objs++;
+    pdf_object(doc, doc->pages[page]);
+    cursor_printf(dest, PDF_PAGE, contents);
+    return cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+}
+
+/**
+ *      @detail The page tree and the resources shared by every page are referred to before they
+ *              are written, so they follow the last page, once all of their entries are known. The
+ *              page size fits the layout and its margins exactly.
+ */
+static int pdf_trailer(int num_codes, int pages, PdfDocument * doc) {
+    Cursor * dest   = doc->dest;
+    double   scale  = ps_unit_points(doc->props->units);
+    micro    width  = doc->left + doc->layout->cols * doc->col_pitch - doc->padding +
+                   TO_MICRO(doc->props->rmargin * scale);
+    micro    height = doc->bottom + doc->padding + (doc->layout->rows - 1) * doc->row_pitch +
+                    doc->bar_height + TO_MICRO(doc->props->tmargin * scale);
+    char     page_w[FMT_BUFSIZE + 1];
+    char     page_h[FMT_BUFSIZE + 1];
+    page_w[fmt_micro(page_w, width)]  = '\0';
+    page_h[fmt_micro(page_h, height)] = '\0';
+
+    pdf_object(doc, PDF_PAGES_OBJ);
+    cursor_printf(dest, PDF_PAGES, pages, page_w, page_h);
+    for (int i = 0; i < pages; i++) {
+        cursor_printf(dest, i > 0 ? " %d 0 R" : "%d 0 R", doc->pages[i]);
+    }
+    cursor_write(dest, PDF_PAGES_END, strlen(PDF_PAGES_END));
+    cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+
+    // Forms are numbered in the order their barcodes first appear, so a form is new exactly when
+    // its number is higher than any before it
+    pdf_object(doc, PDF_RESOURCES_OBJ);
+    cursor_write(dest, PDF_RESOURCES, strlen(PDF_RESOURCES));
+    for (int i = 0, last = 0; i < num_codes; i++) {
+        if (doc->forms[i] > last) {
+            last = doc->forms[i];
+            cursor_printf(dest, " /X%d %d 0 R", last, last);
+        }
+    }
+    cursor_write(dest, PDF_RESOURCES_END, strlen(PDF_RESOURCES_END));
+    cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+
+    size_t xref = dest->pos;
+    cursor_printf(dest, PDF_XREF, doc->num_objs);
+    for (int i = 1; i < doc->num_objs; i++) {
+        cursor_printf(dest, PDF_XREF_ENTRY, doc->offsets[i]);
+    }
+    return cursor_printf(dest, PDF_TRAILER, doc->num_objs, xref);
+}
+
+int c128_pdf_write(Code128 **           codes,
+                   int                  num_codes,
+                   Cursor *             dest,
+                   const PSProperties * props,
+                   Layout *             layout) {
+    int per_page = layout->cols * layout->rows;
+    if (per_page == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    PdfDocument doc;
+    pdf_init(&doc, codes, num_codes, dest, props, layout);
+
+    cursor_write(dest, PDF_HEADER, strlen(PDF_HEADER));
+    pdf_object(&doc, PDF_CATALOG_OBJ);
+    cursor_write(dest, PDF_CATALOG, strlen(PDF_CATALOG));
+    cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+    pdf_object(&doc, PDF_FONT_OBJ);
+    cursor_write(dest, PDF_FONT, strlen(PDF_FONT));
+    cursor_write(dest, PDF_ENDOBJ, strlen(PDF_ENDOBJ));
+
+    int pages = c128_ps_num_pages(num_codes, layout);
+    for (int page = 0; page < pages; page++) {
+        int first = page * per_page;
+        int count = num_codes - first < per_page ? num_codes - first : per_page;
+        pdf_page(first, count, page, &doc);
+    }
+
+    int status = pdf_trailer(num_codes, pages, &doc);
+    pdf_free(&doc);
+    return status;
+}
+
+/**
+ *      @detail As with c128_ps_paginate_size(), the document is rendered to a NULL cursor.
+ */
+int c128_pdf_size(Code128 **           codes,
+                  int                  num_codes,
+                  const PSProperties * props,
+                  Layout *             layout,
+                  size_t *             size) {
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+
+    int status = c128_pdf_write(codes, num_codes, &measure, props, layout);
+    *size      = measure.pos;
+    return status;
+}
+
+int c128_pdf(Code128 **           codes,
+             int                  num_codes,
+             char **              dest,
+             const PSProperties * props,
+             Layout *             layout) {
+    size_t size;
+    int    status = c128_pdf_size(codes, num_codes, props, layout, &size);
+    if (SUCCESS != status) {
+        return status;
+    }
+
+    Cursor cursor;
+    cursor_alloc(&cursor, size);
+    status = c128_pdf_write(codes, num_codes, &cursor, props, layout);
+    *dest  = cursor_str(&cursor);
+    return status;
+}
+
+int c128_pdf_stream(Code128 **           codes,
+                    int                  num_codes,
+                    const Sink *         sink,
+                    const PSProperties * props,
+                    Layout *             layout) {
+    char   buf[CURSOR_SINK_BUFSIZE];
+    Cursor cursor;
+    cursor_init_sink(&cursor, buf, sizeof buf, sink);
+
+    return stream_end(&cursor, c128_pdf_write(codes, num_codes, &cursor, props, layout));
+}
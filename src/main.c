@@ -4,55 +4,662 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
-#include "barcode/errors.h"
-#include "barcode/graphic.h"
-#include "barcode/symb.h"
+/**
+ *      @file main.c
+ *      @brief The @c barcode command, which encodes and renders a file of records in bulk.
+ *      @detail Usage: <tt>barcode [-f format] [-d delimiter] [-k field] [-H] [-j threads]
+ *              [-o output] [-r rows] [-c columns] [-q] [input]</tt>
+ *
+ *              The input, or stdin if it is omitted or @c -, is memory-mapped and split into
+ *              records in place, one per line or, with <tt>-d csv</tt>, the @c -k th field of each
+ *              CSV row. Empty records are skipped. Records are encoded across @c -j threads and the
+ *              barcodes written in input order, to stdout or the file given by @c -o:
+ *
+ *              - @c svg (the default): one SVG per line. If the output path contains a @c %d
+ *                conversion, each SVG is instead written to its own file, numbered from 0.
+ *              - @c ps: a paged PostScript document, rendered on @c -j threads.
+ *              - @c pdf: a PDF document.
+ *              - @c zpl: ZPL labels, one per page.
+ *
+ *              Records that cannot be encoded are reported with their line number and left out of
+ *              the output. Throughput and error counts are printed to stderr at the end, along with
+ *              the counters of each stage if the library was built with instrumentation. The exit
+ *              status is 0 if every record was written, 1 if some could not be encoded and 2 if the
+ *              input or output failed.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
 
+#include "barcode.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define USAGE                                                                                      \
+    "usage: barcode [-f svg|ps|pdf|zpl] [-d lines|csv] [-k field] [-H] [-j threads] [-o output]\n" \
+    "               [-r rows] [-c columns] [-q] [input]\n"
+#define EXIT_RECORDS 1
+#define EXIT_ERROR 2
+/*      @brief Barcodes each thread renders to SVG before the output is written, in order */
+#define SVG_BATCH 1024
+/*      @brief Size of the buffer stdin is read into when it cannot be mapped, grown as needed */
+#define READ_BUFSIZE 65536
+#define DEFAULT_ROWS 9
+#define DEFAULT_COLS 2
+#define NS_PER_SEC 1000000000LL
+
+typedef enum OutputFormat { FORMAT_SVG, FORMAT_PS, FORMAT_PDF, FORMAT_ZPL } OutputFormat;
+
+/**
+ *      @brief A record of the input, pointing into the input itself.
+ */
+typedef struct InputRecord Record;
+
+/**
+ *      @brief The options given on the command line.
+ */
+typedef struct CommandOptions Options;
+
+/**
+ *      @brief The records encoded by one thread.
+ */
+typedef struct EncodeRange EncodeRange;
+
+/**
+ *      @brief The barcodes rendered to SVG by one thread in each batch.
+ */
+typedef struct SvgSlice SvgSlice;
+
+/**
+ *      @brief A sink counting the bytes passed through it to another.
+ */
+typedef struct CountingSink CountingSink;
+
+struct InputRecord {
+    const uchar * data;
+    int           len;
+    bool          escaped; /**< Whether @c data is a quoted CSV field containing doubled quotes */
+    long          line;    /**< The line the record starts on, from 1 */
+};
+
+struct CommandOptions {
+    OutputFormat format;
+    bool         csv;
+    int          field; /**< The CSV field encoded, from 1 */
+    bool         header;
+    int          threads;
+    const char * input;
+    const char * output;
+    Layout       layout;
+    bool         quiet;
+};
+
+struct EncodeRange {
+    const Record * records;
+    Code128 *      codes;
+    int *          status;
+    int            first;
+    int            last;
+};
+
+struct SvgSlice {
+    Code128 ** codes;
+    int        first;
+    int        last;
+    Cursor     out;
+};
+
+struct CountingSink {
+    Sink         sink;
+    const Sink * inner;
+    size_t       bytes;
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static int parse_format(const char * name, OutputFormat * format) {
+    static const char * names[] = {"svg", "ps", "pdf", "zpl"};
+    for (int i = 0; i < (int) (sizeof names / sizeof *names); i++) {
+        if (0 == strcmp(name, names[i])) {
+            *format = i;
+            return SUCCESS;
+        }
+    }
+    return ERR_ARGUMENT;
+}
+
+static int parse_positive(const char * arg, int * dest) {
+    char * end;
+    long   value = strtol(arg, &end, 10);
+    if (end == arg || '\0' != *end || value < 1 || value > 1 << 16) {
+        return ERR_ARGUMENT;
+    }
+    *dest = (int) value;
+    return SUCCESS;
+}
+
+static int parse_options(int argc, char ** argv, Options * opts) {
+    *opts = (Options){.format  = FORMAT_SVG,
+                      .field   = 1,
+                      .threads = 1,
+                      .layout  = {.rows = DEFAULT_ROWS, .cols = DEFAULT_COLS}};
+    int rows = DEFAULT_ROWS;
+    int cols = DEFAULT_COLS;
+    int opt;
+    int status = SUCCESS;
+    while (SUCCESS == status && -1 != (opt = getopt(argc, argv, "f:d:k:Hj:o:r:c:q"))) {
+        switch (opt) {
+            case 'f': status = parse_format(optarg, &opts->format); break;
+            case 'd':
+                opts->csv = 0 == strcmp(optarg, "csv");
+                status    = opts->csv || 0 == strcmp(optarg, "lines") ? SUCCESS : ERR_ARGUMENT;
+                break;
+            case 'k': status = parse_positive(optarg, &opts->field); break;
+            case 'H': opts->header = true; break;
+            case 'j': status = parse_positive(optarg, &opts->threads); break;
+            case 'o': opts->output = optarg; break;
+            case 'r': status = parse_positive(optarg, &rows); break;
+            case 'c': status = parse_positive(optarg, &cols); break;
+            case 'q': opts->quiet = true; break;
+            default: status = ERR_ARGUMENT; break;
+        }
+    }
+    if (optind + 1 < argc) {
+        status = ERR_ARGUMENT;
+    }
+    // An SVG output path with a conversion is used as a format, so it must take just the index
+    if (FORMAT_SVG == opts->format && NULL != opts->output && strchr(opts->output, '%') &&
+        !c128_export_path_valid(opts->output)) {
+        status = ERR_ARGUMENT;
+    }
+
+    opts->input  = optind < argc ? argv[optind] : "-";
+    opts->layout = (Layout){.rows = rows, .cols = cols};
+    return status;
+}
+
+/**
+ *      @detail Regular files are mapped, whether named or on stdin. Anything else, such as a pipe,
+ *              is read into a buffer, as it can only be read once.
+ */
+static int input_open(const char * path, uchar ** data, size_t * size, bool * mapped) {
+    int fd = 0 == strcmp(path, "-") ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        return ERR_IO;
+    }
+
+    struct stat st;
+    int         status = fstat(fd, &st) ? ERR_IO : SUCCESS;
+    *data              = NULL;
+    *size              = 0;
+    *mapped            = SUCCESS == status && S_ISREG(st.st_mode);
+
+    if (*mapped && st.st_size > 0) {
+        void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == map) {
+            status = ERR_IO;
+        } else {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            *data = map;
+            *size = st.st_size;
+        }
+    } else if (SUCCESS == status && !*mapped) {
+        size_t cap = 0;
+        for (;;) {
+            if (*size == cap) {
+                cap   = cap ? cap * 2 : READ_BUFSIZE;
+                *data = barcode_realloc(*data, cap);
+                VERIFY_NULL(*data, cap);
+            }
+            ssize_t n = read(fd, *data + *size, cap - *size);
+            if (n <= 0) {
+                status = n < 0 ? ERR_IO : SUCCESS;
+                break;
+            }
+            *size += n;
+        }
+    }
+
+    if (STDIN_FILENO != fd) {
+        close(fd);
+    }
+    return status;
+}
+
+static void input_close(uchar * data, size_t size, bool mapped) {
+    if (mapped && size > 0) {
+        munmap(data, size);
+    } else if (!mapped) {
+        barcode_free(data);
+    }
+}
+
+/**
+ *      @detail Records are kept in a growing array, which is the only memory the input costs
+ *              besides its mapping.
+ */
+static void add_record(Record ** records, int * count, int * cap, Record record) {
+    if (*count == *cap) {
+        *cap            = *cap ? *cap * 2 : READ_BUFSIZE;
+        size_t new_size = sizeof **records * *cap;
+        *records        = barcode_realloc(*records, new_size);
+        VERIFY_NULL(*records, new_size);
+    }
+    (*records)[(*count)++] = record;
+}
+
+/**
+ *      @detail A line's length excludes its newline and any carriage return before it.
+ */
+static int split_lines(const uchar * data, size_t size, Record ** records, int * cap) {
+    const uchar * end   = data + size;
+    int           count = 0;
+    long          line  = 1;
+    for (const uchar * p = data; p < end; line++) {
+        const uchar * eol  = memchr(p, '\n', end - p);
+        const uchar * next = eol ? eol + 1 : end;
+        eol                = eol ? eol : end;
+        size_t len         = eol > p && '\r' == eol[-1] ? eol - p - 1 : eol - p;
+
+        if (len > 0) {
+            add_record(records, &count, cap, (Record){p, (int) len, false, line});
+        }
+        p = next;
+    }
+    return count;
+}
+
+/**
+ *      @detail Fields are separated by commas and rows by newlines, except within double quotes,
+ *              where a quote is written twice. The quotes around a field are not part of it, and a
+ *              field containing doubled quotes is marked to be unescaped when it is encoded.
+ */
+static int split_csv(const uchar * data, size_t size, int field, Record ** records, int * cap) {
+    const uchar * end   = data + size;
+    const uchar * p     = data;
+    int           count = 0;
+    long          line  = 1;
+    while (p < end) {
+        long row_line = line;
+        for (int f = 1;; f++) {
+            const uchar * start   = p;
+            const uchar * stop    = p;
+            bool          escaped = false;
+            if (p < end && '"' == *p) {
+                start = ++p;
+                while (p < end && ('"' != *p || (p + 1 < end && '"' == p[1]))) {
+                    escaped |= '"' == *p;
+                    line += '\n' == *p;
+                    p += '"' == *p ? 2 : 1;
+                }
+                // Anything between the closing quote and the next separator is ignored
+                stop = p;
+                while (p < end && ',' != *p && '\n' != *p) {
+                    p++;
+                }
+            } else {
+                while (p < end && ',' != *p && '\n' != *p) {
+                    p++;
+                }
+                stop = p > start && '\r' == p[-1] ? p - 1 : p;
+            }
+
+            size_t len = stop - start;
+            if (f == field && len > 0) {
+                Record record = {start, (int) len, escaped, row_line};
+                add_record(records, &count, cap, record);
+            }
+            if (p >= end || '\n' == *p++) {
+                break;
+            }
+        }
+        line++;
+    }
+    return count;
+}
+
+/**
+ *      @detail Records are encoded straight from the input, except quoted CSV fields with doubled
+ *              quotes, which are unescaped into @c buf. A record is only too long once unescaped,
+ *              in which case its length is returned for the encoder to reject.
+ */
+static const uchar * record_data(const Record * record, uchar * buf, int * len) {
+    if (!record->escaped) {
+        *len = record->len;
+        return record->data;
+    }
+
+    int n = 0;
+    for (int i = 0; i < record->len; i++, n++) {
+        if (n < C128_MAX_DATA_LEN) {
+            buf[n] = record->data[i];
+        }
+        i += record->escaped && '"' == record->data[i];
+    }
+    if (n > C128_MAX_DATA_LEN) {
+        *len = n;
+        return record->data;
+    }
+    *len = n;
+    return buf;
+}
+
+static void * encode_range(void * arg) {
+    EncodeRange * range = arg;
+    for (int i = range->first; i < range->last; i++) {
+        uchar         buf[C128_MAX_DATA_LEN];
+        int           len;
+        const uchar * data = record_data(&range->records[i], buf, &len);
+        range->status[i]   = c128_encode_into((uchar *) data, len, &range->codes[i]);
+    }
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail The records are divided into one contiguous range per thread, the first of which is
+ *              encoded on the calling thread, as is any range whose thread cannot be started.
+ */
+static void encode_all(const Record * records,
+                       int            count,
+                       Code128 *      codes,
+                       int *          status,
+                       int            threads) {
+    EncodeRange * ranges  = barcode_calloc(threads, sizeof *ranges);
+    pthread_t *   workers = barcode_calloc(threads, sizeof *workers);
+    VERIFY_NULL(ranges, sizeof *ranges * threads);
+    VERIFY_NULL(workers, sizeof *workers * threads);
+
+    for (int i = 0; i < threads; i++) {
+        ranges[i] = (EncodeRange){records,
+                                  codes,
+                                  status,
+                                  (int) ((long long) count * i / threads),
+                                  (int) ((long long) count * (i + 1) / threads)};
+    }
+    bool * started = barcode_calloc(threads, sizeof *started);
+    VERIFY_NULL(started, sizeof *started * threads);
+    for (int i = 1; i < threads; i++) {
+        started[i] = 0 == pthread_create(&workers[i], NULL, encode_range, &ranges[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        if (!started[i]) {
+            encode_range(&ranges[i]);
+        }
+    }
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(workers[i], NULL);
+        }
+    }
+
+    barcode_free(ranges);
+    barcode_free(workers);
+    barcode_free(started);
+}
+
+/**
+ *      @detail Each SVG is appended to the slice's buffer, which is grown whenever an SVG does not
+ *              fit and that SVG rendered again.
+ */
+static void * render_slice(void * arg) {
+    SvgSlice * slice = arg;
+    Cursor *   out   = &slice->out;
+    out->pos         = 0;
+    for (int i = slice->first; i < slice->last; i++) {
+        size_t start = out->pos;
+        c128_svg_write(slice->codes[i], out);
+        cursor_write(out, "\n", 1);
+        if (CURSOR_OVERFLOWED(out)) {
+            size_t size = out->pos;
+            cursor_grow(out, size + size / 2);
+            out->pos = start;
+            c128_svg_write(slice->codes[i], out);
+            cursor_write(out, "\n", 1);
+        }
+    }
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail The barcodes are rendered in batches of SVG_BATCH per thread, each thread rendering
+ *              a contiguous slice of the batch into its own buffer, and the buffers are written out
+ *              in order once the whole batch is rendered. A slice whose thread cannot be started is
+ *              rendered on the calling thread.
+ */
+static int write_svgs(Code128 ** codes, int count, const Sink * sink, int threads) {
+    SvgSlice *  slices  = barcode_calloc(threads, sizeof *slices);
+    pthread_t * workers = barcode_calloc(threads, sizeof *workers);
+    bool *      started = barcode_calloc(threads, sizeof *started);
+    VERIFY_NULL(slices, sizeof *slices * threads);
+    VERIFY_NULL(workers, sizeof *workers * threads);
+    VERIFY_NULL(started, sizeof *started * threads);
+    for (int i = 0; i < threads; i++) {
+        slices[i].codes = codes;
+        cursor_alloc(&slices[i].out, EXPORT_BUFSIZE);
+    }
+
+    int status = SUCCESS;
+    for (int first = 0; first < count && SUCCESS == status; first += SVG_BATCH * threads) {
+        int batch = count - first < SVG_BATCH * threads ? count - first : SVG_BATCH * threads;
+        for (int i = 0; i < threads; i++) {
+            slices[i].first = first + (int) ((long long) batch * i / threads);
+            slices[i].last  = first + (int) ((long long) batch * (i + 1) / threads);
+        }
+        for (int i = 1; i < threads; i++) {
+            started[i] = 0 == pthread_create(&workers[i], NULL, render_slice, &slices[i]);
+        }
+        for (int i = 0; i < threads; i++) {
+            if (!started[i]) {
+                render_slice(&slices[i]);
+            }
+        }
+        for (int i = 1; i < threads; i++) {
+            if (started[i]) {
+                pthread_join(workers[i], NULL);
+            }
+        }
+
+        for (int i = 0; i < threads && SUCCESS == status; i++) {
+            status = sink->write(sink->ctx, slices[i].out.buf, slices[i].out.pos);
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        barcode_free(slices[i].out.buf);
+    }
+    barcode_free(slices);
+    barcode_free(workers);
+    barcode_free(started);
+    return status;
+}
+
+static int count_write(void * ctx, const char * data, size_t len) {
+    CountingSink * counter = ctx;
+    counter->bytes += len;
+    return counter->inner->write(counter->inner->ctx, data, len);
+}
+
+/**
+ *      @detail Adds up the sizes of the files written by c128_svg_export(), which only reports
+ *              whether it succeeded.
+ */
+static size_t exported_bytes(const char * path_fmt, int count) {
+    char        path[EXPORT_PATH_MAX];
+    struct stat st;
+    size_t      total = 0;
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof path, path_fmt, i);
+        total += 0 == stat(path, &st) ? (size_t) st.st_size : 0;
+    }
+    return total;
+}
+
+/**
+ *      @detail Paged PostScript written to a file is rendered straight into a mapping of the file,
+ *              and SVGs whose output path contains a conversion are exported to a file each.
+ *              Everything else is streamed through a counting sink to a file or stdout.
+ */
+static int write_output(Code128 ** codes, int count, Options * opts, size_t * bytes) {
+    const PSProperties * props    = &PS_DEFAULT_PROPS;
+    Layout *             layout   = &opts->layout;
+    int                  threads  = opts->threads;
+    bool                 has_path = NULL != opts->output && 0 != strcmp(opts->output, "-");
+
+    if (FORMAT_PS == opts->format && has_path && threads > 1) {
+        int status = c128_ps_paginate_mapped(codes, count, opts->output, props, layout, threads);
+        struct stat st;
+        *bytes = SUCCESS == status && 0 == stat(opts->output, &st) ? (size_t) st.st_size : 0;
+        return status;
+    }
+    if (FORMAT_SVG == opts->format && has_path && strchr(opts->output, '%')) {
+        int status = c128_svg_export(codes, count, opts->output, threads);
+        *bytes     = SUCCESS == status ? exported_bytes(opts->output, count) : 0;
+        return status;
+    }
+
+    FILE * file = has_path ? fopen(opts->output, "wb") : stdout;
+    if (NULL == file) {
+        return ERR_IO;
+    }
+
+    Sink         out;
+    CountingSink counter = {{count_write, &counter}, &out, 0};
+    Sink *       sink    = &counter.sink;
+    int          status;
+    sink_file(&out, file);
+
+    switch (opts->format) {
+        case FORMAT_PS:
+            if (threads > 1) {
+                status = c128_ps_paginate_mt_stream(codes, count, sink, props, layout, threads, 0);
+            } else {
+                status = c128_ps_paginate_stream(codes, count, sink, props, layout);
+            }
+            break;
+        case FORMAT_PDF: status = c128_pdf_stream(codes, count, sink, props, layout); break;
+        case FORMAT_ZPL:
+            status = c128_zpl_stream(codes, count, sink, props, layout, ZPL_DEFAULT_DPI);
+            break;
+        default: status = write_svgs(codes, count, sink, threads); break;
+    }
+
+    if (0 != fflush(file) || (has_path && 0 != fclose(file))) {
+        status = SUCCESS == status ? ERR_IO : status;
+    }
+    *bytes = counter.bytes;
+    return status;
+}
+
+static void print_stats(int records, int encoded, size_t bytes, long long ns) {
+    double seconds = (double) ns / NS_PER_SEC;
+    fprintf(stderr,
+            "barcode: %d records, %d written, %d failed\n"
+            "barcode: %.3f s, %.0f barcodes/s, %zu bytes (%.1f MB/s)\n",
+            records,
+            encoded,
+            records - encoded,
+            seconds,
+            seconds > 0 ? encoded / seconds : 0,
+            bytes,
+            seconds > 0 ? bytes / seconds / 1e6 : 0);
+
+    if (!barcode_stats_enabled()) {
+        return;
+    }
+    StatsSnapshot snapshot;
+    barcode_stats_snapshot(&snapshot);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageStats * stage = &snapshot.stages[i];
+        fprintf(stderr,
+                "barcode: %-9s %10llu calls %12.0f ns/call %14llu bytes %8llu errors\n",
+                barcode_stage_name(i),
+                stage->calls,
+                stage->calls ? (double) stage->ns / stage->calls : 0,
+                stage->bytes,
+                stage->errors);
+    }
+}
+
+int main(int argc, char ** argv) {
+    Options opts;
+    if (SUCCESS != parse_options(argc, argv, &opts)) {
+        fputs(USAGE, stderr);
+        return EXIT_ERROR;
+    }
 
-#define STRINGS 18
-
-char strings[STRINGS][C128_MAX_STRING_LEN] = {"CkORPNXLis6UMNbbKKkp",
-                                              "v7CzHixDHE7P5PTupo14",
-                                              "nXbF9rCcpIQVlzadujN7",
-                                              "1rOeVTSwlekRgBIjLSe1",
-                                              "NNg15hXW33esTzyxTnDm",
-                                              "2cTxjvWcs3nlD63zcgjJ",
-                                              "S4m80WoIdfiD316QSOvI",
-                                              "1rUo5fF7FbtchAKefH8R",
-                                              "dWXvrGYYLpmA4nZ9oVbo",
-                                              "nqizcaueVkIKOrxlp6Bi",
-                                              "6rNmAmyt9lUeMsoqf52o",
-                                              "ie3QM3prlDbkv12vGpZO",
-                                              "N1AEJq8AYaskDyMzGeqx",
-                                              "FSXJzgaQhREHFi5n6ucB",
-                                              "D7rcB0JBtVv5w0LMf7Y8",
-                                              "gKo1rWVNPH4qzUt7fcmE",
-                                              "kSEtBq3twMaJrfgq2mXa",
-                                              "6QQ0fJNcWYOO52bLFiNc"};
-
-int main(void) {
     init_barcode();
-    char       texts[STRINGS][C128_MAX_DATA_LEN];
-    Code128 ** codes = calloc(1, sizeof *codes * STRINGS);
-    VERIFY_NULL(codes, sizeof *codes * STRINGS);
-    for (int i = 0; i < STRINGS; i++) {
-        int len = strlen(strings[i]);
-        memcpy(texts[i], strings[i], len); // Remove null terminator
-        c128_encode((uchar *) texts[i], len, &codes[i]);
-    }
-
-    char * ps;
-    Layout layout = {.rows = 9, .cols = 2};
-    int    status = c128_ps_layout(codes, STRINGS, &ps, &PS_DEFAULT_PROPS, &layout);
-    printf("%d\n", status);
-    printf("%s\n", ps);
-    free(ps);
-    for (int i = 0; i < STRINGS; i++) {
-        free(codes[i]);
-    }
-    free(codes);
-    return 0;
+    long long start = now_ns();
+
+    uchar * input;
+    size_t  size;
+    bool    mapped;
+    if (SUCCESS != input_open(opts.input, &input, &size, &mapped)) {
+        perror(opts.input);
+        return EXIT_ERROR;
+    }
+
+    Record * records = NULL;
+    int      cap     = 0;
+    int      count   = opts.csv ? split_csv(input, size, opts.field, &records, &cap)
+                                : split_lines(input, size, &records, &cap);
+    int      first   = opts.header && count > 0 && 1 == records[0].line ? 1 : 0;
+    count -= first;
+
+    // Barcodes are encoded into one allocation, with the patterns of each after the structs
+    size_t    codes_size = (sizeof(Code128) + sizeof(pattern) * C128_MAX_PATTERN_SIZE) * count;
+    Code128 * codes      = barcode_malloc(codes_size + 1);
+    int *     status     = barcode_malloc(sizeof *status * count + 1);
+    Code128 **encoded    = barcode_malloc(sizeof *encoded * count + 1);
+    VERIFY_NULL(codes, codes_size);
+    VERIFY_NULL(status, sizeof *status * count);
+    VERIFY_NULL(encoded, sizeof *encoded * count);
+    pattern * patterns = (pattern *) (codes + count);
+    for (int i = 0; i < count; i++) {
+        codes[i].data = patterns + (size_t) i * C128_MAX_PATTERN_SIZE;
+    }
+
+    encode_all(records + first, count, codes, status, opts.threads);
+
+    int num_encoded = 0;
+    for (int i = 0; i < count; i++) {
+        if (SUCCESS == status[i]) {
+            encoded[num_encoded++] = &codes[i];
+        } else {
+            fprintf(stderr, "%s:%ld: error %d\n", opts.input, records[first + i].line, status[i]);
+        }
+    }
+
+    size_t bytes  = 0;
+    int    result = write_output(encoded, num_encoded, &opts, &bytes);
+    if (SUCCESS != result) {
+        fprintf(stderr, "barcode: could not write output: error %d\n", result);
+    }
+    if (!opts.quiet) {
+        print_stats(count, num_encoded, bytes, now_ns() - start);
+    }
+
+    barcode_free(encoded);
+    barcode_free(status);
+    barcode_free(codes);
+    barcode_free(records);
+    input_close(input, size, mapped);
+
+    if (SUCCESS != result) {
+        return EXIT_ERROR;
+    }
+    return num_encoded == count ? EXIT_SUCCESS : EXIT_RECORDS;
 }
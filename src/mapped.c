@@ -0,0 +1,226 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file mapped.c
+ *      @brief Definitions of memory-mapped document rendering functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/mapped.h"
+
+#include "barcode/alloc.h"
+#include "barcode/cache.h"
+#include "barcode/cursor.h"
+#include "barcode/errors.h"
+#include "barcode/stats.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct MappedJob    MappedJob;
+typedef struct MappedRegion MappedRegion;
+
+struct MappedJob {
+    Code128 **  codes;
+    int         num_codes;
+    Layout *    layout;
+    int         per_page; /**< Barcodes per page */
+    size_t *    offsets;  /**< Start of each page in the file, then the start of the trailer */
+    char *      map;      /**< The mapped file */
+    RenderCache cache;    /**< Symbol fragments shared by all threads */
+};
+
+struct MappedRegion {
+    MappedJob * job;
+    int         first;  /**< First page of the region */
+    int         last;   /**< Page after the last page of the region */
+    int         status; /**< The first error in the region */
+};
+
+static int render_page(MappedJob * job, int page, Cursor * dest) {
+    int first = page * job->per_page;
+    int count = job->num_codes - first < job->per_page ? job->num_codes - first : job->per_page;
+    return c128_ps_page_cached(job->codes + first, count, page + 1, dest, &job->cache, job->layout);
+}
+
+/**
+ *      @detail Records the size of each page of a region after the offset of the page, ready to be
+ *              summed into offsets.
+ */
+static void * measure_region(void * arg) {
+    MappedRegion * region = arg;
+    MappedJob *    job    = region->job;
+
+    for (int page = region->first; page < region->last; page++) {
+        Cursor measure;
+        cursor_init(&measure, NULL, 0);
+        if (SUCCESS == region->status) {
+            region->status = render_page(job, page, &measure);
+        }
+        job->offsets[page + 1] = measure.pos;
+    }
+    barcode_stats_publish();
+    return NULL;
+}
+
+static void * render_region(void * arg) {
+    MappedRegion * region = arg;
+    MappedJob *    job    = region->job;
+
+    for (int page = region->first; page < region->last && SUCCESS == region->status; page++) {
+        size_t size = job->offsets[page + 1] - job->offsets[page];
+        Cursor cursor;
+        cursor_init(&cursor, job->map + job->offsets[page], size);
+        region->status = render_page(job, page, &cursor);
+        if (SUCCESS == region->status && cursor.pos != size) {
+            region->status = ERR_BUFFER_SIZE;
+        }
+    }
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail The first region is run on the calling thread and the rest on new threads. If a
+ *              thread cannot be started, its region and those after it are run on the calling
+ *              thread instead.
+ */
+static int run_regions(MappedRegion * regions, int threads, void * (*run)(void *)) {
+    size_t      workers_size = sizeof(pthread_t) * threads;
+    pthread_t * workers      = barcode_malloc(workers_size);
+    VERIFY_NULL(workers, workers_size);
+
+    int started = 1;
+    while (started < threads &&
+           0 == pthread_create(&workers[started], NULL, run, &regions[started])) {
+        started++;
+    }
+    for (int i = started; i < threads; i++) {
+        run(&regions[i]);
+    }
+    run(&regions[0]);
+
+    int status = regions[0].status;
+    for (int i = 1; i < threads; i++) {
+        if (i < started) {
+            pthread_join(workers[i], NULL);
+        }
+        if (SUCCESS == status) {
+            status = regions[i].status;
+        }
+    }
+
+    barcode_free(workers);
+    return status;
+}
+
+/**
+ *      @detail Creates the file with the given size and maps it, returning NULL on failure.
+ */
+static char * map_file(const char * path, size_t size, int * fd) {
+    *fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (*fd < 0) {
+        return NULL;
+    }
+    if (0 != ftruncate(*fd, (off_t) size)) {
+        return NULL;
+    }
+
+    void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    return MAP_FAILED == map ? NULL : map;
+}
+
+int c128_ps_paginate_mapped(Code128 **           codes,
+                            int                  num_codes,
+                            const char *         path,
+                            const PSProperties * props,
+                            Layout *             layout,
+                            int                  threads) {
+    if (threads < 1) {
+        return ERR_ARGUMENT;
+    }
+    if (layout->cols * layout->rows == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    int pages = c128_ps_num_pages(num_codes, layout);
+    if (threads > pages) {
+        threads = pages > 0 ? pages : 1;
+    }
+
+    MappedJob job = {.codes     = codes,
+                     .num_codes = num_codes,
+                     .layout    = layout,
+                     .per_page  = layout->cols * layout->rows,
+                     .map       = NULL};
+    c128_cache_init(&job.cache, props);
+
+    size_t offsets_size = sizeof *job.offsets * (pages + 1);
+    job.offsets         = barcode_malloc(offsets_size);
+    VERIFY_NULL(job.offsets, offsets_size);
+
+    size_t         regions_size = sizeof(MappedRegion) * threads;
+    MappedRegion * regions      = barcode_malloc(regions_size);
+    VERIFY_NULL(regions, regions_size);
+    for (int i = 0; i < threads; i++) {
+        regions[i] = (MappedRegion){.job    = &job,
+                                    .first  = pages * i / threads,
+                                    .last   = pages * (i + 1) / threads,
+                                    .status = SUCCESS};
+    }
+
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+    c128_ps_dsc_header(&measure, props, pages);
+    job.offsets[0] = measure.pos;
+
+    int status = run_regions(regions, threads, measure_region);
+    for (int page = 0; page < pages; page++) {
+        job.offsets[page + 1] += job.offsets[page];
+    }
+
+    cursor_init(&measure, NULL, 0);
+    c128_ps_dsc_trailer(&measure);
+    size_t size = job.offsets[pages] + measure.pos;
+
+    int fd = -1;
+    if (SUCCESS == status) {
+        job.map = map_file(path, size, &fd);
+        status  = NULL == job.map ? ERR_IO : SUCCESS;
+    }
+
+    if (SUCCESS == status) {
+        Cursor cursor;
+        cursor_init(&cursor, job.map, job.offsets[0]);
+        c128_ps_dsc_header(&cursor, props, pages);
+
+        status = run_regions(regions, threads, render_region);
+
+        cursor_init(&cursor, job.map + job.offsets[pages], size - job.offsets[pages]);
+        c128_ps_dsc_trailer(&cursor);
+    }
+
+    if (NULL != job.map && 0 != munmap(job.map, size) && SUCCESS == status) {
+        status = ERR_IO;
+    }
+    if (fd >= 0 && 0 != close(fd) && SUCCESS == status) {
+        status = ERR_IO;
+    }
+    // A partly written document is not left behind
+    if (fd >= 0 && SUCCESS != status) {
+        unlink(path);
+    }
+
+    barcode_free(regions);
+    barcode_free(job.offsets);
+    c128_cache_free(&job.cache);
+    return status;
+}
@@ -0,0 +1,252 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file parallel.c
+ *      @brief Definitions of multi-threaded document rendering functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/parallel.h"
+
+#include "barcode/alloc.h"
+#include "barcode/cache.h"
+#include "barcode/cursor.h"
+#include "barcode/errors.h"
+#include "barcode/sink.h"
+#include "barcode/stats.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ *      @brief Initial capacity of a page buffer, grown as needed by the first pages rendered
+ */
+#define PAGE_BUFSIZE 4096
+
+/**
+ *      @brief A buffer holding one rendered page until it is written out.
+ */
+typedef struct PageSlot PageSlot;
+
+/**
+ *      @brief State shared between the writer and the workers rendering a paged document.
+ */
+typedef struct PageJob PageJob;
+
+struct PageSlot {
+    Cursor cursor; /**< The rendered page */
+    bool   ready;  /**< Whether the page has been rendered and may be written */
+    int    status; /**< The status of rendering the page */
+};
+
+struct PageJob {
+    Code128 **           codes;
+    int                  num_codes;
+    RenderCache          cache;     /**< Symbol fragments shared by all workers */
+    const Allocator *    allocator; /**< The allocator of the calling thread, used by the workers */
+    Layout *             layout;
+    int                  per_page; /**< Barcodes per page */
+    int                  pages;    /**< Total number of pages */
+    int                  window;   /**< Number of slots */
+    PageSlot *           slots;    /**< Page @c n is rendered into <tt>slots[n % window]</tt> */
+    int                  next;     /**< The next page to be claimed by a worker */
+    int                  written;  /**< The number of pages written out */
+    bool                 stop;     /**< Set when writing fails, to stop the workers early */
+    pthread_mutex_t      lock;
+    pthread_cond_t       claimable; /**< Signalled when a slot is freed */
+    pthread_cond_t       ready;     /**< Signalled when a page is rendered */
+};
+
+/**
+ *      @detail The page is rendered into whatever buffer the slot already has. If it does not fit,
+ *              the cursor will have counted the size it needs, so the buffer is grown and the page
+ *              rendered again. Buffers settle at the size of the largest page after the first few.
+ */
+static int render_page(PageJob * job, int page, PageSlot * slot) {
+    int first = page * job->per_page;
+    int count = job->num_codes - first < job->per_page ? job->num_codes - first : job->per_page;
+
+    slot->cursor.pos = 0;
+    int status = c128_ps_page_cached(
+        job->codes + first, count, page + 1, &slot->cursor, &job->cache, job->layout);
+    if (CURSOR_OVERFLOWED(&slot->cursor)) {
+        cursor_grow(&slot->cursor, slot->cursor.pos);
+        status = c128_ps_page_cached(
+            job->codes + first, count, page + 1, &slot->cursor, &job->cache, job->layout);
+    }
+    return status;
+}
+
+static void * page_worker(void * arg) {
+    PageJob * job = arg;
+    barcode_use_allocator(job->allocator);
+
+    pthread_mutex_lock(&job->lock);
+    for (;;) {
+        // Wait until the slot for the next page has been written out
+        while (!job->stop && job->next < job->pages && job->next - job->written >= job->window) {
+            pthread_cond_wait(&job->claimable, &job->lock);
+        }
+        if (job->stop || job->next >= job->pages) {
+            break;
+        }
+        int        page = job->next++;
+        PageSlot * slot = &job->slots[page % job->window];
+        pthread_mutex_unlock(&job->lock);
+
+        int status = render_page(job, page, slot);
+
+        pthread_mutex_lock(&job->lock);
+        slot->status = status;
+        slot->ready  = true;
+        pthread_cond_broadcast(&job->ready);
+    }
+    pthread_mutex_unlock(&job->lock);
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail Writes the whole of a cursor's output to a sink.
+ */
+static int write_cursor(Cursor * cursor, const Sink * out) {
+    return out->write(out->ctx, cursor->buf, cursor->pos);
+}
+
+/**
+ *      @detail The calling thread writes the prolog, then waits on each page in order and writes it
+ *              as soon as it is ready, freeing its slot for a later page. Workers claim pages in
+ *              order but may finish them out of order; a worker only claims a page once fewer than
+ *              @c window pages are ahead of the writer, which bounds the memory in use. If no
+ *              worker can be started, the calling thread renders each page itself before writing
+ *              it.
+ */
+int c128_ps_paginate_mt_stream(Code128 **           codes,
+                               int                  num_codes,
+                               const Sink *         out,
+                               const PSProperties * props,
+                               Layout *             layout,
+                               int                  threads,
+                               int                  window) {
+    if (threads < 1 || window < 0) {
+        return ERR_ARGUMENT;
+    }
+    if (layout->cols * layout->rows == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+    if (0 == window) {
+        window = PS_MT_WINDOW_PER_THREAD * threads;
+    }
+
+    PageJob job = {.codes     = codes,
+                   .num_codes = num_codes,
+                   .allocator = barcode_allocator(),
+                   .layout    = layout,
+                   .per_page  = layout->cols * layout->rows,
+                   .pages     = c128_ps_num_pages(num_codes, layout),
+                   .window    = window,
+                   .next      = 0,
+                   .written   = 0,
+                   .stop      = false};
+
+    c128_cache_init(&job.cache, props);
+
+    size_t slots_size = sizeof *job.slots * window;
+    job.slots         = barcode_calloc(1, slots_size);
+    VERIFY_NULL(job.slots, slots_size);
+    for (int i = 0; i < window; i++) {
+        cursor_alloc(&job.slots[i].cursor, PAGE_BUFSIZE);
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.claimable, NULL);
+    pthread_cond_init(&job.ready, NULL);
+
+    Cursor header;
+    cursor_alloc(&header, PAGE_BUFSIZE);
+    c128_ps_dsc_header(&header, props, job.pages);
+    if (CURSOR_OVERFLOWED(&header)) {
+        cursor_grow(&header, header.pos);
+        c128_ps_dsc_header(&header, props, job.pages);
+    }
+    int status = write_cursor(&header, out);
+
+    size_t     workers_size = sizeof(pthread_t) * threads;
+    pthread_t * workers     = barcode_malloc(workers_size);
+    VERIFY_NULL(workers, workers_size);
+    // Workers are only started once the header is written, as nothing else would stop them
+    int started = 0;
+    while (SUCCESS == status && started < threads &&
+           0 == pthread_create(&workers[started], NULL, page_worker, &job)) {
+        started++;
+    }
+
+    for (int page = 0; page < job.pages && SUCCESS == status; page++) {
+        PageSlot * slot = &job.slots[page % window];
+        if (0 == started) {
+            slot->status = render_page(&job, page, slot);
+            slot->ready  = true;
+        }
+
+        pthread_mutex_lock(&job.lock);
+        while (!slot->ready) {
+            pthread_cond_wait(&job.ready, &job.lock);
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        status = slot->status;
+        if (SUCCESS == status) {
+            status = write_cursor(&slot->cursor, out);
+        }
+
+        pthread_mutex_lock(&job.lock);
+        slot->ready = false;
+        job.written++;
+        if (SUCCESS != status) {
+            job.stop = true;
+        }
+        pthread_cond_broadcast(&job.claimable);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    if (SUCCESS == status) {
+        header.pos = 0;
+        c128_ps_dsc_trailer(&header);
+        status = write_cursor(&header, out);
+    }
+
+    barcode_free(workers);
+    barcode_free(header.buf);
+    for (int i = 0; i < window; i++) {
+        barcode_free(job.slots[i].cursor.buf);
+    }
+    barcode_free(job.slots);
+    c128_cache_free(&job.cache);
+    pthread_cond_destroy(&job.ready);
+    pthread_cond_destroy(&job.claimable);
+    pthread_mutex_destroy(&job.lock);
+
+    return status;
+}
+
+int c128_ps_paginate_mt(Code128 **           codes,
+                        int                  num_codes,
+                        FILE *               out,
+                        const PSProperties * props,
+                        Layout *             layout,
+                        int                  threads,
+                        int                  window) {
+    Sink sink;
+    sink_file(&sink, out);
+    return c128_ps_paginate_mt_stream(codes, num_codes, &sink, props, layout, threads, window);
+}
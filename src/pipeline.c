@@ -0,0 +1,365 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file pipeline.c
+ *      @brief Definitions of the concurrent encode, render and write pipeline.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/pipeline.h"
+
+#include "barcode/alloc.h"
+#include "barcode/cache.h"
+#include "barcode/errors.h"
+#include "barcode/stats.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+/**
+ *      @brief Size of a cache line, which separates counters written by different threads
+ */
+#define PIPE_CACHE_LINE 64
+/**
+ *      @brief Number of times a stage polls before yielding, and before sleeping, while it waits
+ */
+#define PIPE_SPINS 64
+#define PIPE_YIELDS 1024
+#define PIPE_SLEEP_NS 50000
+
+/**
+ *      @brief A count of slots passed from one stage to the next, alone on its cache line.
+ */
+typedef struct PipeCounter PipeCounter;
+
+/**
+ *      @brief One barcode on its way through the pipeline.
+ */
+typedef struct PipeSlot PipeSlot;
+
+/**
+ *      @brief The slots of one render worker and the counters that pass them between stages.
+ */
+typedef struct PipeLane PipeLane;
+
+/**
+ *      @brief State shared between the stages of a pipeline.
+ */
+typedef struct PipeJob PipeJob;
+
+struct PipeCounter {
+    _Atomic size_t value;
+    char           pad[PIPE_CACHE_LINE - sizeof(size_t)];
+};
+
+struct PipeSlot {
+    Code128 code;
+    pattern patterns[C128_MAX_PATTERN_SIZE]; /**< Storage for the patterns of @c code */
+    Cursor  out;    /**< The rendered document */
+    int     status; /**< The status of encoding the barcode */
+    bool    end;    /**< Whether the slot marks the end of the input instead */
+};
+
+/**
+ *      @detail Each counter only ever increases and is written by one stage alone: the encoder
+ *              fills slot <tt>encoded % depth</tt>, the worker renders up to @c encoded and the
+ *              writer writes up to @c rendered. The slots between two counters belong to the later
+ *              stage, which makes two single-producer, single-consumer queues over one array.
+ */
+struct PipeLane {
+    PipeCounter encoded;
+    PipeCounter rendered;
+    PipeCounter written;
+    PipeSlot *  slots;
+    PipeJob *   job;
+    bool        running; /**< Whether a worker thread renders the lane */
+};
+
+struct PipeJob {
+    const Source *          source;
+    const PipelineOptions * opts;
+    const Allocator *       allocator; /**< The allocator of the calling thread, used by stages */
+    RenderCache             cache;     /**< Symbol fragments shared by the workers */
+    bool                    cached;    /**< Whether PostScript is rendered from @c cache */
+    Cursor                  header;    /**< The output of c128_ps_header(), for PostScript */
+    int                     workers;
+    size_t                  depth;
+    PipeLane *              lanes;
+    long                    records; /**< Number of records read, set by the encoder */
+    int                     status;  /**< The status of the source, set by the encoder */
+    atomic_bool             stop;    /**< Set by the writer when the sink fails */
+};
+
+/**
+ *      @detail Waits for another stage briefly by polling, then by yielding the processor, and
+ *              after that by sleeping, so a stage held up by a slow sink costs little.
+ */
+static void pipe_wait(int * spins) {
+    (*spins)++;
+    if (*spins > PIPE_SPINS + PIPE_YIELDS) {
+        struct timespec ts = {0, PIPE_SLEEP_NS};
+        nanosleep(&ts, NULL);
+    } else if (*spins > PIPE_SPINS) {
+        sched_yield();
+    }
+}
+
+/**
+ *      @detail Waits until a counter of another stage exceeds @c pos, and returns its value.
+ */
+static size_t pipe_await(PipeCounter * counter, size_t pos) {
+    int    spins = 0;
+    size_t value;
+    while ((value = atomic_load_explicit(&counter->value, memory_order_acquire)) <= pos) {
+        pipe_wait(&spins);
+    }
+    return value;
+}
+
+static void pipe_release(PipeCounter * counter, size_t value) {
+    atomic_store_explicit(&counter->value, value, memory_order_release);
+}
+
+static size_t pipe_own(PipeCounter * counter) {
+    return atomic_load_explicit(&counter->value, memory_order_relaxed);
+}
+
+/**
+ *      @detail Claims the next slot of a lane for the encoder, waiting until the writer has freed
+ *              it.
+ */
+static PipeSlot * encoder_claim(PipeJob * job, PipeLane * lane) {
+    size_t pos = pipe_own(&lane->encoded);
+    if (pos >= job->depth) {
+        pipe_await(&lane->written, pos - job->depth);
+    }
+    return &lane->slots[pos % job->depth];
+}
+
+static int encode_record(const uchar * data, int len, PipeSlot * slot) {
+    if (len < 0) {
+        return ERR_DATA_LENGTH;
+    }
+    return c128_encode_into((uchar *) data, len, &slot->code);
+}
+
+/**
+ *      @detail Record @c n goes to lane <tt>n % workers</tt>. Once the input ends, the next slot of
+ *              every lane is marked as the end, in the order the writer will reach them.
+ */
+static void * encoder_run(void * arg) {
+    PipeJob *      job    = arg;
+    const Source * source = job->source;
+    barcode_use_allocator(job->allocator);
+
+    long n = 0;
+    for (;; n++) {
+        PipeLane *    lane = &job->lanes[n % job->workers];
+        PipeSlot *    slot = encoder_claim(job, lane);
+        const uchar * data = NULL;
+        int           len  = 0;
+        if (!atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+            job->status = source->next(source->ctx, &data, &len);
+        }
+        if (SUCCESS != job->status || NULL == data) {
+            break;
+        }
+
+        slot->end    = false;
+        slot->status = encode_record(data, len, slot);
+        pipe_release(&lane->encoded, pipe_own(&lane->encoded) + 1);
+    }
+
+    job->records = n;
+    for (long i = n; i < n + job->workers; i++) {
+        PipeLane * lane = &job->lanes[i % job->workers];
+        encoder_claim(job, lane)->end = true;
+        pipe_release(&lane->encoded, pipe_own(&lane->encoded) + 1);
+    }
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail PostScript documents are framed by the header formatted when the pipeline started,
+ *              as in a render context.
+ */
+static void render_document(PipeJob * job, PipeSlot * slot) {
+    Cursor * out = &slot->out;
+    if (PIPELINE_SVG == job->opts->format) {
+        c128_svg_cached(&slot->code, out, &job->cache);
+        cursor_write(out, "\n", 1);
+        return;
+    }
+
+    cursor_write(out, job->header.buf, job->header.pos);
+    if (job->cached) {
+        c128_ps_cached(&slot->code, out, &job->cache);
+    } else {
+        c128_ps(&slot->code, out, &job->cache.props);
+    }
+    c128_ps_footer(out);
+}
+
+/**
+ *      @detail Each slot keeps its buffer, which is grown and the document rendered again whenever
+ *              a document does not fit, so buffers soon stop growing.
+ */
+static void * worker_run(void * arg) {
+    PipeLane * lane = arg;
+    PipeJob *  job  = lane->job;
+    barcode_use_allocator(job->allocator);
+
+    for (size_t pos = pipe_own(&lane->rendered);; pos++) {
+        pipe_await(&lane->encoded, pos);
+        PipeSlot * slot = &lane->slots[pos % job->depth];
+        bool       end  = slot->end;
+
+        if (!end && SUCCESS == slot->status) {
+            slot->out.pos = 0;
+            render_document(job, slot);
+            if (CURSOR_OVERFLOWED(&slot->out)) {
+                cursor_grow(&slot->out, slot->out.pos);
+                render_document(job, slot);
+            }
+        }
+        pipe_release(&lane->rendered, pos + 1);
+        if (end) {
+            break;
+        }
+    }
+    barcode_stats_publish();
+    return NULL;
+}
+
+/**
+ *      @detail Once the sink fails, the encoder is told to stop and the slots already queued are
+ *              drained without being written, so that no stage is left waiting. The writer starts
+ *              failed if a thread could not be started, so the slots of a lane without a worker
+ *              are never written and are drained as soon as they are encoded.
+ */
+static int writer_run(PipeJob * job, const Sink * out, PipelineStats * stats, int status) {
+    const PipelineOptions * opts = job->opts;
+
+    for (long n = 0;; n++) {
+        PipeLane * lane = &job->lanes[n % job->workers];
+        size_t     pos  = pipe_own(&lane->written);
+        pipe_await(lane->running ? &lane->rendered : &lane->encoded, pos);
+        PipeSlot * slot = &lane->slots[pos % job->depth];
+        if (slot->end) {
+            break;
+        }
+
+        if (SUCCESS == status && SUCCESS != slot->status) {
+            stats->failed++;
+            if (NULL != opts->reject) {
+                opts->reject(opts->reject_ctx, n, slot->status);
+            }
+        } else if (SUCCESS == status) {
+            status = out->write(out->ctx, slot->out.buf, slot->out.pos);
+            if (SUCCESS == status) {
+                stats->written++;
+                stats->bytes += slot->out.pos;
+            } else {
+                atomic_store_explicit(&job->stop, true, memory_order_relaxed);
+            }
+        }
+        pipe_release(&lane->written, pos + 1);
+    }
+    return status;
+}
+
+int c128_pipeline(const Source *          source,
+                  const Sink *            out,
+                  const PipelineOptions * opts,
+                  PipelineStats *         stats) {
+    PipelineStats counts = {0, 0, 0, 0};
+    if (NULL == source || NULL == opts || opts->workers < 1 || opts->depth < 0) {
+        return ERR_ARGUMENT;
+    }
+
+    PipeJob job = {.source    = source,
+                   .opts      = opts,
+                   .allocator = barcode_allocator(),
+                   .workers   = opts->workers,
+                   .depth     = opts->depth ? (size_t) opts->depth : PIPELINE_DEFAULT_DEPTH,
+                   .records   = 0,
+                   .status    = SUCCESS};
+    atomic_init(&job.stop, false);
+
+    const PSProperties * props = opts->props ? opts->props : &PS_DEFAULT_PROPS;
+    c128_cache_init(&job.cache, props);
+    job.cached = PS_MODE_IMAGE != props->mode;
+    cursor_init(&job.header, NULL, 0);
+    c128_ps_header(&job.header, props);
+    cursor_alloc(&job.header, job.header.pos);
+    c128_ps_header(&job.header, props);
+
+    size_t lanes_size = sizeof *job.lanes * job.workers;
+    size_t slots_size = sizeof(PipeSlot) * job.depth * job.workers;
+    job.lanes         = barcode_calloc(1, lanes_size);
+    PipeSlot * slots  = barcode_calloc(1, slots_size);
+    VERIFY_NULL(job.lanes, lanes_size);
+    VERIFY_NULL(slots, slots_size);
+    for (int i = 0; i < job.workers; i++) {
+        job.lanes[i].slots = slots + job.depth * i;
+        job.lanes[i].job   = &job;
+    }
+    for (size_t i = 0; i < job.depth * job.workers; i++) {
+        slots[i].code = (Code128){.data = slots[i].patterns};
+        cursor_init(&slots[i].out, NULL, 0);
+    }
+
+    size_t      threads_size = sizeof(pthread_t) * (job.workers + 1);
+    pthread_t * threads      = barcode_malloc(threads_size);
+    VERIFY_NULL(threads, threads_size);
+    bool encoding = 0 == pthread_create(&threads[0], NULL, encoder_run, &job);
+    int  started  = 0;
+    while (encoding && started < job.workers &&
+           0 == pthread_create(&threads[started + 1], NULL, worker_run, &job.lanes[started])) {
+        job.lanes[started++].running = true;
+    }
+
+    /* With stop set, an encoder run here only marks the end of every lane */
+    int status = SUCCESS;
+    if (!encoding || started < job.workers) {
+        status = ERR_GENERIC;
+        atomic_store_explicit(&job.stop, true, memory_order_relaxed);
+    }
+    if (!encoding) {
+        encoder_run(&job);
+    }
+    status = writer_run(&job, out, &counts, status);
+
+    if (encoding) {
+        pthread_join(threads[0], NULL);
+    }
+    for (int i = 1; i <= started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (SUCCESS == status) {
+        status = job.status;
+    }
+    counts.records = job.records;
+    if (NULL != stats) {
+        *stats = counts;
+    }
+
+    for (size_t i = 0; i < job.depth * job.workers; i++) {
+        barcode_free(slots[i].out.buf);
+    }
+    barcode_free(threads);
+    barcode_free(slots);
+    barcode_free(job.lanes);
+    barcode_free(job.header.buf);
+    c128_cache_free(&job.cache);
+    return status;
+}
@@ -0,0 +1,415 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file printer.c
+ *      @brief Definitions for driving label and receipt printers with their native commands.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/printer.h"
+
+#include "barcode/compose.h"
+#include "barcode/errors.h"
+#include "barcode/raster.h"
+#include "barcode/util.h"
+
+#include <string.h>
+
+/**
+ *      @brief The character following ESCPOS_CODE_PREFIX for each function value from AFNC3 to
+ *             AFNC1 in code sets A, B and C. Values below CCodeB are digits in code set C.
+ */
+static const char ESCPOS_FUNCTIONS[][AFNC1 - AFNC3 + 1] = {
+    {'3', '2', 'S', 'C', 'B', '4', '1'},
+    {'3', '2', 'S', 'C', '4', 'A', '1'},
+    {'\0', '\0', '\0', '\0', 'B', 'A', '1'}};
+
+/**
+ *      @brief Recovers the code set a barcode starts in, and the values of its symbols between its
+ *             start and checksum symbols.
+ *      @detail The values are looked up in C128_CODE_INVERSE, in which an unknown pattern reads as
+ *              0, so each is checked against C128_CODE.
+ */
+static int printer_values(const Code128 * code, Code128CodeSet * start, int * values, int * len) {
+    if (code->datalen < 3) {
+        return ERR_NULL_PATTERN;
+    }
+
+    switch (code->data[0]) {
+        case START_A: *start = A; break;
+        case START_B: *start = B; break;
+        case START_C: *start = C; break;
+        default: return ERR_INVALID_CODE_SET;
+    }
+
+    // Skip the start, checksum and stop symbols
+    *len = code->datalen - 3;
+    for (int i = 0; i < *len; i++) {
+        pattern p = code->data[i + 1];
+        // Data patterns have C128_DATA_WIDTH bars less their leading bar and trailing space
+        if (p >> (C128_DATA_WIDTH - 2) || C128_CODE[C128_CODE_INVERSE[p]] != p) {
+            return ERR_NULL_PATTERN;
+        }
+        values[i] = C128_CODE_INVERSE[p];
+    }
+    return SUCCESS;
+}
+
+/**
+ *      @brief The code set that a value switches to, or Invalid if it is not a code set change.
+ */
+static Code128CodeSet printer_switch(Code128CodeSet set, int value) {
+    if (C == set) {
+        return CCodeA == value ? A : CCodeB == value ? B : Invalid;
+    }
+    if (ACodeC == value) {
+        return C;
+    }
+    if (A == set && ACodeB == value) {
+        return B;
+    }
+    if (B == set && C128_B_VALUE(BCodeA) == value) {
+        return A;
+    }
+    return Invalid;
+}
+
+/**
+ *      @brief The character a value below AFNC3 represents in code set A or B.
+ */
+static uchar printer_char(Code128CodeSet set, int value) {
+    if (A == set && value >= ASCII_NUM_CTRL * 2) {
+        return value - ASCII_NUM_CTRL * 2;
+    }
+    return value + ASCII_NUM_CTRL;
+}
+
+/**
+ *      @brief Calculates the position of the top-left of the bars of a barcode on a page, in dots.
+ *      @detail Barcodes are placed as by c128_pdf(), with rows laid out upwards from the bottom
+ *              margin, and the quiet zone is left of @c x as printers do not draw it.
+ */
+static void printer_place(const PSProperties * props,
+                          Layout *             layout,
+                          int                  dpi,
+                          int                  height,
+                          int                  index,
+                          int *                x,
+                          int *                y) {
+    float col_pitch = props->column_width + props->padding;
+    float row_pitch = props->bar_height + props->fontsize + props->padding;
+    int   row       = index / layout->cols;
+    int   col       = index % layout->cols;
+    float bottom    = props->bmargin + props->padding + row * row_pitch + props->bar_height;
+
+    *x = raster_pixels(props->lmargin + col * col_pitch, props, dpi) +
+         C128_QUIET_WIDTH * raster_module_pixels(props, dpi);
+    *y = height - raster_pixels(bottom, props, dpi);
+}
+
+/**
+ *      @detail Bytes that ZPL would otherwise interpret, and control characters, are written as
+ *              @c ^FH escapes.
+ */
+static void zpl_char(Cursor * dest, uchar c) {
+    if (ZPL_INVOKE == c) {
+        cursor_puts(dest, ZPL_INVOKE_LITERAL);
+    } else if (c < ASCII_NUM_CTRL || c >= DEL || '^' == c || '~' == c || ZPL_HEX_INDICATOR == c) {
+        cursor_printf(dest, "%c%02X", ZPL_HEX_INDICATOR, c);
+    } else {
+        cursor_write(dest, (const char *) &c, 1);
+    }
+}
+
+static int zpl_data(const Code128 * code, Cursor * dest) {
+    int            values[C128_MAX_PATTERN_SIZE];
+    int            len;
+    Code128CodeSet set;
+    int            status = printer_values(code, &set, values, &len);
+    if (SUCCESS != status) {
+        return status;
+    }
+
+    cursor_puts(dest, A == set ? ZPL_START_A : B == set ? ZPL_START_B : ZPL_START_C);
+
+    Code128CodeSet shifted = Invalid;
+    for (int i = 0; i < len; i++) {
+        Code128CodeSet current = Invalid != shifted ? shifted : set;
+        int            value   = values[i];
+        shifted                = Invalid;
+
+        if (C == current && value < CCodeB) {
+            cursor_printf(dest, "%02d", value);
+        } else if (C != current && value < AFNC3) {
+            zpl_char(dest, printer_char(current, value));
+        } else {
+            // From >1, invocation codes are consecutive Code 128 values
+            char invoke[] = {ZPL_INVOKE, '1' + value - ZPL_INVOKE_FIRST_VALUE};
+            cursor_write(dest, invoke, sizeof invoke);
+        }
+
+        if (C != current && AShiftB == value) {
+            shifted = A == current ? B : A;
+        }
+        Code128CodeSet next = printer_switch(current, value);
+        if (Invalid != next) {
+            set = next;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ *      @detail Each page of the layout is one label, sized to fit the page as in c128_pdf().
+ */
+int c128_zpl_write(Code128 **           codes,
+                   int                  num_codes,
+                   Cursor *             dest,
+                   const PSProperties * props,
+                   Layout *             layout,
+                   int                  dpi) {
+    int per_page = layout->cols * layout->rows;
+    if (per_page == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+    if (dpi < 1) {
+        return ERR_ARGUMENT;
+    }
+
+    float width = props->lmargin + layout->cols * (props->column_width + props->padding) -
+                  props->padding + props->rmargin;
+    float height = props->bmargin + props->padding +
+                   (layout->rows - 1) * (props->bar_height + props->fontsize + props->padding) +
+                   props->bar_height + props->tmargin;
+    int label_width  = raster_pixels(width, props, dpi);
+    int label_height = raster_pixels(height, props, dpi);
+    int bar_height   = raster_pixels(props->bar_height, props, dpi);
+    int module       = raster_module_pixels(props, dpi);
+    module           = module < ZPL_MAX_MODULE ? module : ZPL_MAX_MODULE;
+
+    int pages = c128_ps_num_pages(num_codes, layout);
+    for (int page = 0; page < pages; page++) {
+        int first = page * per_page;
+        int count = num_codes - first < per_page ? num_codes - first : per_page;
+
+        cursor_puts(dest, ZPL_LABEL_BEGIN);
+        cursor_printf(dest, ZPL_LABEL_SIZE, label_width, label_height);
+        for (int i = 0; i < count; i++) {
+            int x, y;
+            printer_place(props, layout, dpi, label_height, i, &x, &y);
+            cursor_printf(dest,
+                          ZPL_FIELD,
+                          x,
+                          y,
+                          module,
+                          bar_height > 0 ? bar_height : 1,
+                          props->fontsize > 0 ? 'Y' : 'N');
+
+            int status = zpl_data(codes[first + i], dest);
+            if (SUCCESS != status) {
+                return status;
+            }
+            cursor_puts(dest, ZPL_FIELD_END);
+        }
+        cursor_puts(dest, ZPL_LABEL_END);
+    }
+    return dest->status;
+}
+
+/**
+ *      @detail As with c128_pdf_size(), the labels are rendered to a NULL cursor.
+ */
+int c128_zpl_size(Code128 **           codes,
+                  int                  num_codes,
+                  const PSProperties * props,
+                  Layout *             layout,
+                  int                  dpi,
+                  size_t *             size) {
+    Cursor measure;
+    cursor_init(&measure, NULL, 0);
+
+    int status = c128_zpl_write(codes, num_codes, &measure, props, layout, dpi);
+    *size      = measure.pos;
+    return status;
+}
+
+int c128_zpl(Code128 **           codes,
+             int                  num_codes,
+             char **              dest,
+             const PSProperties * props,
+             Layout *             layout,
+             int                  dpi) {
+    size_t size;
+    int    status = c128_zpl_size(codes, num_codes, props, layout, dpi, &size);
+    if (SUCCESS != status) {
+        return status;
+    }
+
+    Cursor cursor;
+    cursor_alloc(&cursor, size);
+    status = c128_zpl_write(codes, num_codes, &cursor, props, layout, dpi);
+    *dest  = cursor_str(&cursor);
+    return status;
+}
+
+int c128_zpl_stream(Code128 **           codes,
+                    int                  num_codes,
+                    const Sink *         sink,
+                    const PSProperties * props,
+                    Layout *             layout,
+                    int                  dpi) {
+    char   buf[CURSOR_SINK_BUFSIZE];
+    Cursor cursor;
+    cursor_init_sink(&cursor, buf, sizeof buf, sink);
+
+    int status  = c128_zpl_write(codes, num_codes, &cursor, props, layout, dpi);
+    int flushed = cursor_flush(&cursor);
+    return SUCCESS != status ? status : flushed;
+}
+
+/**
+ *      @detail In code set C each pair of digits is a single byte of its value. Elsewhere
+ *              characters are written as themselves, except for ESCPOS_CODE_PREFIX which is
+ *              doubled.
+ */
+static int escpos_data(const Code128 * code, char * data, int * len) {
+    int            values[C128_MAX_PATTERN_SIZE];
+    int            num_values;
+    Code128CodeSet set;
+    int            status = printer_values(code, &set, values, &num_values);
+    if (SUCCESS != status) {
+        return status;
+    }
+
+    int n     = 0;
+    data[n++] = ESCPOS_CODE_PREFIX;
+    data[n++] = 'A' + set;
+
+    Code128CodeSet shifted = Invalid;
+    for (int i = 0; i < num_values; i++) {
+        Code128CodeSet current = Invalid != shifted ? shifted : set;
+        int            value   = values[i];
+        shifted                = Invalid;
+
+        if (C == current && value < CCodeB) {
+            data[n++] = value;
+        } else if (C != current && value < AFNC3) {
+            data[n++] = printer_char(current, value);
+            if (ESCPOS_CODE_PREFIX == data[n - 1]) {
+                data[n++] = ESCPOS_CODE_PREFIX;
+            }
+        } else {
+            data[n++] = ESCPOS_CODE_PREFIX;
+            data[n++] = ESCPOS_FUNCTIONS[current][value - AFNC3];
+        }
+
+        if (C != current && AShiftB == value) {
+            shifted = A == current ? B : A;
+        }
+        Code128CodeSet next = printer_switch(current, value);
+        if (Invalid != next) {
+            set = next;
+        }
+    }
+
+    *len = n;
+    return SUCCESS;
+}
+
+/**
+ *      @brief Clamps a length in dots to the range of a one-byte ESC/POS parameter.
+ */
+static uchar escpos_dots(int dots, int min) {
+    return dots < min ? min : dots > ESCPOS_MAX_DOTS ? ESCPOS_MAX_DOTS : dots;
+}
+
+int c128_escpos_write(Code128 **           codes,
+                      int                  num_codes,
+                      Cursor *             dest,
+                      const PSProperties * props,
+                      int                  dpi) {
+    if (dpi < 1) {
+        return ERR_ARGUMENT;
+    }
+
+    int   margin  = raster_pixels(props->lmargin, props, dpi);
+    int   module  = raster_module_pixels(props, dpi);
+    uchar setup[] = {ESCPOS_GS,
+                    'h',
+                    escpos_dots(raster_pixels(props->bar_height, props, dpi), 1),
+                    ESCPOS_GS,
+                    'w',
+                    module < ESCPOS_MIN_MODULE   ? ESCPOS_MIN_MODULE
+                    : module > ESCPOS_MAX_MODULE ? ESCPOS_MAX_MODULE
+                                                 : module,
+                    ESCPOS_GS,
+                    'H',
+                    ESCPOS_HRI_BELOW,
+                    ESCPOS_GS,
+                    'L',
+                    margin & 0xFF,
+                    (margin >> 8) & 0xFF};
+    uchar feed[] = {ESCPOS_ESC, 'J', escpos_dots(raster_pixels(props->padding, props, dpi), 0)};
+
+    cursor_puts(dest, ESCPOS_INIT);
+    cursor_write(dest, (const char *) setup, sizeof setup);
+    for (int i = 0; i < num_codes; i++) {
+        // The data is at most two bytes per symbol, so always fits in one command
+        char data[2 * C128_MAX_PATTERN_SIZE];
+        int  len;
+        int  status = escpos_data(codes[i], data, &len);
+        if (SUCCESS != status) {
+            return status;
+        }
+
+        uchar command[] = {ESCPOS_GS, 'k', ESCPOS_CODE128, len};
+        cursor_write(dest, (const char *) command, sizeof command);
+        cursor_write(dest, data, len);
+        if (feed[2] > 0) {
+            cursor_write(dest, (const char *) feed, sizeof feed);
+        }
+    }
+    return dest->status;
+}
+
+int c128_escpos_stream(Code128 **           codes,
+                       int                  num_codes,
+                       const Sink *         sink,
+                       const PSProperties * props,
+                       int                  dpi) {
+    char   buf[CURSOR_SINK_BUFSIZE];
+    Cursor cursor;
+    cursor_init_sink(&cursor, buf, sizeof buf, sink);
+
+    int status  = c128_escpos_write(codes, num_codes, &cursor, props, dpi);
+    int flushed = cursor_flush(&cursor);
+    return SUCCESS != status ? status : flushed;
+}
+
+int c128_escpos_raster(Code128 **           codes,
+                       int                  num_codes,
+                       const Sink *         sink,
+                       const PSProperties * props,
+                       Layout *             layout,
+                       int                  dpi,
+                       int                  threads) {
+    int per_page = layout->cols * layout->rows;
+    if (per_page == 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    int status = sink->write(sink->ctx, ESCPOS_INIT, strlen(ESCPOS_INIT));
+    int pages  = c128_ps_num_pages(num_codes, layout);
+    for (int page = 0; page < pages && SUCCESS == status; page++) {
+        int first = page * per_page;
+        int count = num_codes - first < per_page ? num_codes - first : per_page;
+        status    = c128_raster_layout(
+            codes + first, count, sink, props, layout, dpi, RASTER_ESCPOS, threads);
+    }
+    return status;
+}
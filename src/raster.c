@@ -0,0 +1,229 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file raster.c
+ *      @brief Definitions for rendering barcodes to 1-bit bitmaps and writing them as PBM or PNG.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/raster.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+#include "barcode/util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int raster_pixels(float length, const PSProperties * props, int dpi) {
+    double pixels = length * ps_unit_points(props->units) * dpi / RASTER_POINTS_PER_INCH;
+    return (int) (pixels + (pixels < 0 ? -0.5 : 0.5));
+}
+
+int raster_module_pixels(const PSProperties * props, int dpi) {
+    int module_px = raster_pixels(props->bar_width, props, dpi);
+    return module_px > 0 ? module_px : 1;
+}
+
+void bitmap_span(uchar * row, int from, int to) {
+    if (from >= to) {
+        return;
+    }
+
+    int   first = from / 8;
+    int   last  = (to - 1) / 8;
+    uchar head  = 0xFF >> (from % 8);
+    uchar tail  = 0xFF << (7 - (to - 1) % 8);
+    if (first == last) {
+        row[first] |= head & tail;
+        return;
+    }
+
+    row[first] |= head;
+    memset(row + first + 1, 0xFF, last - first - 1);
+    row[last] |= tail;
+}
+
+/**
+ *      @detail The modules are packed by c128_modules() and each run of black modules becomes a
+ *              single span. As modules are a whole number of pixels wide, no bar edge needs to be
+ *              anti-aliased or rounded.
+ */
+int c128_raster_row(Code128 * code, int module_px, int x, uchar * row, int * width) {
+    uchar modules[C128_MAX_MODULE_BYTES];
+    int   num_modules;
+    int   status = c128_modules(code, modules, &num_modules);
+    if (SUCCESS != status) {
+        return status;
+    }
+
+    int left = x + C128_QUIET_WIDTH * module_px;
+    int i    = 0;
+    while (i < num_modules) {
+        if (((modules[i / 8] >> (7 - i % 8)) & 1) != Black) {
+            i++;
+            continue;
+        }
+
+        int run = 1;
+        while (i + run < num_modules && ((modules[(i + run) / 8] >> (7 - (i + run) % 8)) & 1)) {
+            run++;
+        }
+        bitmap_span(row, left + i * module_px, left + (i + run) * module_px);
+        i += run;
+    }
+
+    *width = (num_modules + 2 * C128_QUIET_WIDTH) * module_px;
+    return SUCCESS;
+}
+
+int c128_raster(Code128 * code, const PSProperties * props, int dpi, Bitmap * dest) {
+    if (code->datalen > C128_MAX_PATTERN_SIZE) {
+        return ERR_DATA_LENGTH;
+    }
+
+    int module_px = raster_module_pixels(props, dpi);
+    int height    = raster_pixels(props->bar_height, props, dpi);
+    int modules   = C128_DATA_WIDTH * (code->datalen - 1) + C128_STOP_WIDTH;
+
+    dest->width  = (modules + 2 * C128_QUIET_WIDTH) * module_px;
+    dest->height = height > 0 ? height : 1;
+    dest->stride = CEILDIV(dest->width, 8);
+
+    size_t size = (size_t) dest->stride * dest->height;
+    dest->bits  = barcode_calloc(1, size);
+    VERIFY_NULL(dest->bits, size);
+
+    int width;
+    c128_raster_row(code, module_px, 0, dest->bits, &width);
+    for (int y = 1; y < dest->height; y++) {
+        memcpy(dest->bits + (size_t) y * dest->stride, dest->bits, dest->stride);
+    }
+    return SUCCESS;
+}
+
+void bitmap_free(Bitmap * bitmap) {
+    barcode_free(bitmap->bits);
+    bitmap->bits = NULL;
+}
+
+int bitmap_pbm(const Bitmap * bitmap, const Sink * sink) {
+    char header[PBM_HEADER_BUFSIZE];
+    int  len    = snprintf(header, sizeof header, PBM_HEADER, bitmap->width, bitmap->height);
+    int  status = sink->write(sink->ctx, header, len);
+    if (SUCCESS != status) {
+        return status;
+    }
+    size_t size = (size_t) bitmap->stride * bitmap->height;
+    return sink->write(sink->ctx, (const char *) bitmap->bits, size);
+}
+
+static void put_be32(uchar * dest, uint32_t value) {
+    dest[0] = value >> 24;
+    dest[1] = value >> 16;
+    dest[2] = value >> 8;
+    dest[3] = value;
+}
+
+/**
+ *      @detail A chunk is its length, type, data and the CRC-32 of its type and data, with every
+ *              number big-endian.
+ */
+static void png_chunk(PngWriter * png, const char * type, const uchar * data, size_t len) {
+    if (SUCCESS != png->status) {
+        return;
+    }
+
+    uchar    header[8];
+    uchar    trailer[4];
+    uint32_t crc = deflate_crc32(png->crc_table, 0, (const uint8_t *) type, 4);
+    crc          = deflate_crc32(png->crc_table, crc, data, len);
+    put_be32(header, len);
+    memcpy(header + 4, type, 4);
+    put_be32(trailer, crc);
+
+    const Sink * out = png->out;
+    png->status      = out->write(out->ctx, (const char *) header, sizeof header);
+    if (SUCCESS == png->status && len > 0) {
+        png->status = out->write(out->ctx, (const char *) data, len);
+    }
+    if (SUCCESS == png->status) {
+        png->status = out->write(out->ctx, (const char *) trailer, sizeof trailer);
+    }
+}
+
+/**
+ *      @brief Writes whatever compressed data has built up as an IDAT chunk.
+ */
+static void png_flush(PngWriter * png) {
+    if (png->idat.len > 0) {
+        png_chunk(png, "IDAT", (const uchar *) png->idat.buf, png->idat.len);
+        png->idat.len = 0;
+    }
+}
+
+int png_begin(PngWriter * png, const Sink * sink, int width, int height, int level) {
+    png->out    = sink;
+    png->width  = width;
+    png->stride = CEILDIV(width, 8);
+    png->row    = barcode_malloc(png->stride + 1);
+    VERIFY_NULL(png->row, png->stride + 1);
+    deflate_crc_table(png->crc_table);
+    sink_memory(&png->idat_sink, &png->idat);
+    png->status = sink_zlib(&png->deflate, &png->zlib, &png->idat_sink, level);
+
+    if (SUCCESS == png->status) {
+        png->status = sink->write(sink->ctx, PNG_SIGNATURE, PNG_SIGNATURE_SIZE);
+    }
+
+    uchar ihdr[PNG_IHDR_SIZE] = {0};
+    put_be32(ihdr, width);
+    put_be32(ihdr + 4, height);
+    ihdr[8] = PNG_BIT_DEPTH;
+    ihdr[9] = PNG_COLOUR_GREY;
+    png_chunk(png, "IHDR", ihdr, sizeof ihdr);
+    return png->status;
+}
+
+/**
+ *      @detail PNG greyscale has 0 as black, the opposite of a Bitmap, so each row is inverted
+ *              into a buffer after its filter type before being compressed.
+ */
+int png_rows(PngWriter * png, const uchar * rows, int stride, int count) {
+    png->row[0] = PNG_FILTER_NONE;
+    for (int y = 0; y < count && SUCCESS == png->status; y++) {
+        const uchar * row = rows + (size_t) y * stride;
+        for (int i = 0; i < png->stride; i++) {
+            png->row[i + 1] = ~row[i];
+        }
+        png->status = png->deflate.write(png->deflate.ctx, (char *) png->row, png->stride + 1);
+    }
+    png_flush(png);
+    return png->status;
+}
+
+int png_end(PngWriter * png) {
+    int status = sink_gzip_finish(png->zlib);
+    if (SUCCESS == png->status) {
+        png->status = status;
+    }
+    png_flush(png);
+    png_chunk(png, "IEND", NULL, 0);
+
+    barcode_free(png->idat.buf);
+    barcode_free(png->row);
+    return png->status;
+}
+
+int bitmap_png(const Bitmap * bitmap, const Sink * sink, int level) {
+    PngWriter png;
+    png_begin(&png, sink, bitmap->width, bitmap->height, level);
+    png_rows(&png, bitmap->bits, bitmap->stride, bitmap->height);
+    return png_end(&png);
+}
@@ -0,0 +1,137 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file sheet.c
+ *      @brief Definitions of sheet functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/sheet.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void render_cell(Sheet * sheet, int cell, Cursor * dest) {
+    c128_ps_cell_position(cell, dest, &sheet->cache.props, &sheet->layout);
+    if (NULL != sheet->codes[cell]) {
+        c128_ps_cached(sheet->codes[cell], dest, &sheet->cache);
+    }
+}
+
+static void render_sheet(Sheet * sheet, Cursor * dest) {
+    c128_ps_header(dest, &sheet->cache.props);
+    for (int i = 0; i < sheet->cells; i++) {
+        sheet->offsets[i] = dest->pos;
+        render_cell(sheet, i, dest);
+    }
+    sheet->offsets[sheet->cells] = dest->pos;
+    c128_ps_footer(dest);
+}
+
+/**
+ *      @detail The cell is rendered into the scratch buffer, then the rest of the document is moved
+ *              along to make exactly enough room for it and the offsets of later cells adjusted.
+ */
+static int splice_cell(Sheet * sheet, int cell) {
+    Cursor * scratch = &sheet->scratch;
+    Cursor * doc     = &sheet->doc;
+
+    scratch->pos = 0;
+    render_cell(sheet, cell, scratch);
+    if (CURSOR_OVERFLOWED(scratch)) {
+        cursor_grow(scratch, scratch->pos);
+        render_cell(sheet, cell, scratch);
+    }
+
+    size_t start   = sheet->offsets[cell];
+    size_t end     = sheet->offsets[cell + 1];
+    size_t new_end = start + scratch->pos;
+    size_t size    = doc->pos - (end - start) + scratch->pos;
+
+    if (size > doc->cap) {
+        size_t pos = doc->pos;
+        // Leave room for the cell to grow a little more before moving the buffer again
+        cursor_grow(doc, size + size / 2);
+        doc->pos = pos;
+    }
+
+    memmove(doc->buf + new_end, doc->buf + end, doc->pos - end);
+    memcpy(doc->buf + start, scratch->buf, scratch->pos);
+    doc->pos = size;
+
+    for (int i = cell + 1; i <= sheet->cells; i++) {
+        sheet->offsets[i] = sheet->offsets[i] - end + new_end;
+    }
+    return SUCCESS;
+}
+
+int c128_sheet_init(Sheet * sheet, const PSProperties * props, Layout * layout) {
+    int cells = layout->rows * layout->cols;
+    if (cells <= 0) {
+        return ERR_INVALID_LAYOUT;
+    }
+
+    sheet->layout = *layout;
+    sheet->cells  = cells;
+
+    sheet->codes = barcode_calloc(cells, sizeof *sheet->codes);
+    VERIFY_NULL(sheet->codes, sizeof *sheet->codes * cells);
+
+    size_t offsets_size = sizeof *sheet->offsets * (cells + 1);
+    sheet->offsets      = barcode_malloc(offsets_size);
+    VERIFY_NULL(sheet->offsets, offsets_size);
+
+    c128_cache_init(&sheet->cache, props);
+    cursor_init(&sheet->scratch, NULL, 0);
+
+    cursor_init(&sheet->doc, NULL, 0);
+    render_sheet(sheet, &sheet->doc);
+    cursor_grow(&sheet->doc, sheet->doc.pos);
+    render_sheet(sheet, &sheet->doc);
+
+    return SUCCESS;
+}
+
+void c128_sheet_free(Sheet * sheet) {
+    for (int i = 0; i < sheet->cells; i++) {
+        c128_free(sheet->codes[i]);
+    }
+    barcode_free(sheet->codes);
+    barcode_free(sheet->offsets);
+    barcode_free(sheet->doc.buf);
+    barcode_free(sheet->scratch.buf);
+    c128_cache_free(&sheet->cache);
+}
+
+int c128_sheet_set(Sheet * sheet, int cell, uchar * data, int data_len) {
+    if (cell < 0 || cell >= sheet->cells) {
+        return ERR_ARGUMENT;
+    }
+
+    Code128 * code = NULL;
+    if (NULL != data && data_len > 0) {
+        int status = c128_encode(data, data_len, &code);
+        if (SUCCESS != status) {
+            return status;
+        }
+    }
+
+    c128_free(sheet->codes[cell]);
+    sheet->codes[cell] = code;
+    return splice_cell(sheet, cell);
+}
+
+const char * c128_sheet_str(Sheet * sheet, size_t * len) {
+    if (NULL != len) {
+        *len = sheet->doc.pos;
+    }
+    return cursor_str(&sheet->doc);
+}
@@ -0,0 +1,91 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file sink.c
+ *      @brief Definitions of the built-in output sinks.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/sink.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+static int file_write(void * ctx, const char * data, size_t len) {
+    return fwrite(data, 1, len, (FILE *) ctx) == len ? SUCCESS : ERR_IO;
+}
+
+static int fd_write(void * ctx, const char * data, size_t len) {
+    int fd = (int) (intptr_t) ctx;
+    while (len > 0) {
+        long written = write(fd, data, len);
+        if (written < 0 && EINTR == errno) {
+            continue;
+        }
+        if (written <= 0) {
+            return ERR_IO;
+        }
+        data += written;
+        len -= written;
+    }
+    return SUCCESS;
+}
+
+/**
+ *      @detail The buffer at least doubles whenever it grows, so output is copied a constant number
+ *              of times on average. One byte is kept spare for a null terminator.
+ */
+static int memory_write(void * ctx, const char * data, size_t len) {
+    MemorySink * mem = ctx;
+    if (len + 1 > mem->cap - mem->len) {
+        size_t cap = mem->cap < SINK_MEMORY_BUFSIZE ? SINK_MEMORY_BUFSIZE : mem->cap;
+        while (len + 1 > cap - mem->len) {
+            cap *= 2;
+        }
+
+        char * buf = barcode_realloc(mem->buf, cap);
+        VERIFY_NULL(buf, cap);
+        mem->buf = buf;
+        mem->cap = cap;
+    }
+
+    memcpy(mem->buf + mem->len, data, len);
+    mem->len += len;
+    mem->buf[mem->len] = '\0';
+    return SUCCESS;
+}
+
+void sink_file(Sink * sink, FILE * file) {
+    sink->write = file_write;
+    sink->ctx   = file;
+}
+
+void sink_fd(Sink * sink, int fd) {
+    sink->write = fd_write;
+    sink->ctx   = (void *) (intptr_t) fd;
+}
+
+void sink_memory(Sink * sink, MemorySink * mem) {
+    mem->buf    = NULL;
+    mem->len    = 0;
+    mem->cap    = 0;
+    sink->write = memory_write;
+    sink->ctx   = mem;
+}
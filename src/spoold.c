@@ -0,0 +1,478 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file spoold.c
+ *      @brief The @c spoold daemon, which collects labels from local clients onto shared sheets.
+ *      @detail Usage: <tt>spoold [-s socket] [-d directory | -p printer] [-r rows] [-c columns]
+ *              [-t milliseconds]</tt>
+ *
+ *              Clients connect to the Unix domain socket (@c spoold.sock by default) and send one
+ *              label per line. Labels from every client are encoded onto the cells of one sheet in
+ *              the order they arrive, and the sheet is printed as soon as it is full, or @c -t
+ *              milliseconds after its first label if it is not. Each sheet is rendered as by
+ *              c128_ps_layout() with a render context, so the symbols and PostScript header are
+ *              rendered once for the life of the daemon, and written either to a file of its own in
+ *              the spool directory (@c spool by default), which appears whole once it is complete,
+ *              or appended to the printer, such as a device or a FIFO.
+ *
+ *              Once a label's sheet has been written, its client is sent <tt>ok sheet cell</tt>, or
+ *              <tt>error code</tt> if the label could not be encoded or the sheet written, with the
+ *              error codes of errors.h. On SIGINT or SIGTERM the daemon prints the sheet it has
+ *              started and exits.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define USAGE                                                                                      \
+    "usage: spoold [-s socket] [-d directory | -p printer] [-r rows] [-c columns] "                \
+    "[-t milliseconds]\n"
+#define SPOOL_DEFAULT_SOCKET "spoold.sock"
+#define SPOOL_DEFAULT_DIR "spool"
+#define SPOOL_DEFAULT_LINGER_MS 50
+#define SPOOL_DEFAULT_ROWS 9
+#define SPOOL_DEFAULT_COLS 2
+/*      @brief Maximum number of clients connected at once, beyond which connections are refused */
+#define SPOOL_MAX_CLIENTS 64
+/*      @brief Maximum number of cells on a sheet */
+#define SPOOL_MAX_CELLS 4096
+/*      @brief Maximum linger time, in milliseconds */
+#define SPOOL_MAX_LINGER_MS 60000
+/*      @brief Size of a client's line buffer; longer lines are rejected */
+#define SPOOL_LINE_MAX 128
+/*      @brief Maximum length of a reply, such as "ok 123 4\n" */
+#define SPOOL_REPLY_MAX 48
+#define SPOOL_PATH_MAX 4096
+#define NS_PER_MS 1000000LL
+#define NS_PER_SEC 1000000000LL
+
+/**
+ *      @brief A connected client and the part of a line it has sent so far.
+ */
+typedef struct SpoolClient Client;
+
+/**
+ *      @brief The state of the daemon: its clients and the sheet being filled.
+ */
+typedef struct Spooler Spooler;
+
+struct SpoolClient {
+    int    fd;
+    char   line[SPOOL_LINE_MAX];
+    size_t len;
+    bool   overlong; /**< Whether the current line is too long and is being discarded */
+};
+
+struct Spooler {
+    BarcodeCtx   ctx;
+    Layout       layout;
+    int          cells;    /**< Number of cells on a sheet */
+    Code128 *    codes;    /**< The barcode of each cell, with their patterns after them */
+    Code128 **   sheet;    /**< Pointers to @c codes, as c128_ps_layout() takes them */
+    int *        owners;   /**< The socket of the client that sent each cell, or -1 */
+    int          filled;   /**< Number of cells filled on the current sheet */
+    long long    deadline; /**< When the current sheet is printed if it is not yet full */
+    long long    linger;   /**< How long a sheet waits for more labels, in nanoseconds */
+    const char * dir;
+    int          printer;  /**< Descriptor of the printer, or -1 to write to @c dir */
+    long long    started;  /**< Start time in seconds, which names the spool files */
+    int          sheets;   /**< Number of sheets printed */
+    long         labels;   /**< Number of labels printed */
+    Client       clients[SPOOL_MAX_CLIENTS];
+    int          num_clients;
+};
+
+static volatile sig_atomic_t stopping;
+
+static void on_signal(int sig) {
+    (void) sig;
+    stopping = 1;
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ *      @detail Replies are small and best-effort: a client that is not reading is not waited for.
+ */
+static void reply(int fd, const char * text) {
+    if (fd >= 0) {
+        send(fd, text, strlen(text), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+}
+
+/**
+ *      @detail The sheet is written under a hidden name and renamed into place once complete, so
+ *              whatever collects sheets from the spool directory never sees part of one.
+ */
+static int spool_file(Spooler * spooler, const char * doc, size_t len) {
+    const char * dir = spooler->dir;
+    char         path[SPOOL_PATH_MAX];
+    char         tmp[SPOOL_PATH_MAX];
+    int n = snprintf(path, sizeof path, "%s/%lld-%06d.ps", dir, spooler->started, spooler->sheets);
+    int m = snprintf(tmp, sizeof tmp, "%s/.%lld-%06d.ps", dir, spooler->started, spooler->sheets);
+    if (n < 0 || m < 0 || n >= (int) sizeof path || m >= (int) sizeof tmp) {
+        return ERR_ARGUMENT;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return ERR_IO;
+    }
+    Sink sink;
+    sink_fd(&sink, fd);
+    int status = sink.write(sink.ctx, doc, len);
+    if (0 != close(fd) || (SUCCESS == status && 0 != rename(tmp, path))) {
+        status = ERR_IO;
+    }
+    if (SUCCESS != status) {
+        unlink(tmp);
+    }
+    return status;
+}
+
+/**
+ *      @detail Renders the cells filled so far, writes the sheet out and tells each client where
+ *              its labels were printed.
+ */
+static int spool_flush(Spooler * spooler) {
+    if (0 == spooler->filled) {
+        return SUCCESS;
+    }
+
+    const char * doc;
+    size_t       len;
+    int          status = barcode_ctx_ps_layout(
+        &spooler->ctx, spooler->sheet, spooler->filled, &spooler->layout, &doc, &len);
+    if (SUCCESS == status && spooler->printer >= 0) {
+        Sink sink;
+        sink_fd(&sink, spooler->printer);
+        status = sink.write(sink.ctx, doc, len);
+    } else if (SUCCESS == status) {
+        status = spool_file(spooler, doc, len);
+    }
+
+    for (int i = 0; i < spooler->filled; i++) {
+        char text[SPOOL_REPLY_MAX];
+        if (SUCCESS == status) {
+            snprintf(text, sizeof text, "ok %d %d\n", spooler->sheets, i);
+        } else {
+            snprintf(text, sizeof text, "error %d\n", status);
+        }
+        reply(spooler->owners[i], text);
+    }
+
+    if (SUCCESS == status) {
+        spooler->sheets++;
+        spooler->labels += spooler->filled;
+    } else {
+        fprintf(stderr, "spoold: could not print sheet %d: error %d\n", spooler->sheets, status);
+    }
+    spooler->filled = 0;
+    return status;
+}
+
+/**
+ *      @detail Labels are encoded straight into the next cell, which only counts as filled if
+ *              encoding succeeds.
+ */
+static void spool_label(Spooler * spooler, int fd, char * line, size_t len) {
+    int cell   = spooler->filled;
+    int status = len > C128_MAX_DATA_LEN ? ERR_DATA_LENGTH : SUCCESS;
+    if (SUCCESS == status) {
+        status = c128_encode_into((uchar *) line, (int) len, spooler->sheet[cell]);
+    }
+    if (SUCCESS != status) {
+        char text[SPOOL_REPLY_MAX];
+        snprintf(text, sizeof text, "error %d\n", status);
+        reply(fd, text);
+        return;
+    }
+
+    if (0 == cell) {
+        spooler->deadline = now_ns() + spooler->linger;
+    }
+    spooler->owners[cell] = fd;
+    if (++spooler->filled == spooler->cells) {
+        spool_flush(spooler);
+    }
+}
+
+static void client_close(Spooler * spooler, int index) {
+    Client * client = &spooler->clients[index];
+    for (int i = 0; i < spooler->filled; i++) {
+        if (spooler->owners[i] == client->fd) {
+            spooler->owners[i] = -1;
+        }
+    }
+    close(client->fd);
+    *client = spooler->clients[--spooler->num_clients];
+}
+
+/**
+ *      @detail Reads what the client has sent and spools each complete line, ignoring a carriage
+ *              return before the newline and empty lines.
+ *      @return false if the client has disconnected
+ */
+static bool client_read(Spooler * spooler, Client * client) {
+    char    buf[SPOOL_LINE_MAX * 4];
+    ssize_t n = recv(client->fd, buf, sizeof buf, MSG_DONTWAIT);
+    if (n < 0) {
+        return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+    }
+    if (0 == n) {
+        return false;
+    }
+
+    for (ssize_t i = 0; i < n; i++) {
+        if ('\n' != buf[i]) {
+            if (client->len < SPOOL_LINE_MAX) {
+                client->line[client->len++] = buf[i];
+            } else {
+                client->overlong = true;
+            }
+            continue;
+        }
+
+        size_t len = client->len;
+        if (len > 0 && '\r' == client->line[len - 1]) {
+            len--;
+        }
+        if (client->overlong) {
+            char text[SPOOL_REPLY_MAX];
+            snprintf(text, sizeof text, "error %d\n", ERR_DATA_LENGTH);
+            reply(client->fd, text);
+        } else if (len > 0) {
+            spool_label(spooler, client->fd, client->line, len);
+        }
+        client->len      = 0;
+        client->overlong = false;
+    }
+    return true;
+}
+
+static void client_accept(Spooler * spooler, int listener) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    if (spooler->num_clients == SPOOL_MAX_CLIENTS) {
+        close(fd);
+        return;
+    }
+    spooler->clients[spooler->num_clients++] = (Client){.fd = fd};
+}
+
+static int spooler_init(Spooler * spooler, Layout * layout, int linger_ms) {
+    unsigned long long area = (unsigned long long) layout->rows * layout->cols;
+    if (0 == area || area > SPOOL_MAX_CELLS) {
+        return ERR_INVALID_LAYOUT;
+    }
+    int cells = (int) area;
+
+    barcode_ctx_init(&spooler->ctx, &PS_DEFAULT_PROPS);
+    spooler->layout      = *layout;
+    spooler->cells       = cells;
+    spooler->filled      = 0;
+    spooler->linger      = linger_ms * NS_PER_MS;
+    spooler->started     = time(NULL);
+    spooler->sheets      = 0;
+    spooler->labels      = 0;
+    spooler->num_clients = 0;
+
+    size_t codes_size = (sizeof(Code128) + sizeof(pattern) * C128_MAX_PATTERN_SIZE) * cells;
+    spooler->codes    = barcode_malloc(codes_size);
+    spooler->sheet    = barcode_malloc(sizeof *spooler->sheet * cells);
+    spooler->owners   = barcode_malloc(sizeof *spooler->owners * cells);
+    VERIFY_NULL(spooler->codes, codes_size);
+    VERIFY_NULL(spooler->sheet, sizeof *spooler->sheet * cells);
+    VERIFY_NULL(spooler->owners, sizeof *spooler->owners * cells);
+
+    pattern * patterns = (pattern *) (spooler->codes + cells);
+    for (int i = 0; i < cells; i++) {
+        spooler->codes[i].data = patterns + i * C128_MAX_PATTERN_SIZE;
+        spooler->sheet[i]      = &spooler->codes[i];
+    }
+    return SUCCESS;
+}
+
+static void spooler_free(Spooler * spooler) {
+    for (int i = spooler->num_clients - 1; i >= 0; i--) {
+        client_close(spooler, i);
+    }
+    barcode_free(spooler->codes);
+    barcode_free(spooler->sheet);
+    barcode_free(spooler->owners);
+    barcode_ctx_free(&spooler->ctx);
+}
+
+static int parse_int(const char * arg, int min, int max, int * dest) {
+    char * end;
+    long   value = strtol(arg, &end, 10);
+    if (end == arg || '\0' != *end || value < min || value > max) {
+        return ERR_ARGUMENT;
+    }
+    *dest = (int) value;
+    return SUCCESS;
+}
+
+static int listen_unix(const char * path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof addr.sun_path) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (0 != bind(fd, (struct sockaddr *) &addr, sizeof addr)) {
+        close(fd);
+        return -1;
+    }
+    if (0 != listen(fd, SOMAXCONN)) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ *      @detail Waits for connections and labels, or until the current sheet's deadline, whichever
+ *              comes first.
+ */
+static void spooler_run(Spooler * spooler, int listener) {
+    struct pollfd fds[SPOOL_MAX_CLIENTS + 1];
+    while (!stopping) {
+        fds[0] = (struct pollfd){.fd = listener, .events = POLLIN};
+        for (int i = 0; i < spooler->num_clients; i++) {
+            fds[i + 1] = (struct pollfd){.fd = spooler->clients[i].fd, .events = POLLIN};
+        }
+
+        int timeout = -1;
+        if (spooler->filled > 0) {
+            long long wait = spooler->deadline - now_ns();
+            timeout        = wait > 0 ? (int) ((wait + NS_PER_MS - 1) / NS_PER_MS) : 0;
+        }
+
+        int num_fds = spooler->num_clients + 1;
+        int ready   = poll(fds, num_fds, timeout);
+        if (ready < 0 && EINTR != errno) {
+            perror("poll");
+            break;
+        }
+
+        // Clients are read in reverse, as closing one moves the last client into its place
+        for (int i = num_fds - 1; i >= 1 && ready > 0; i--) {
+            if (fds[i].revents && !client_read(spooler, &spooler->clients[i - 1])) {
+                client_close(spooler, i - 1);
+            }
+        }
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            client_accept(spooler, listener);
+        }
+        if (spooler->filled > 0 && now_ns() >= spooler->deadline) {
+            spool_flush(spooler);
+        }
+    }
+    spool_flush(spooler);
+}
+
+int main(int argc, char ** argv) {
+    const char * socket_path = SPOOL_DEFAULT_SOCKET;
+    const char * dir         = SPOOL_DEFAULT_DIR;
+    const char * printer     = NULL;
+    Layout       layout      = {.rows = SPOOL_DEFAULT_ROWS, .cols = SPOOL_DEFAULT_COLS};
+    int          rows        = SPOOL_DEFAULT_ROWS;
+    int          cols        = SPOOL_DEFAULT_COLS;
+    int          linger_ms   = SPOOL_DEFAULT_LINGER_MS;
+
+    int opt;
+    int status = SUCCESS;
+    while (SUCCESS == status && -1 != (opt = getopt(argc, argv, "s:d:p:r:c:t:"))) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            case 'd': dir = optarg; break;
+            case 'p': printer = optarg; break;
+            case 'r': status = parse_int(optarg, 1, SPOOL_MAX_CELLS, &rows); break;
+            case 'c': status = parse_int(optarg, 1, SPOOL_MAX_CELLS, &cols); break;
+            case 't': status = parse_int(optarg, 0, SPOOL_MAX_LINGER_MS, &linger_ms); break;
+            default: status = ERR_ARGUMENT; break;
+        }
+    }
+
+    init_barcode();
+    Spooler spooler;
+    spooler.dir = dir;
+    layout.rows = rows;
+    layout.cols = cols;
+    if (SUCCESS != status || optind != argc ||
+        SUCCESS != spooler_init(&spooler, &layout, linger_ms)) {
+        fputs(USAGE, stderr);
+        return EXIT_FAILURE;
+    }
+
+    // The destination is opened first, so a failure leaves no socket bound
+    spooler.printer = printer ? open(printer, O_WRONLY | O_APPEND | O_CREAT, 0644) : -1;
+    if ((printer && spooler.printer < 0) ||
+        (!printer && 0 != mkdir(dir, 0755) && EEXIST != errno)) {
+        perror(printer ? printer : dir);
+        spooler_free(&spooler);
+        return EXIT_FAILURE;
+    }
+    int listener = listen_unix(socket_path);
+    if (listener < 0) {
+        perror(socket_path);
+        if (spooler.printer >= 0) {
+            close(spooler.printer);
+        }
+        spooler_free(&spooler);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction action = {.sa_handler = on_signal};
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    spooler_run(&spooler, listener);
+
+    close(listener);
+    unlink(socket_path);
+    if (spooler.printer >= 0) {
+        close(spooler.printer);
+    }
+    fprintf(stderr,
+            "spoold: %ld labels on %d sheets, %.1f%% of cells used\n",
+            spooler.labels,
+            spooler.sheets,
+            spooler.sheets ? 100.0 * spooler.labels / ((double) spooler.sheets * spooler.cells)
+                           : 0.0);
+    spooler_free(&spooler);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file stats.c
+ *      @brief Definitions of stage instrumentation functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/stats.h"
+
+#include "barcode/errors.h"
+#include "barcode/util.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef BARCODE_STATS
+#include <stdatomic.h>
+#endif
+
+#define NS_PER_SEC 1000000000LL
+
+static const char * stage_names[STAGE_COUNT] = {"encode", "strrepr", "svg", "ps", "ps_layout"};
+
+#ifdef BARCODE_STATS
+/**
+ *      @detail The totals are only touched when a thread publishes or a snapshot is taken, so
+ *              recording a call costs a few additions to the thread's own counters.
+ */
+static THREAD_LOCAL StatsSnapshot thread_stats;
+
+static struct {
+    _Atomic unsigned long long calls, ns, bytes, errors;
+} totals[STAGE_COUNT];
+#endif
+
+bool barcode_stats_enabled(void) {
+#ifdef BARCODE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+long long barcode_stats_clock(void) {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+void barcode_stats_record(Stage stage, const StageTimer * timer, size_t bytes, int status) {
+#ifdef BARCODE_STATS
+    StageStats * counters = &thread_stats.stages[stage];
+    counters->calls++;
+    counters->ns += barcode_stats_clock() - timer->start;
+    counters->bytes += bytes - timer->bytes;
+    counters->errors += SUCCESS != status;
+#else
+    (void) stage;
+    (void) timer;
+    (void) bytes;
+    (void) status;
+#endif
+}
+
+void barcode_stats_thread(StatsSnapshot * dest) {
+#ifdef BARCODE_STATS
+    *dest = thread_stats;
+#else
+    memset(dest, 0, sizeof *dest);
+#endif
+}
+
+void barcode_stats_publish(void) {
+#ifdef BARCODE_STATS
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageStats * counters = &thread_stats.stages[i];
+        atomic_fetch_add_explicit(&totals[i].calls, counters->calls, memory_order_relaxed);
+        atomic_fetch_add_explicit(&totals[i].ns, counters->ns, memory_order_relaxed);
+        atomic_fetch_add_explicit(&totals[i].bytes, counters->bytes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&totals[i].errors, counters->errors, memory_order_relaxed);
+    }
+    memset(&thread_stats, 0, sizeof thread_stats);
+#endif
+}
+
+void barcode_stats_snapshot(StatsSnapshot * dest) {
+    barcode_stats_thread(dest);
+#ifdef BARCODE_STATS
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageStats * counters = &dest->stages[i];
+        counters->calls += atomic_load_explicit(&totals[i].calls, memory_order_relaxed);
+        counters->ns += atomic_load_explicit(&totals[i].ns, memory_order_relaxed);
+        counters->bytes += atomic_load_explicit(&totals[i].bytes, memory_order_relaxed);
+        counters->errors += atomic_load_explicit(&totals[i].errors, memory_order_relaxed);
+    }
+#endif
+}
+
+void barcode_stats_reset(void) {
+#ifdef BARCODE_STATS
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        atomic_store_explicit(&totals[i].calls, 0, memory_order_relaxed);
+        atomic_store_explicit(&totals[i].ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&totals[i].bytes, 0, memory_order_relaxed);
+        atomic_store_explicit(&totals[i].errors, 0, memory_order_relaxed);
+    }
+    memset(&thread_stats, 0, sizeof thread_stats);
+#endif
+}
+
+void barcode_stats_add(StatsSnapshot * total, const StatsSnapshot * add) {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        total->stages[i].calls += add->stages[i].calls;
+        total->stages[i].ns += add->stages[i].ns;
+        total->stages[i].bytes += add->stages[i].bytes;
+        total->stages[i].errors += add->stages[i].errors;
+    }
+}
+
+const char * barcode_stage_name(Stage stage) {
+    return stage >= 0 && stage < STAGE_COUNT ? stage_names[stage] : NULL;
+}
@@ -0,0 +1,207 @@
+/* Copyright (C) 2019 Elijah Schutz */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+/**
+ *      @file stream.c
+ *      @brief Definitions of streaming encoder functions.
+ *      @author Elijah Schutz
+ *      @date 18/10/26
+ */
+
+#include "barcode/stream.h"
+
+#include "barcode/alloc.h"
+#include "barcode/errors.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ *      @detail Allocates the block storage shared by both kinds of stream.
+ */
+static void stream_init(EncodeStream * stream, int fd, char delim) {
+    stream->fd     = fd;
+    stream->start  = 0;
+    stream->end    = 0;
+    stream->buf    = NULL;
+    stream->delim  = delim;
+    stream->eof    = false;
+    stream->status = SUCCESS;
+    stream->number = 0;
+    stream->failed = 0;
+
+    size_t codes_size = (sizeof(Code128) + sizeof(pattern) * C128_MAX_PATTERN_SIZE) *
+                        ENCODE_STREAM_BLOCK;
+    size_t block_size = sizeof *stream->block * ENCODE_STREAM_BLOCK;
+    stream->codes     = barcode_malloc(codes_size);
+    stream->block     = barcode_malloc(block_size);
+    VERIFY_NULL(stream->codes, codes_size);
+    VERIFY_NULL(stream->block, block_size);
+
+    pattern * patterns = (pattern *) (stream->codes + ENCODE_STREAM_BLOCK);
+    for (int i = 0; i < ENCODE_STREAM_BLOCK; i++) {
+        stream->codes[i].data = patterns + i * C128_MAX_PATTERN_SIZE;
+        stream->block[i]      = &stream->codes[i];
+    }
+}
+
+int encode_stream_fd(EncodeStream * stream, int fd, char delim) {
+    stream_init(stream, fd, delim);
+    stream->buf = barcode_malloc(ENCODE_STREAM_BUFSIZE);
+    VERIFY_NULL(stream->buf, ENCODE_STREAM_BUFSIZE);
+    stream->data = stream->buf;
+    return SUCCESS;
+}
+
+int encode_stream_memory(EncodeStream * stream, const char * data, size_t len, char delim) {
+    stream_init(stream, -1, delim);
+    stream->data = data;
+    stream->end  = len;
+    stream->eof  = true;
+    return SUCCESS;
+}
+
+void encode_stream_free(EncodeStream * stream) {
+    barcode_free(stream->buf);
+    barcode_free(stream->codes);
+    barcode_free(stream->block);
+}
+
+/**
+ *      @detail Moves the part of a record already read to the start of the buffer and reads as
+ *              much more as fits after it.
+ */
+static int stream_fill(EncodeStream * stream) {
+    size_t pending = stream->end - stream->start;
+    memmove(stream->buf, stream->buf + stream->start, pending);
+    stream->start = 0;
+    stream->end   = pending;
+
+    ssize_t n;
+    do {
+        n = read(stream->fd, stream->buf + stream->end, ENCODE_STREAM_BUFSIZE - stream->end);
+    } while (n < 0 && EINTR == errno);
+    if (n < 0) {
+        stream->status = ERR_IO;
+        return ERR_IO;
+    }
+    stream->eof = 0 == n;
+    stream->end += n;
+    return SUCCESS;
+}
+
+/**
+ *      @detail A record that fills the whole buffer without a delimiter is dropped as it is read,
+ *              and only reported once its end is found.
+ */
+int encode_stream_record(EncodeStream * stream, const uchar ** data, int * len) {
+    bool overlong = false;
+    for (;;) {
+        const char * from  = stream->data + stream->start;
+        size_t       avail = stream->end - stream->start;
+        const char * delim = memchr(from, stream->delim, avail);
+
+        if (NULL == delim && !stream->eof) {
+            if (SUCCESS != stream->status) {
+                return stream->status;
+            }
+            if (ENCODE_STREAM_BUFSIZE == avail) {
+                overlong      = true;
+                stream->start = stream->end;
+            }
+            int status = stream_fill(stream);
+            if (SUCCESS != status) {
+                return status;
+            }
+            continue;
+        }
+        if (NULL == delim && 0 == avail && !overlong) {
+            *data = NULL;
+            *len  = 0;
+            return SUCCESS;
+        }
+
+        size_t size = NULL != delim ? (size_t) (delim - from) : avail;
+        stream->start += NULL != delim ? size + 1 : size;
+        stream->number++;
+        if ('\n' == stream->delim && size > 0 && '\r' == from[size - 1]) {
+            size--;
+        }
+        if (overlong || size > ENCODE_STREAM_BUFSIZE) {
+            *data = (const uchar *) from;
+            *len  = -1;
+            return SUCCESS;
+        }
+        if (size > 0) {
+            *data = (const uchar *) from;
+            *len  = (int) size;
+            return SUCCESS;
+        }
+    }
+}
+
+static int stream_encode(const uchar * data, int len, Code128 * dest) {
+    if (len < 0) {
+        return ERR_DATA_LENGTH;
+    }
+    return c128_encode_into((uchar *) data, len, dest);
+}
+
+int encode_stream_next(EncodeStream * stream, Code128 ** dest) {
+    const uchar * data;
+    int           len;
+    int           status = encode_stream_record(stream, &data, &len);
+    *dest                = NULL;
+    if (SUCCESS != status || NULL == data) {
+        return status;
+    }
+
+    status = stream_encode(data, len, stream->block[0]);
+    if (SUCCESS == status) {
+        *dest = stream->block[0];
+    }
+    return status;
+}
+
+/**
+ *      @detail If reading fails part-way through a block, the barcodes encoded so far are returned
+ *              and the error on the next call.
+ */
+int encode_stream_block(EncodeStream * stream, int max, Code128 *** dest, int * count) {
+    if (max < 1 || max > ENCODE_STREAM_BLOCK) {
+        return ERR_ARGUMENT;
+    }
+
+    int n      = 0;
+    int status = SUCCESS;
+    while (n < max) {
+        const uchar * data;
+        int           len;
+        status = encode_stream_record(stream, &data, &len);
+        if (SUCCESS != status || NULL == data) {
+            break;
+        }
+        if (SUCCESS == stream_encode(data, len, stream->block[n])) {
+            n++;
+        } else {
+            stream->failed++;
+        }
+    }
+
+    *dest  = stream->block;
+    *count = n;
+    return n > 0 ? SUCCESS : status;
+}
+
+static int stream_source_next(void * ctx, const uchar ** data, int * len) {
+    return encode_stream_record(ctx, data, len);
+}
+
+void encode_stream_source(Source * source, EncodeStream * stream) {
+    source->next = stream_source_next;
+    source->ctx  = stream;
+}
@@ -13,7 +13,9 @@
 
 #include "barcode/symb.h"
 
+#include "barcode/alloc.h"
 #include "barcode/errors.h"
+#include "barcode/stats.h"
 #include "barcode/util.h"
 
 #include <ctype.h>
@@ -106,35 +108,36 @@ int init_barcode(void) {
 }
 
 /**
- *      @detail Iterates through @c data to replacing every instance of a control character with its
- *              string representation supplied by ctrl_strrepr and DEL_STRREPR.
+ *      @detail Iterates through @c data, copying each character or, for control characters, its
+ *              string representation supplied by ctrl_strrepr and DEL_STRREPR to the end of the
+ *              string so far.
  *      @see ctrl_strrepr
  *      @see DEL_STRREPR
  */
 int c128_strrepr(uchar * data, int data_len, char ** dest) {
+    STAGE_START(timer, 0);
     if (data_len > C128_MAX_DATA_LEN) {
         fprintf(stderr, "data length exceeds maximum of %d\n", C128_MAX_DATA_LEN);
+        STAGE_STOP(timer, STAGE_STRREPR, 0, ERR_DATA_LENGTH);
         return ERR_DATA_LENGTH;
     }
 
-    *dest = calloc(1, C128_MAX_STRREPR_SIZE);
+    *dest = barcode_malloc(C128_MAX_STRREPR_SIZE);
     VERIFY_NULL(*dest, C128_MAX_STRREPR_SIZE);
 
+    int len = 0;
     for (int i = 0; i < data_len; i++) {
         char c = (char) data[i];
         if (IS_CTRL(c)) {
-            if (DEL == c) {
-                strncat(*dest, DEL_STRREPR, CTRL_STR_SIZE);
-            } else {
-                strncat(*dest, ctrl_strrepr[(int) c], CTRL_STR_SIZE);
-            }
+            const char * repr = DEL == c ? DEL_STRREPR : ctrl_strrepr[(int) c];
+            memcpy(*dest + len, repr, CTRL_STR_SIZE);
+            len += CTRL_STR_SIZE;
         } else {
-            char str[2];
-            str[0] = c;
-            str[1] = '\0';
-            strncat(*dest, str, 1);
+            (*dest)[len++] = c;
         }
     }
+    (*dest)[len] = '\0';
+    STAGE_STOP(timer, STAGE_STRREPR, len, SUCCESS);
     return SUCCESS;
 }
 
@@ -156,19 +159,14 @@ int c128_c_digit(uchar d0, uchar d1, int * dest) {
 
 /**
  *      @detail Code 128 C is only used on a string if it is even-lengthed and is made up completely
- *              of digits. use_c128_dgt() utilises slice() and isdigits() defined in util.h to
- *              achieve this.
+ *              of digits. use_c128_dgt() checks the substring in place with isdigits() defined in
+ *              util.h, as it is called for most characters of the data.
  */
 bool use_c128_dgt(char * str, int idx, int len) {
     if (len % 2 != 0) {
         return false;
     }
-    char * substr = slice(str, idx, len);
-
-    bool res = isdigits(substr, len) ? true : false;
-
-    free(substr);
-    return res;
+    return isdigits(str + idx, len);
 }
 
 /**
@@ -215,19 +213,11 @@ int c128_checksum(int * values, int val_len, int * dest) {
 }
 
 /**
- *      @detail The Code 128 algorithm is comprised of 3 'codes' allowing it to represent all 128
- *              ASCII characters. Code A represents characters 0 - 95 (ASCII control characters are
- *              are allowed), code B represents 32 - 127, and code C represents pairs of adjacent
- *              digits, allowing highly efficient compression of numerical data. Each code contains
- *              103 values, including Code 128 control symbols (FNC1-4, Shifts, Code changes, etc.).
- *              Code 128 has 107 barcode patterns, including starts and the stop pattern. Each
- *              pattern has a value 0-106. Within each code, characters or strings are assigned
- *              values that map to a specific pattern (Start and stop codes are common to A, B, and
- *              C).
- *              <a href="https://en.wikipedia.org/wiki/Code_128#Specification">Wikipedia</a> has a
- *              full explanation of the algorithm.
+ *      @detail The symbols are encoded straight into the caller's storage, and their values are
+ *              kept on the stack, so nothing is allocated. No more than @c data_len bytes of
+ *              @c data are read, so it need not be null-terminated.
  */
-int c128_encode(uchar * data, int data_len, Code128 ** dest) {
+static int encode_into(uchar * data, int data_len, Code128 * dest) {
     if (data_len > C128_MAX_DATA_LEN) {
         fprintf(stderr, "data length exceeds maximum of %d\n", C128_MAX_DATA_LEN);
         return ERR_DATA_LENGTH;
@@ -237,29 +227,19 @@ int c128_encode(uchar * data, int data_len, Code128 ** dest) {
     int     status     = SUCCESS;
     int     values_len = 0;
 
-    size_t values_size;
-    int *  values;
+    // values stores the numerical values of the symbols
+    int values[C128_MAX_PATTERN_SIZE];
 
-    size_t    dest_size;
-    pattern * dest_pat;
+    // dest_pat stores the patterns of the symbols, i.e. C128_CODE[values]
+    pattern * dest_pat = dest->data;
 
     Code128CodeSet code = Invalid;
 
     /* setjmp() and longjmp() are used to handle exceptions
      * When an exception occurs, status is set and longjmp() is called, returning code execution to
-     * where setjmp() was called. This allows nested error handling and memory freeing.
+     * where setjmp() was called. This allows nested error handling.
      */
     if (!setjmp(env)) {
-        // values stores the numerical values of the symbols
-        values_size = sizeof(int) * C128_MAX_PATTERN_SIZE;
-        values      = malloc(values_size);
-        VERIFY_NULL(values, values_size);
-
-        // dest_pat stores the patterns of the symbols, i.e. C128_CODE[values]
-        dest_size = sizeof(pattern) * C128_MAX_PATTERN_SIZE;
-        dest_pat  = malloc(dest_size);
-        VERIFY_NULL(dest_pat, dest_size);
-
         /**
          * If the full data has an even length and is solely numeric, code C can be used for the
          * whole thing. As code C encodes 2 digits per value, this method yields 2x compression.
@@ -281,10 +261,11 @@ int c128_encode(uchar * data, int data_len, Code128 ** dest) {
                 values_len++;
             }
         } else {
-            char init = data[0];
+            char init = data_len > 0 ? data[0] : '\0';
 
             // If the first C128_C_MIN_DGT_END characters are digits, code C can be used initially
-            if (USE_C128_DGT((char *) data, 0, C128_C_MIN_DGT_END)) {
+            if (C128_C_MIN_DGT_END <= data_len &&
+                USE_C128_DGT((char *) data, 0, C128_C_MIN_DGT_END)) {
                 code        = C;
                 values[0]   = StartC;
                 dest_pat[0] = START_C;
@@ -321,7 +302,7 @@ int c128_encode(uchar * data, int data_len, Code128 ** dest) {
             for (int i = 1; i < data_len; i++) {
                 char  chr      = data[i];
                 int   next     = i + 1;
-                uchar next_chr = data[next];
+                uchar next_chr = next < data_len ? data[next] : 0;
 
                 // Code C is just digits (single digits can be encoded in A and B), so if chr is not
                 // present in either A or B, it is unsupported.
@@ -470,22 +451,66 @@ int c128_encode(uchar * data, int data_len, Code128 ** dest) {
 
         dest_pat[pat_len - 1] = STOPPT;
 
-        size_t total_size = sizeof **dest + sizeof *data * data_len + sizeof(pattern *);
+        dest->textlen = data_len;
+        dest->datalen = pat_len;
+        memcpy(dest->text, data, data_len);
+    }
 
-        *dest = calloc(1, total_size);
-        VERIFY_NULL(dest, total_size);
+    return status;
+}
 
-        (*dest)->data = calloc(1, dest_size);
-        VERIFY_NULL((*dest)->data, dest_size);
+int c128_encode_into(uchar * data, int data_len, Code128 * dest) {
+    STAGE_START(timer, 0);
+    int status = encode_into(data, data_len, dest);
+    STAGE_STOP(
+        timer, STAGE_ENCODE, SUCCESS == status ? sizeof *dest->data * dest->datalen : 0, status);
+    return status;
+}
 
-        (*dest)->textlen = data_len;
-        (*dest)->datalen = pat_len;
-        memcpy((*dest)->text, data, data_len);
-        memcpy((*dest)->data, dest_pat, dest_size);
+/**
+ *      @detail The Code 128 algorithm is comprised of 3 'codes' allowing it to represent all 128
+ *              ASCII characters. Code A represents characters 0 - 95 (ASCII control characters are
+ *              are allowed), code B represents 32 - 127, and code C represents pairs of adjacent
+ *              digits, allowing highly efficient compression of numerical data. Each code contains
+ *              103 values, including Code 128 control symbols (FNC1-4, Shifts, Code changes, etc.).
+ *              Code 128 has 107 barcode patterns, including starts and the stop pattern. Each
+ *              pattern has a value 0-106. Within each code, characters or strings are assigned
+ *              values that map to a specific pattern (Start and stop codes are common to A, B, and
+ *              C).
+ *              <a href="https://en.wikipedia.org/wiki/Code_128#Specification">Wikipedia</a> has a
+ *              full explanation of the algorithm.
+ *
+ *              The barcode is encoded on the stack by c128_encode_into(), so that nothing is
+ *              allocated unless encoding succeeds.
+ */
+int c128_encode(uchar * data, int data_len, Code128 ** dest) {
+    pattern patterns[C128_MAX_PATTERN_SIZE] = {0};
+    Code128 code                            = {.data = patterns};
+
+    int status = c128_encode_into(data, data_len, &code);
+    if (SUCCESS != status) {
+        return status;
     }
 
-    free(values);
-    free(dest_pat);
+    size_t total_size = sizeof **dest + sizeof *data * data_len + sizeof(pattern *);
+    size_t dest_size  = sizeof patterns;
 
-    return status;
+    *dest = barcode_calloc(1, total_size);
+    VERIFY_NULL(dest, total_size);
+
+    (*dest)->data = barcode_malloc(dest_size);
+    VERIFY_NULL((*dest)->data, dest_size);
+
+    (*dest)->textlen = code.textlen;
+    (*dest)->datalen = code.datalen;
+    memcpy((*dest)->text, code.text, code.textlen);
+    memcpy((*dest)->data, patterns, dest_size);
+    return SUCCESS;
+}
+
+void c128_free(Code128 * code) {
+    if (NULL != code) {
+        barcode_free(code->data);
+        barcode_free(code);
+    }
 }
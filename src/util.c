@@ -13,6 +13,7 @@
 
 #include "barcode/util.h"
 
+#include "barcode/alloc.h"
 #include "barcode/errors.h"
 
 #include <ctype.h>
@@ -34,10 +35,67 @@ bool isdigits(char * str, int len) {
  *              char arrays, not strings. @c strncpy is thus forgone in favour of @c memcpy.
  */
 char * slice(char * str, int start, int len) {
-    char * res = malloc(len);
+    char * res = barcode_malloc(len);
     VERIFY_NULL(res, len);
 
     memcpy(res, str + start, len);
 
     return res;
 }
+
+int fmt_int(char * dest, long long value) {
+    char               digits[FMT_BUFSIZE];
+    int                num_digits = 0;
+    int                len        = 0;
+    unsigned long long abs_value  = (unsigned long long) value;
+
+    if (value < 0) {
+        abs_value = 0 - abs_value;
+    }
+
+    do {
+        digits[num_digits++] = '0' + abs_value % 10;
+        abs_value /= 10;
+    } while (abs_value > 0);
+
+    if (value < 0) {
+        dest[len++] = '-';
+    }
+    while (num_digits > 0) {
+        dest[len++] = digits[--num_digits];
+    }
+    return len;
+}
+
+/**
+ *      @detail The integral part is formatted by fmt_int(). The fractional part is written with six
+ *              digits and then its trailing zeros are removed, which gives the shortest decimal
+ *              that is exactly equal to the micro-unit value. A value with no fractional part is
+ *              written as an integer.
+ */
+int fmt_micro(char * dest, micro value) {
+    int                len       = 0;
+    unsigned long long abs_value = (unsigned long long) value;
+
+    if (value < 0) {
+        abs_value   = 0 - abs_value;
+        dest[len++] = '-';
+    }
+    len += fmt_int(dest + len, abs_value / MICRO_PER_UNIT);
+
+    unsigned long frac = abs_value % MICRO_PER_UNIT;
+    if (frac > 0) {
+        int digits = 6;
+        while (frac % 10 == 0) {
+            frac /= 10;
+            digits--;
+        }
+        dest[len++] = '.';
+        for (int i = digits - 1; i >= 0; i--) {
+            dest[len + i] = '0' + frac % 10;
+            frac /= 10;
+        }
+        len += digits;
+    }
+    return len;
+}
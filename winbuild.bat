@@ -9,7 +9,7 @@ SET OBJS=
 
 call vsdevcmd
 
-for %%f in (symb util graphic) do (
+for %%f in (alloc symb util graphic cursor sink cache sheet deflate raster context stats) do (
   SET OBJS=!OBJS! %ODIR%\%%f.obj
   %CC% %CFLAGS% /c %SDIR%\%%f.c -Fo:%ODIR%\%%f.obj
 )